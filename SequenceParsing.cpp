@@ -41,16 +41,59 @@
 #include <cassert>
 #include <cmath>
 #include <climits>
+#include <ctime>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
 #include <stdexcept>
 #include <sstream>
 #include <fstream>
-#include <locale>
 #include <istream>
+#include <iterator>
 #include <algorithm>
-
-
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#else
 #include "tinydir/tinydir.h"
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SEQUENCEPARSING_SSE2
+#include <immintrin.h>
+///the AVX2 code paths are always compiled on x86 and selected at runtime if the CPU supports them
+#if defined(__GNUC__) || defined(__clang__)
+#define SEQUENCEPARSING_AVX2
+#define SEQUENCEPARSING_TARGET_AVX2 __attribute__((target("avx2")))
+#elif _MSC_VER
+#define SEQUENCEPARSING_AVX2
+#define SEQUENCEPARSING_TARGET_AVX2
+#endif
+#endif
+#if _MSC_VER
+#include <intrin.h>
+#endif
 
 
 // Use: #pragma message WARN("My message")
@@ -73,18 +116,19 @@ namespace  {
      * For example: file%04dname### and the jpg extension would return:
      * 3 common parts: "file","name",".jpg"
      * 2 variables: "%04d", "###"
-     * The variables by order vector's second member is an int indicating how many non-variable (chars belonging to common parts) characters
-     * were found before this variable.
+     * Each variable's commonCharactersBefore member indicates how many non-variable (chars belonging to common parts) characters
+     * were found before this variable. Its position member is the offset of the variable in patternUnPathedWithoutExt.
+     * The type of the variables is not set, @see setVariableType
      **/
 static bool extractCommonPartsAndVariablesFromPattern(const std::string& patternUnPathedWithoutExt,
                                                       const std::string& patternExtension,
                                                       StringList* commonParts,
-                                                      std::vector<std::pair<std::string,int> >* variablesByOrder) {
+                                                      SequenceParsing::PatternVariables* variablesByOrder) {
     int i = 0;
     bool inPrintfLikeArg = false;
     int printfLikeArgIndex = 0;
     std::string commonPart;
-    std::string variable;
+    SequenceParsing::PatternVariable variable;
     int commonCharactersFound = 0;
     bool previousCharIsSharp = false;
     while (i < (int)patternUnPathedWithoutExt.size()) {
@@ -95,11 +139,15 @@ static bool extractCommonPartsAndVariablesFromPattern(const std::string& pattern
                 commonCharactersFound += commonPart.size();
                 commonPart.clear();
             }
-            if (!previousCharIsSharp && !variable.empty()) {
-                variablesByOrder->push_back(std::make_pair(variable,commonCharactersFound));
-                variable.clear();
+            if (!previousCharIsSharp && !variable.token.empty()) {
+                variable.commonCharactersBefore = commonCharactersFound;
+                variablesByOrder->push_back(variable);
+                variable.token.clear();
             }
-            variable.push_back(c);
+            if (variable.token.empty()) {
+                variable.position = i;
+            }
+            variable.token.push_back(c);
             previousCharIsSharp = true;
         } else if (c == '%') {
 
@@ -131,37 +179,41 @@ static bool extractCommonPartsAndVariablesFromPattern(const std::string& pattern
                     commonCharactersFound += commonPart.size();
                     commonPart.clear();
                 }
-                if (!variable.empty()) {
-                    variablesByOrder->push_back(std::make_pair(variable,commonCharactersFound));
-                    variable.clear();
+                if (!variable.token.empty()) {
+                    variable.commonCharactersBefore = commonCharactersFound;
+                    variablesByOrder->push_back(variable);
+                    variable.token.clear();
                 }
-                variable.push_back(c);
+                variable.position = i;
+                variable.token.push_back(c);
             }
         } else if ((c == 'd' || c == 'v' || c == 'V')  && inPrintfLikeArg) {
             inPrintfLikeArg = false;
-            assert(!variable.empty());
-            variable.push_back(c);
-            variablesByOrder->push_back(std::make_pair(variable,commonCharactersFound));
-            variable.clear();
+            assert(!variable.token.empty());
+            variable.token.push_back(c);
+            variable.commonCharactersBefore = commonCharactersFound;
+            variablesByOrder->push_back(variable);
+            variable.token.clear();
         } else if (inPrintfLikeArg) {
             ++printfLikeArgIndex;
-            assert(!variable.empty());
-            variable.push_back(c);
+            assert(!variable.token.empty());
+            variable.token.push_back(c);
             ///if we're after a % character, and c is a letter different than d or v or V
             ///or c is digit different than 0, then we don't support this printf like style.
             if (std::isalpha(c) ||
                     (printfLikeArgIndex == 1 && c != '0')) {
-                commonParts->push_back(variable);
-                commonCharactersFound += variable.size();
-                variable.clear();
+                commonParts->push_back(variable.token);
+                commonCharactersFound += variable.token.size();
+                variable.token.clear();
                 inPrintfLikeArg = false;
             }
 
         } else {
             commonPart.push_back(c);
-            if (!variable.empty()) {
-                variablesByOrder->push_back(std::make_pair(variable,commonCharactersFound));
-                variable.clear();
+            if (!variable.token.empty()) {
+                variable.commonCharactersBefore = commonCharactersFound;
+                variablesByOrder->push_back(variable);
+                variable.token.clear();
             }
         }
         ++i;
@@ -171,8 +223,9 @@ static bool extractCommonPartsAndVariablesFromPattern(const std::string& pattern
         commonParts->push_back(commonPart);
         commonCharactersFound += commonPart.size();
     }
-    if (!variable.empty()) {
-        variablesByOrder->push_back(std::make_pair(variable,commonCharactersFound));
+    if (!variable.token.empty()) {
+        variable.commonCharactersBefore = commonCharactersFound;
+        variablesByOrder->push_back(variable);
     }
 
     if (!patternExtension.empty()) {
@@ -182,40 +235,245 @@ static bool extractCommonPartsAndVariablesFromPattern(const std::string& pattern
 }
 
 
-// templated version of my_equal so it could work with both char and wchar_t
-template<typename charT>
-struct my_equal {
-    my_equal( const std::locale& loc ) : loc_(loc) {}
-    bool operator()(charT ch1, charT ch2) {
-        return std::toupper(ch1, loc_) == std::toupper(ch2, loc_);
+static char asciiToLower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+///Index of the lowest bit set in a non zero mask
+static int lowestBitIndex(unsigned int mask)
+{
+#if _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+///Compares length bytes of a and b, ignoring the case of ASCII letters if !caseSensitive
+static bool asciiEquals(const char* a,const char* b,size_t length,bool caseSensitive)
+{
+    if (caseSensitive) {
+        return std::memcmp(a, b, length) == 0;
     }
-private:
-    const std::locale& loc_;
+    for (size_t i = 0; i < length; ++i) {
+        if (asciiToLower(a[i]) != asciiToLower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef SEQUENCEPARSING_SSE2
+///Lower cases the ASCII letters of v: 'A'-'Z' are shifted to the bottom of the signed range so a single
+///signed comparison finds them.
+static __m128i asciiToLower16(__m128i v)
+{
+    const __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8((char)('A' + 128)));
+    const __m128i isUpper = _mm_cmplt_epi8(shifted, _mm_set1_epi8(-128 + 26));
+    return _mm_or_si128(v, _mm_and_si128(isUpper, _mm_set1_epi8(0x20)));
+}
+#endif
+
+#ifdef SEQUENCEPARSING_AVX2
+SEQUENCEPARSING_TARGET_AVX2
+static __m256i asciiToLower32(__m256i v)
+{
+    const __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8((char)('A' + 128)));
+    const __m256i isUpper = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 26), shifted);
+    return _mm256_or_si256(v, _mm256_and_si256(isUpper, _mm256_set1_epi8(0x20)));
+}
+
+static bool cpuSupportsAVX2()
+{
+#if _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    ///the OS must also save the AVX registers on context switches
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+///The instruction sets used by the code paths that have SIMD variants
+enum SimdLevel
+{
+    SIMD_SCALAR = 0,
+    SIMD_SSE2,
+    SIMD_AVX2
 };
 
-// find substring (case insensitive)
-template<typename T>
-size_t ci_find_substr( const T& str1, const T& str2, const std::locale& loc = std::locale() )
+static SimdLevel detectSimdLevel()
+{
+    SimdLevel level = SIMD_SCALAR;
+#ifdef SEQUENCEPARSING_SSE2
+    level = SIMD_SSE2;
+#endif
+#ifdef SEQUENCEPARSING_AVX2
+    if (cpuSupportsAVX2()) {
+        level = SIMD_AVX2;
+    }
+#endif
+    const char* forced = std::getenv("SEQUENCEPARSING_SIMD");
+    if (forced && std::strcmp(forced, "scalar") == 0) {
+        level = SIMD_SCALAR;
+    } else if (forced && std::strcmp(forced, "sse2") == 0 && level > SIMD_SSE2) {
+        level = SIMD_SSE2;
+    }
+    return level;
+}
+
+/**
+     * @brief Returns the widest instruction set the CPU supports, detected once. It can be lowered by setting the
+     * SEQUENCEPARSING_SIMD environment variable to "scalar" or "sse2", e.g: to test the portable code paths on x86.
+     **/
+static SimdLevel getSimdLevel()
 {
-    typename T::const_iterator it = std::search( str1.begin(), str1.end(),
-                                                 str2.begin(), str2.end(), my_equal<typename T::value_type>(loc) );
-    if ( it != str1.end() ) return it - str1.begin();
-    else return std::string::npos; // not found
+    static const SimdLevel level = detectSimdLevel();
+    return level;
 }
 
-static size_t findStr(const std::string& from,const std::string& toSearch,int pos, bool caseSensitive = false)
+/**
+     * @brief Searches the positions of str from i to end (included) where toSearch may start. first and last are
+     * the first and last characters of toSearch, lower cased if !caseSensitive. Returns std::string::npos if not found.
+     * The asciiFindFrom* variants compare the first and last characters against 16 (SSE2) or 32 (AVX2) positions at
+     * once and only compare entirely the positions where both match. They all end with asciiFindFromScalar.
+     **/
+typedef size_t (*AsciiFindFromFunc)(const char* str,const char* toSearch,size_t toSearchLength,size_t i,size_t end,
+                                    char first,char last,bool caseSensitive);
+
+static size_t asciiFindFromScalar(const char* str,const char* toSearch,size_t toSearchLength,size_t i,size_t end,
+                                  char first,char last,bool caseSensitive)
 {
-    if (caseSensitive) {
-        return from.find(toSearch,pos);
-    } else {
-        return ci_find_substr<std::string>(from, toSearch);
+    for (; i <= end; ++i) {
+        const char c = caseSensitive ? str[i] : asciiToLower(str[i]);
+        const char d = caseSensitive ? str[i + toSearchLength - 1] : asciiToLower(str[i + toSearchLength - 1]);
+        if (c == first && d == last && asciiEquals(str + i + 1, toSearch + 1, toSearchLength - 1, caseSensitive)) {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+#ifdef SEQUENCEPARSING_SSE2
+static size_t asciiFindFromSSE2(const char* str,const char* toSearch,size_t toSearchLength,size_t i,size_t end,
+                                char first,char last,bool caseSensitive)
+{
+    const __m128i firstBlock = _mm_set1_epi8(first);
+    const __m128i lastBlock = _mm_set1_epi8(last);
+    for (; i + 16 <= end + 1; i += 16) {
+        __m128i firsts = _mm_loadu_si128((const __m128i*)(str + i));
+        __m128i lasts = _mm_loadu_si128((const __m128i*)(str + i + toSearchLength - 1));
+        if (!caseSensitive) {
+            firsts = asciiToLower16(firsts);
+            lasts = asciiToLower16(lasts);
+        }
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(firsts, firstBlock),
+                                                                          _mm_cmpeq_epi8(lasts, lastBlock)));
+        while (mask) {
+            size_t candidate = i + lowestBitIndex(mask);
+            if (asciiEquals(str + candidate + 1, toSearch + 1, toSearchLength - 1, caseSensitive)) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return asciiFindFromScalar(str, toSearch, toSearchLength, i, end, first, last, caseSensitive);
+}
+#endif
+
+#ifdef SEQUENCEPARSING_AVX2
+SEQUENCEPARSING_TARGET_AVX2
+static size_t asciiFindFromAVX2(const char* str,const char* toSearch,size_t toSearchLength,size_t i,size_t end,
+                                char first,char last,bool caseSensitive)
+{
+    const __m256i firstBlock = _mm256_set1_epi8(first);
+    const __m256i lastBlock = _mm256_set1_epi8(last);
+    for (; i + 32 <= end + 1; i += 32) {
+        __m256i firsts = _mm256_loadu_si256((const __m256i*)(str + i));
+        __m256i lasts = _mm256_loadu_si256((const __m256i*)(str + i + toSearchLength - 1));
+        if (!caseSensitive) {
+            firsts = asciiToLower32(firsts);
+            lasts = asciiToLower32(lasts);
+        }
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(firsts, firstBlock),
+                                                                                _mm256_cmpeq_epi8(lasts, lastBlock)));
+        while (mask) {
+            size_t candidate = i + lowestBitIndex(mask);
+            if (asciiEquals(str + candidate + 1, toSearch + 1, toSearchLength - 1, caseSensitive)) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+    ///the tail is not given to the SSE2 variant: mixing legacy SSE and AVX code stalls on some CPUs
+    return asciiFindFromScalar(str, toSearch, toSearchLength, i, end, first, last, caseSensitive);
+}
+#endif
+
+static AsciiFindFromFunc selectAsciiFindFrom()
+{
+    switch (getSimdLevel()) {
+#ifdef SEQUENCEPARSING_AVX2
+    case SIMD_AVX2:
+        return asciiFindFromAVX2;
+#endif
+#ifdef SEQUENCEPARSING_SSE2
+    case SIMD_SSE2:
+        return asciiFindFromSSE2;
+#endif
+    default:
+        return asciiFindFromScalar;
+    }
+}
+
+/**
+     * @brief Finds toSearch in str from pos, ignoring the case of ASCII letters if !caseSensitive (bytes above 127
+     * are compared as is, as the "C" locale does). Returns std::string::npos if not found.
+     * The search uses the instruction set given by getSimdLevel(), see AsciiFindFromFunc.
+     * There is no shared state so that threads scanning concurrently do not contend.
+     **/
+static size_t asciiFind(const char* str,size_t length,const char* toSearch,size_t toSearchLength,size_t pos,bool caseSensitive)
+{
+    if (pos > length) {
+        return std::string::npos;
     }
+    if (toSearchLength == 0) {
+        return pos;
+    }
+    if (length - pos < toSearchLength) {
+        return std::string::npos;
+    }
+
+    static const AsciiFindFromFunc asciiFindFrom = selectAsciiFindFrom();
+    const char first = caseSensitive ? toSearch[0] : asciiToLower(toSearch[0]);
+    const char last = caseSensitive ? toSearch[toSearchLength - 1] : asciiToLower(toSearch[toSearchLength - 1]);
+    ///toSearch may start up to length - toSearchLength
+    return asciiFindFrom(str, toSearch, toSearchLength, pos, length - toSearchLength, first, last, caseSensitive);
+}
+
+static size_t findStr(const std::string& from,const std::string& toSearch,int pos, bool caseSensitive = false)
+{
+    return asciiFind(from.c_str(), from.size(), toSearch.c_str(), toSearch.size(), pos < 0 ? 0 : pos, caseSensitive);
 }
 
 
 static bool startsWith(const std::string& str,const std::string& prefix,bool caseSensitive = false)
 {
-    return findStr(str,prefix,0,caseSensitive) == 0;
+    return str.size() >= prefix.size() && asciiEquals(str.c_str(), prefix.c_str(), prefix.size(), caseSensitive);
 }
 
 static bool endsWith(const std::string &str, const std::string &suffix)
@@ -253,6 +511,44 @@ static std::string stringFromInt(int nb)
     return ss.str();
 }
 
+///Estimation of the memory used by the nodes of std::map and std::unordered_map besides their value
+#define MAP_NODE_OVERHEAD (3 * sizeof(void*) + sizeof(int))
+#define HASH_NODE_OVERHEAD (sizeof(void*) + sizeof(std::size_t))
+
+///Returns the number of bytes allocated on the heap by str, 0 if the characters fit in the object itself
+static std::size_t stringMemoryUsage(const std::string& str)
+{
+    const char* data = str.data();
+    const char* object = reinterpret_cast<const char*>(&str);
+    if (data >= object && data < object + sizeof(std::string)) {
+        return 0;
+    }
+    return str.capacity() + 1;
+}
+
+///Appends the decimal representation of nb to str, prepended with 0's so that it is at least minDigits long.
+///Like the stringstream based conversion, the 0's are prepended before the minus sign of negative numbers.
+static void appendInt(std::string* str,int nb,int minDigits)
+{
+    char digits[16];
+    int count = 0;
+    ///work on the negative value so that INT_MIN doesn't overflow
+    int n = nb > 0 ? -nb : nb;
+    do {
+        digits[count++] = '0' - (n % 10);
+        n /= 10;
+    } while (n != 0);
+    if (nb < 0) {
+        digits[count++] = '-';
+    }
+    if (count < minDigits) {
+        str->append(minDigits - count, '0');
+    }
+    while (count > 0) {
+        str->push_back(digits[--count]);
+    }
+}
+
 static std::string removeFileExtension(std::string& filename) {
     int i = filename.size() -1;
     std::string extension;
@@ -264,1243 +560,6098 @@ static std::string removeFileExtension(std::string& filename) {
     return extension;
 }
 
-static void getFilesFromDir(tinydir_dir& dir,StringList* ret)
+/**
+     * @brief Enumerates the files (not the directories) of a directory, batch by batch.
+     * On Linux the directory entries are read with getdents64 in large batches into a buffer that is
+     * reused for the whole enumeration, and the entry type they carry (d_type) tells directories apart
+     * without a stat per file. A stat is only done for entries whose type is unknown (some file systems
+     * don't fill d_type) or that are symbolic links, so that links to directories are skipped like tinydir does.
+     * On other platforms tinydir is used.
+     **/
+class DirectoryReader
 {
-    ///iterate through all the files in the directory
-    while (dir.has_next) {
-        tinydir_file file;
-        tinydir_readfile(&dir, &file);
+public:
 
-        if (file.is_dir) {
-            tinydir_next(&dir);
-            continue;
-        }
+    typedef SequenceParsing::DirectoryTreeOptions::SymlinkPolicy SymlinkPolicy;
 
-        std::string filename(file.name);
-        if (filename == "." || filename == "..") {
-            tinydir_next(&dir);
-            continue;
-        } else {
-            ret->push_back(filename);
-        }
+    DirectoryReader();
 
-        tinydir_next(&dir);
+    ~DirectoryReader();
 
-    }
-}
+    ///Returns false if the directory couldn't be opened.
+    bool open(const std::string& path);
 
-/**
-     * @brief Given the variable token (e.g: %04d or #### or %v or %V, check if the variable and its type
-     * coherent with the symbol. If so this function returns true, otherwise false.
-     * @param frameNumberOrViewNumber [out] The frame number extracted from the variable, or the view number.
-     * The view index is always 0 if there's only a single view.
-     * If there'are 2 views, index 0 is considered to be the left view and index 1 is considered to be the right view.
-     * If there'are multiple views, the index is corresponding to the view
-     * Type is an integer indicating how is the content of the string supposed to be interpreted:
-     * 0: a frame number (e.g: 0001)
-     * 1: a short view number (e.g: 'l' or 'r')
-     * 2: a long view number (e.g: 'left' or 'LEFT' or 'right' or 'RIGHT' or  'view0' or 'VIEW0')
-     **/
-static bool checkVariable(const std::string& variableToken,const std::string& variable,int type,int* frameNumberOrViewNumber) {
-    if (variableToken == "%v") {
-        if (type != 1) {
-            return false;
-        }
-        if (variable == "r") {
-            *frameNumberOrViewNumber = 1;
-            return true;
-        } else if (variable == "l") {
-            *frameNumberOrViewNumber = 0;
-            return true;
-        } else if (startsWith(variable,"view")) {
-            std::string viewNo = variable;
-            removeAllOccurences(viewNo,"view");
-            *frameNumberOrViewNumber = stringToInt(viewNo);
-            return true;
-        } else {
-            return false;
-        }
+    /**
+         * @brief Appends the names of the files of the next batch of directory entries to files.
+         * Returns false once all entries have been read, in which case nothing was appended.
+         **/
+    bool readBatch(StringList* files);
 
-    } else if (variableToken == "%V") {
-        if (type != 2) {
-            return false;
-        }
-        if (variable == "right") {
-            *frameNumberOrViewNumber = 1;
-            return true;
-        } else if (variable == "left") {
-            *frameNumberOrViewNumber = 0;
-            return true;
-        } else if (startsWith(variable,"view")) {
-            std::string viewNo = variable;
-            removeAllOccurences(viewNo, "view");
-            *frameNumberOrViewNumber = stringToInt(viewNo);
-            return true;
-        } else {
-            return false;
-        }
-    } else if (variableToken.find('#') != std::string::npos) {
-        if (type != 0) {
-            return false;
-        } else if(variable.size() < variableToken.size()) {
-            return false;
-        }
-        int prepending0s = 0;
-        int i = 0;
-        while (i < (int)variable.size()) {
-            if (variable.at(i) != '0') {
-                break;
-            } else {
-                ++prepending0s;
-            }
-            ++i;
-        }
+    /**
+         * @brief Same as readBatch(files) but the names of the sub-directories are appended to directories (if not null)
+         * and symbolic links are handled according to symlinkPolicy. readBatch(files) uses the LIST_SYMLINKS policy.
+         **/
+    bool readBatch(StringList* files,StringList* directories,SymlinkPolicy symlinkPolicy);
 
-        ///extra padding on numbers bigger than the hash chars count are not allowed.
-        if (variable.size() > variableToken.size() && prepending0s > 0) {
-            return false;
-        }
+    ///Gets an identifier of the opened directory that is the same whatever the path it was opened with.
+    ///Returns false if the platform doesn't provide one.
+    bool getIdentity(unsigned long long* device,unsigned long long* inode) const;
 
-        *frameNumberOrViewNumber = stringToInt(variable);
-        return true;
-    } else if (startsWith(variableToken,"%0") && endsWith(variableToken,"d")) {
-        if (type != 0) {
-            return false;
-        }
-        std::string extraPaddingCountStr = variableToken;
-        removeAllOccurences(extraPaddingCountStr, "%0");
-        removeAllOccurences(extraPaddingCountStr, "d");
-        int extraPaddingCount = stringToInt(extraPaddingCountStr);
-        if ((int)variable.size() < extraPaddingCount) {
-            return false;
-        }
+    ///Gets the position in the directory that follows the entries read so far, which another reader of the directory
+    ///can seek() to. Returns false if the platform doesn't provide it.
+    bool getPosition(long long* position) const;
 
-        int prepending0s = 0;
-        int i = 0;
-        while (i < (int)variable.size()) {
-            if (variable.at(i) != '0') {
-                break;
-            } else {
-                ++prepending0s;
-            }
-            ++i;
-        }
+    ///Continues reading from a position given by getPosition(). Returns false if the platform doesn't support it.
+    bool seek(long long position);
 
-        ///extra padding on numbers bigger than the hash chars count are not allowed.
-        if ((int)variable.size() > extraPaddingCount && prepending0s > 0) {
-            return false;
-        }
+    void close();
 
-        *frameNumberOrViewNumber = stringToInt(variable);
-        return true;
-    } else if (variableToken == "%d") {
-        *frameNumberOrViewNumber = stringToInt(variable);
-        return true;
-    } else {
-        throw std::invalid_argument("Variable token unrecognized: " + variableToken);
+private:
+
+    DirectoryReader(const DirectoryReader&);
+    void operator=(const DirectoryReader&);
+
+#ifdef __linux__
+    enum { BATCH_SIZE = 128 * 1024 };
+
+    int _fd;
+    std::vector<char> _buffer;
+    long long _position;
+#else
+    enum { BATCH_SIZE = 1024 };
+
+    tinydir_dir _dir;
+    bool _isOpened;
+#endif
+};
+
+#ifdef __linux__
+
+///The layout of the entries returned by the getdents64 system call
+struct LinuxDirent64
+{
+    unsigned long long d_ino;
+    long long d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+DirectoryReader::DirectoryReader()
+    : _fd(-1)
+    , _buffer()
+    , _position(0)
+{
+}
+
+DirectoryReader::~DirectoryReader()
+{
+    close();
+}
+
+bool DirectoryReader::open(const std::string& path)
+{
+    close();
+    if (path.empty()) {
+        return false;
     }
+    _fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (_fd == -1) {
+        return false;
+    }
+    _buffer.resize(BATCH_SIZE);
+    _position = 0;
+    return true;
 }
 
-/**
-     * @brief Tries to match a given filename with the common parts and the variables of a pattern.
-     * Note that if 2 variables have the exact same meaning (e.g: ### and %04d) and they do not correspond to the
-     * same frame number it will reject the filename against the pattern.
-     * @see extractCommonPartsAndVariablesFromPattern
-     **/
-static bool matchesPattern(const std::string& filename,const StringList& commonPartsOrdered,
-                           const std::vector<std::pair<std::string,int> >& variablesOrdered,
-                           int* frameNumber,int* viewNumber) {
+bool DirectoryReader::readBatch(StringList* files)
+{
+    return readBatch(files, 0, SequenceParsing::DirectoryTreeOptions::LIST_SYMLINKS);
+}
 
-    ///initialize the view number
-    *viewNumber = -1;
+bool DirectoryReader::readBatch(StringList* files,StringList* directories,SymlinkPolicy symlinkPolicy)
+{
+    if (_fd == -1) {
+        return false;
+    }
+    long bytesRead;
+    do {
+        bytesRead = syscall(SYS_getdents64, _fd, &_buffer[0], _buffer.size());
+    } while (bytesRead == -1 && errno == EINTR);
 
-    int lastPartPos = -1;
-    for (size_t i = 0; i < commonPartsOrdered.size(); ++i) {
-#pragma message WARN("This line will match common parts that could be longer,e.g: marleen would match marleenBG ")
-        size_t pos = findStr(filename, commonPartsOrdered[i], lastPartPos == -1? 0 : lastPartPos,true);
-        ///couldn't find a common part
-        if (pos == std::string::npos) {
-            return false;
+    if (bytesRead <= 0) {
+        return false;
+    }
+
+    for (long offset = 0; offset < bytesRead;) {
+        const LinuxDirent64* entry = reinterpret_cast<const LinuxDirent64*>(&_buffer[offset]);
+        offset += entry->d_reclen;
+        _position = entry->d_off;
+
+        const char* name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
         }
 
-        //the common parts order is not the same.
-        if ((int)pos <= lastPartPos) {
-            return false;
+        bool isDir = entry->d_type == DT_DIR;
+        bool isLink = entry->d_type == DT_LNK;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            if (fstatat(_fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+                isDir = S_ISDIR(st.st_mode);
+                isLink = S_ISLNK(st.st_mode);
+            }
+        }
+        if (isLink) {
+            if (symlinkPolicy == SequenceParsing::DirectoryTreeOptions::SKIP_SYMLINKS) {
+                continue;
+            }
+            struct stat st;
+            isDir = fstatat(_fd, name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+            if (isDir && symlinkPolicy != SequenceParsing::DirectoryTreeOptions::FOLLOW_SYMLINKS) {
+                continue;
+            }
+        }
+        if (!isDir) {
+            files->push_back(name);
+        } else if (directories) {
+            directories->push_back(name);
         }
     }
+    return true;
+}
 
+bool DirectoryReader::getIdentity(unsigned long long* device,unsigned long long* inode) const
+{
+    struct stat st;
+    if (_fd == -1 || fstat(_fd, &st) != 0) {
+        return false;
+    }
+    *device = st.st_dev;
+    *inode = st.st_ino;
+    return true;
+}
 
-    if (variablesOrdered.empty()) {
-        return true;
+bool DirectoryReader::getPosition(long long* position) const
+{
+    if (_fd == -1) {
+        return false;
     }
+    *position = _position;
+    return true;
+}
 
-    ///if we reach here that means the filename contains all the common parts. We can now expand the variables and start
-    ///looking for a matching pattern
+bool DirectoryReader::seek(long long position)
+{
+    if (_fd == -1 || lseek(_fd, position, SEEK_SET) == -1) {
+        return false;
+    }
+    _position = position;
+    return true;
+}
 
-    ///we first extract all interesting informations from the filename by order
-    ///i.e: we extract the digits and the view names.
+void DirectoryReader::close()
+{
+    if (_fd != -1) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
 
-    ///for each variable, a string representing the number (e.g: 0001 or LEFT/RIGHT or even VIEW0)
-    ///corresponding either to a view number or a frame number
+#else
 
+DirectoryReader::DirectoryReader()
+    : _isOpened(false)
+{
+}
 
-    int i = 0;
-    std::string variable;
-    ///extracting digits
-    int commonCharactersFound = 0;
-    bool previousCharIsDigit = false;
-    bool wasFrameNumberSet = false;
-    bool wasViewNumberSet = false;
-    int variableChecked = 0;
+DirectoryReader::~DirectoryReader()
+{
+    close();
+}
 
-    ///the index in variablesOrdered to check
-    int nextVariableIndex = 0;
+bool DirectoryReader::open(const std::string& path)
+{
+    close();
+    if (tinydir_open(&_dir, path.c_str()) == -1) {
+        return false;
+    }
+    _isOpened = true;
+    return true;
+}
 
-    while (i < (int)filename.size()) {
-        const char& c = filename.at(i);
-        if (std::isdigit(c)) {
+bool DirectoryReader::readBatch(StringList* files)
+{
+    return readBatch(files, 0, SequenceParsing::DirectoryTreeOptions::LIST_SYMLINKS);
+}
 
-            assert((!previousCharIsDigit && variable.empty()) || previousCharIsDigit);
-            previousCharIsDigit = true;
-            variable.push_back(c);
-            ++i;
-        } else {
-            previousCharIsDigit = false;
+bool DirectoryReader::readBatch(StringList* files,StringList* directories,SymlinkPolicy /*symlinkPolicy*/)
+{
+    if (!_isOpened || !_dir.has_next) {
+        return false;
+    }
+    ///iterate through a batch of files in the directory
+    for (int i = 0; i < BATCH_SIZE && _dir.has_next; ++i) {
+        tinydir_file file;
+        tinydir_readfile(&_dir, &file);
+        tinydir_next(&_dir);
 
-            if (!variable.empty()) {
-                int fnumber;
+        std::string filename(file.name);
+        if (filename == "." || filename == "..") {
+            continue;
+        }
+        if (!file.is_dir) {
+            files->push_back(filename);
+        } else if (directories) {
+            directories->push_back(filename);
+        }
+    }
+    return true;
+}
 
-                ///the pattern wasn't expecting a frame number or the digits count doesn't respect the
-                ///hashes character count or the printf-like padding count is wrong.
-                if (variablesOrdered[nextVariableIndex].second != commonCharactersFound) {
-                    return false;
-                }
-                if (!checkVariable(variablesOrdered[nextVariableIndex].first, variable, 0, &fnumber)) {
-                    return false;
-                }
+bool DirectoryReader::getIdentity(unsigned long long* /*device*/,unsigned long long* /*inode*/) const
+{
+    return false;
+}
 
-                ///a previous frame number variable had a different frame number
-                if (wasFrameNumberSet && fnumber != *frameNumber) {
-                    return false;
-                }
-                ++variableChecked;
-                ++nextVariableIndex;
-                wasFrameNumberSet = true;
-                *frameNumber = fnumber;
-                variable.clear();
-            }
+bool DirectoryReader::getPosition(long long* /*position*/) const
+{
+    return false;
+}
 
-            char clower = std::tolower(c);
-            ///these are characters that trigger a view name, start looking for a view name
-            if(clower == 'l' || clower == 'r'  || clower == 'v') {
-                std::string mid = filename.substr(i);
-                bool startsWithLeft = startsWith(mid,"left");
-                bool startsWithRight = startsWith(mid,"right");
-                bool startsWithView = startsWith(mid,"view");
-
-                if (startsWith(mid,"l") && !startsWithLeft) {
-
-                    ///don't be so harsh with just short views name because the letter
-                    /// 'l' or 'r' might be found somewhere else in the filename, so if theres
-                    ///no variable expected here just continue
-
-                    if (variablesOrdered[nextVariableIndex].first == std::string("%v") &&
-                            variablesOrdered[nextVariableIndex].second == commonCharactersFound) {
-                        ///the view number doesn't correspond to a previous view variable
-                        if (wasViewNumberSet && *viewNumber != 0) {
-                            return false;
-                        }
-                        wasViewNumberSet = true;
-                        *viewNumber = 0;
-                        ++variableChecked;
-                        ++nextVariableIndex;
-                    } else {
-                        ++commonCharactersFound;
-                    }
-                    ++i;
-                } else if (startsWith(mid,"r") && !startsWithRight) {
-                    ///don't be so harsh with just short views name because the letter
-                    /// 'l' or 'r' might be found somewhere else in the filename, so if theres
-                    ///no variable expected here just continue
-                    if (variablesOrdered[nextVariableIndex].first == "%v"  &&
-                            variablesOrdered[nextVariableIndex].second == commonCharactersFound) {
-                        ///the view number doesn't correspond to a previous view variable
-                        if (wasViewNumberSet &&  *viewNumber != 1) {
-                            return false;
-                        }
-                        wasViewNumberSet = true;
-                        *viewNumber = 1;
-                        ++variableChecked;
-                        ++nextVariableIndex;
-                    } else {
-                        ++commonCharactersFound;
-                    }
-                    ++i;
-                } else if (startsWithLeft) {
+bool DirectoryReader::seek(long long /*position*/)
+{
+    return false;
+}
 
-                    int viewNo;
+void DirectoryReader::close()
+{
+    if (_isOpened) {
+        tinydir_close(&_dir);
+        _isOpened = false;
+    }
+}
 
-                    ///the pattern didn't expect a view name here
-                    if (variablesOrdered[nextVariableIndex].second != commonCharactersFound) {
-                        return false;
-                    }
-                    if (!checkVariable(variablesOrdered[nextVariableIndex].first, "left", 2, &viewNo)) {
-                        return false;
-                    }
-                    ///the view number doesn't correspond to a previous view variable
-                    if (wasViewNumberSet && viewNo != *viewNumber) {
-                        return false;
-                    }
-                    ++nextVariableIndex;
-                    ++variableChecked;
-                    wasViewNumberSet = true;
-                    *viewNumber = viewNo;
+#endif
 
-                    i += 4;
-                } else if (startsWithRight) {
+///Listings of directories modified less than this many seconds before being read are not cached: changes made in the
+///same tick of the file system clock would not change the modification time again.
+#define SCAN_CACHE_MIN_AGE 2
 
-                    int viewNo;
+/**
+     * @brief The object installed for the scans by setScanCache or setSequenceIndex. The scans count themselves as users
+     * of the object they got while they use it, so that uninstalling or destroying it waits for them to be done with it.
+     **/
+template <typename T>
+class InstalledObject
+{
+public:
 
-                    ///the pattern didn't expect a view name here
-                    if (variablesOrdered[nextVariableIndex].second != commonCharactersFound) {
-                        return false;
-                    }
-                    if (!checkVariable(variablesOrdered[nextVariableIndex].first, "right", 2, &viewNo)) {
-                        return false;
-                    }
-                    ///the view number doesn't correspond to a previous view variable
-                    if (wasViewNumberSet && viewNo != *viewNumber) {
-                        return false;
-                    }
-                    ++variableChecked;
-                    ++nextVariableIndex;
-                    wasViewNumberSet = true;
-                    *viewNumber = viewNo;
-                    i += 5;
-                } else if(startsWithView) {
-                    ///extract the view number
-                    variable += "view";
-                    std::string viewNumberStr;
-                    int j = 4;
-                    while (j < (int)mid.size() && std::isdigit(mid.at(j))) {
-                        viewNumberStr.push_back(mid.at(j));
-                        ++j;
-                    }
-                    if (!viewNumberStr.empty()) {
-                        variable += viewNumberStr;
-
-                        int viewNo;
-
-                        if (variablesOrdered[nextVariableIndex].second != commonCharactersFound) {
-                            return false;
-                        }
-                        const std::string& variableToken = variablesOrdered[nextVariableIndex].first;
-                        ///if the variableToken is %v just put a type of 1
-                        ///otherwise a type of 2, this is because for either %v or %V we write view<N>
-                        int type = variableToken == "%v" ? 1 : 2;
-                        if (!checkVariable(variableToken, variable, type, &viewNo)) {
-                            ///the pattern didn't expect a view name here
-                            return false;
-                        }
-                        ///the view number doesn't correspond to a previous view variable
-                        if (wasViewNumberSet && viewNo != *viewNumber) {
-                            return false;
-                        }
-                        ++variableChecked;
-                        ++nextVariableIndex;
-                        wasViewNumberSet = true;
-                        *viewNumber = viewNo;
-
-                        i += variable.size();
-                    } else {
-                        commonCharactersFound += 4;
-                        i += 4;
-                    }
-                } else {
-                    ++commonCharactersFound;
-                    ++i;
-                }
-                variable.clear();
+    InstalledObject()
+        : _mutex()
+        , _released()
+        , _object(0)
+        , _usersCounts()
+    {
+    }
 
-            } else {
-                ++commonCharactersFound;
-                ++i;
-            }
+    T* get()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _object;
+    }
+
+    ///Returns the installed object (or null) and counts the caller as one of its users until it calls release()
+    T* acquire()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_object) {
+            ++_usersCounts[_object];
         }
+        return _object;
     }
-    if (variableChecked == (int)variablesOrdered.size()) {
-        return true;
-    } else {
-        return false;
+
+    void release(T* object)
+    {
+        if (!object) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        typename std::map<T*,int>::iterator it = _usersCounts.find(object);
+        assert(it != _usersCounts.end());
+        if (--it->second == 0) {
+            _usersCounts.erase(it);
+            _released.notify_all();
+        }
     }
-}
 
+    ///Installs object, null to uninstall the installed one, and waits for the users of the previous one to release it
+    void install(T* object)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        T* previous = _object;
+        _object = object;
+        if (previous != object) {
+            waitReleased(previous, lock);
+        }
+    }
 
-}
+    ///Uninstalls object if it is the installed one, and waits for its users to release it
+    void uninstall(T* object)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_object == object) {
+            _object = 0;
+        }
+        waitReleased(object, lock);
+    }
 
+private:
 
-namespace SequenceParsing {
-/**
-     * @brief A small structure representing an element of a file name.
-     * It can be either a text part, or a view part or a frame number part.
-     **/
-struct FileNameElement {
+    void waitReleased(T* object,std::unique_lock<std::mutex>& lock)
+    {
+        if (object) {
+            _released.wait(lock, [this, object]() { return _usersCounts.find(object) == _usersCounts.end(); });
+        }
+    }
 
-    enum Type { TEXT = 0  , FRAME_NUMBER };
+    std::mutex _mutex;
+    std::condition_variable _released;
+    T* _object;
+    ///the number of users of each object acquired and not released yet
+    std::map<T*,int> _usersCounts;
+};
 
-    FileNameElement(const std::string& data,FileNameElement::Type type)
-        : data(data)
-        , type(type)
-    {}
+///Uses the object installed in an InstalledObject from acquire() until release() or the destruction of this
+template <typename T>
+class InstalledObjectUse
+{
+public:
 
-    std::string data;
-    Type type;
-};
+    explicit InstalledObjectUse(InstalledObject<T>& installed)
+        : _installed(installed)
+        , _object(0)
+    {
+    }
 
+    ~InstalledObjectUse()
+    {
+        release();
+    }
 
-////////////////////FileNameContent//////////////////////////
+    ///Releases the object used, if any, and acquires the installed one. Returns it, or null if none is installed.
+    T* acquire()
+    {
+        release();
+        _object = _installed.acquire();
+        return _object;
+    }
 
-struct FileNameContentPrivate {
-    ///Ordered from left to right, these are the elements composing the filename without its path
-    std::vector<FileNameElement> orderedElements;
-    std::string absoluteFileName;
-    std::string filePath; //< the filepath
-    std::string filename; //< the filename without path
-    std::string extension; //< the file extension
-    bool hasSingleNumber;
-    std::string generatedPattern;
+    void release()
+    {
+        _installed.release(_object);
+        _object = 0;
+    }
 
-    FileNameContentPrivate()
-        : orderedElements()
-        , absoluteFileName()
-        , filePath()
-        , filename()
-        , extension()
-        , hasSingleNumber(false)
-        , generatedPattern()
+    T* get() const
     {
+        return _object;
     }
 
-    void parse(const std::string& absoluteFileName);
-};
+    T* operator->() const
+    {
+        return _object;
+    }
+
+private:
 
+    InstalledObjectUse(const InstalledObjectUse&);
+    void operator=(const InstalledObjectUse&);
 
-FileNameContent::FileNameContent(const std::string& absoluteFilename)
-    : _imp(new FileNameContentPrivate())
+    InstalledObject<T>& _installed;
+    T* _object;
+};
+
+///The cache installed by setScanCache. It is never destroyed, so that caches destroyed at exit can still uninstall themselves.
+static InstalledObject<SequenceParsing::ScanCache>& getInstalledScanCache()
 {
-    _imp->parse(absoluteFilename);
+    static InstalledObject<SequenceParsing::ScanCache>* installed = new InstalledObject<SequenceParsing::ScanCache>();
+    return *installed;
 }
 
-FileNameContent::FileNameContent(const FileNameContent& other)
-    : _imp(new FileNameContentPrivate())
+///The index installed by setSequenceIndex, never destroyed either
+static InstalledObject<SequenceParsing::SequenceIndex>& getInstalledSequenceIndex()
 {
-    *this = other;
+    static InstalledObject<SequenceParsing::SequenceIndex>* installed = new InstalledObject<SequenceParsing::SequenceIndex>();
+    return *installed;
 }
 
-FileNameContent::~FileNameContent() {
-    delete _imp;
+///Gets the identity and modification time (in nanoseconds) of a directory. Returns false if the platform doesn't provide them.
+static bool getDirectoryStamp(const std::string& path,unsigned long long* device,unsigned long long* inode,long long* modificationTime)
+{
+#ifdef __linux__
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return false;
+    }
+    *device = st.st_dev;
+    *inode = st.st_ino;
+    *modificationTime = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    return true;
+#else
+    (void)path;
+    (void)device;
+    (void)inode;
+    (void)modificationTime;
+    return false;
+#endif
 }
 
-void FileNameContent::operator=(const FileNameContent& other) {
-    _imp->orderedElements = other._imp->orderedElements;
-    _imp->absoluteFileName = other._imp->absoluteFileName;
-    _imp->filename = other._imp->filename;
-    _imp->filePath = other._imp->filePath;
-    _imp->extension = other._imp->extension;
-    _imp->hasSingleNumber = other._imp->hasSingleNumber;
-    _imp->generatedPattern = other._imp->generatedPattern;
-}
+///Batches of a shared listing are kept until all its followers read them, but no more than this many: a follower falling
+///further behind the leader reads the rest of the directory itself. Until the first batch is dropped, the listing can
+///still be joined by new scans.
+#define SHARED_LISTING_MAX_BATCHES 4
+///A follower that waits for the leader longer than this (in milliseconds) reads the rest of the directory itself
+#define SHARED_LISTING_MAX_WAIT_MS 200
+///How often (in milliseconds) a follower waiting for the leader checks whether its scan was cancelled
+#define SHARED_LISTING_CANCEL_CHECK_MS 10
 
-void FileNameContentPrivate::parse(const std::string& absoluteFileName) {
-    this->absoluteFileName = absoluteFileName;
-    filename = absoluteFileName;
-    filePath = removePath(filename);
+/**
+     * @brief The listing of a directory read by a scan (the leader) and shared with the scans of the same directory
+     * started while it is read (the followers), which read the batches of files as the leader appends them.
+     * Only the batches that some follower did not read yet are kept, see SHARED_LISTING_MAX_BATCHES.
+     **/
+struct SharedListing
+{
+    enum State
+    {
+        LISTING_OPENING = 0,
+        LISTING_READING,
+        LISTING_DONE,
+        LISTING_FAILED, //< the directory couldn't be opened
+        LISTING_ABANDONED //< the leader stopped before the end, e.g: its scan was cancelled
+    };
+
+    struct Batch
+    {
+        StringList files;
+        ///the position in the directory following the batch (see DirectoryReader::getPosition), if hasPosition
+        long long position;
+        bool hasPosition;
+        ///the number of followers that did not read the batch yet
+        std::size_t readersLeft;
+    };
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    State state;
+    ///the batches kept, batches[i] being the batch number firstBatch + i of the directory
+    std::deque<Batch> batches;
+    std::size_t firstBatch;
+    std::size_t followersCount;
+
+    SharedListing()
+        : mutex()
+        , changed()
+        , state(LISTING_OPENING)
+        , batches()
+        , firstBatch(0)
+        , followersCount(0)
+    {
+    }
 
-    int i = 0;
-    std::string lastNumberStr;
-    std::string lastTextPart;
-    while (i < (int)filename.size()) {
-        const char& c = filename.at(i);
-        if (std::isdigit(c)) {
-            lastNumberStr += c;
-            if (!lastTextPart.empty()) {
-                orderedElements.push_back(FileNameElement(lastTextPart,FileNameElement::TEXT));
-                lastTextPart.clear();
-            }
-        } else {
-            if (!lastNumberStr.empty()) {
-                orderedElements.push_back(FileNameElement(lastNumberStr,FileNameElement::FRAME_NUMBER));
-                if (!hasSingleNumber) {
-                    hasSingleNumber = true;
-                } else {
-                    hasSingleNumber = false;
-                }
-                lastNumberStr.clear();
-            }
+    ///A scan joining the listing must get all of its batches: none of them must have been dropped. Must be called with mutex locked.
+    bool isJoinable() const
+    {
+        return firstBatch == 0 && (state == LISTING_OPENING || state == LISTING_READING);
+    }
 
-            lastTextPart.push_back(c);
+    ///Appends the files of batch from first on. position is null if the platform gives no position.
+    void append(const StringList& batch,std::size_t first,const long long* position)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (followersCount == 0 && firstBatch > 0) {
+                ///no one can read the batch
+                ++firstBatch;
+                return;
+            }
+            batches.push_back(Batch());
+            Batch& added = batches.back();
+            added.files.assign(batch.begin() + first, batch.end());
+            added.position = position ? *position : 0;
+            added.hasPosition = position != 0;
+            added.readersLeft = followersCount;
+            dropBatches();
         }
-        ++i;
+        changed.notify_all();
     }
 
-    if (!lastNumberStr.empty()) {
-        orderedElements.push_back(FileNameElement(lastNumberStr,FileNameElement::FRAME_NUMBER));
-        if (!hasSingleNumber) {
-            hasSingleNumber = true;
-        } else {
-            hasSingleNumber = false;
+    ///Counts the batches from nextBatch on as read by a follower that stops following. Must be called with mutex locked.
+    void detach(std::size_t nextBatch)
+    {
+        --followersCount;
+        for (std::size_t i = nextBatch > firstBatch ? nextBatch - firstBatch : 0; i < batches.size(); ++i) {
+            --batches[i].readersLeft;
         }
-        lastNumberStr.clear();
+        dropBatches();
     }
-    if (!lastTextPart.empty()) {
-        orderedElements.push_back(FileNameElement(lastTextPart,FileNameElement::TEXT));
-        lastTextPart.clear();
+
+    /**
+         * @brief Drops the oldest batches past SHARED_LISTING_MAX_BATCHES and, once the listing can't be joined anymore,
+         * the batches that all the followers read. Must be called with mutex locked.
+         **/
+    void dropBatches()
+    {
+        while ( !batches.empty() &&
+                ( batches.size() > SHARED_LISTING_MAX_BATCHES || (firstBatch > 0 && batches.front().readersLeft == 0) ) ) {
+            batches.pop_front();
+            ++firstBatch;
+        }
     }
+};
 
+///The number of listings led by the current thread. Such a thread never follows a listing: if two threads each leading
+///a listing followed the listing of the other one from their visitor, they would wait for each other.
+static thread_local unsigned int listingsLedByThread = 0;
 
+/**
+     * @brief Makes the scans of a directory that start while another scan of it is reading it share its listing
+     * instead of reading the directory again, see getScanCoordinatorStats().
+     **/
+class ScanCoordinator
+{
+public:
+
+    ScanCoordinator()
+        : _mutex()
+        , _listings()
+        , _scansStarted(0)
+        , _duplicateScansAvoided(0)
+        , _scansTakenOver(0)
+    {
+    }
 
-    size_t lastDotPos = filename.find_last_of('.');
-    if (lastDotPos != std::string::npos) {
-        int j = filename.size() - 1;
-        while (j > 0 && filename.at(j) != '.') {
-            extension.insert(0,1,filename.at(j));
-            --j;
+    /**
+         * @brief Returns the listing of path being read, which the caller then follows, or a new listing that the caller
+         * must read and then pass to finish(), in which case isLeader is set to true.
+         * Returns null if the caller must read the directory without sharing its listing: the listing being read already
+         * dropped some batches or the calling thread leads a listing itself.
+         **/
+    std::shared_ptr<SharedListing> join(const std::string& path,bool* isLeader)
+    {
+        *isLeader = false;
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (listingsLedByThread > 0) {
+            ++_scansStarted;
+            return std::shared_ptr<SharedListing>();
+        }
+        std::shared_ptr<SharedListing>& listing = _listings[path];
+        if (listing) {
+            std::lock_guard<std::mutex> listingLock(listing->mutex);
+            if (listing->isJoinable()) {
+                ++listing->followersCount;
+                for (std::size_t i = 0; i < listing->batches.size(); ++i) {
+                    ++listing->batches[i].readersLeft;
+                }
+                ++_duplicateScansAvoided;
+                return listing;
+            }
         }
+        ///the next scans join the new listing
+        listing = std::make_shared<SharedListing>();
+        *isLeader = true;
+        ++listingsLedByThread;
+        ++_scansStarted;
+        return listing;
     }
 
-    ///now build the generated pattern with the ordered elements.
-    int numberIndex = 0;
-    for (unsigned int j = 0; j < orderedElements.size(); ++j) {
-        const FileNameElement& e = orderedElements[j];
-        switch (e.type) {
-        case FileNameElement::TEXT:
-            generatedPattern.append(e.data);
-            break;
-        case FileNameElement::FRAME_NUMBER:
+    ///Sets the final state of a listing: the next scans of its directory will read it again. Must be called by the leader.
+    void finish(const std::string& path,const std::shared_ptr<SharedListing>& listing,SharedListing::State state)
+    {
+        --listingsLedByThread;
         {
-            std::string hashStr;
-            int c = 0;
-            while (c < (int)e.data.size()) {
-                hashStr.push_back('#');
-                ++c;
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::unordered_map<std::string,std::shared_ptr<SharedListing> >::iterator found = _listings.find(path);
+            if (found != _listings.end() && found->second == listing) {
+                _listings.erase(found);
             }
-            generatedPattern.append(hashStr + stringFromInt(numberIndex));
-            ++numberIndex;
-        } break;
-        default:
-            break;
         }
+        {
+            std::lock_guard<std::mutex> lock(listing->mutex);
+            listing->state = state;
+        }
+        listing->changed.notify_all();
     }
 
-}
-
-StringList FileNameContent::getAllTextElements() const {
-    StringList ret;
-    for (unsigned int i = 0; i < _imp->orderedElements.size(); ++i) {
-        if (_imp->orderedElements[i].type == FileNameElement::TEXT) {
-            ret.push_back(_imp->orderedElements[i].data);
+    void setReading(const std::shared_ptr<SharedListing>& listing)
+    {
+        {
+            std::lock_guard<std::mutex> lock(listing->mutex);
+            listing->state = SharedListing::LISTING_READING;
         }
+        listing->changed.notify_all();
     }
-    return ret;
-}
 
-/**
-     * @brief Returns the file path, e.g: /Users/Lala/Pictures/ with the trailing separator.
-     **/
-const std::string& FileNameContent::getPath() const {
-    return _imp->filePath;
-}
+    void countTakeOver()
+    {
+        ++_scansTakenOver;
+    }
 
-/**
-     * @brief Returns the filename without its path.
-     **/
-const std::string& FileNameContent::fileName() const {
-    return _imp->filename;
-}
+    SequenceParsing::ScanCoordinatorStats getStats() const
+    {
+        SequenceParsing::ScanCoordinatorStats ret;
+        ret.scansStarted = _scansStarted;
+        ret.duplicateScansAvoided = _duplicateScansAvoided;
+        ret.scansTakenOver = _scansTakenOver;
+        return ret;
+    }
 
-/**
-     * @brief Returns the absolute filename as it was given in the constructor arguments.
-     **/
-const std::string& FileNameContent::absoluteFileName() const {
-    return _imp->absoluteFileName;
-}
+    void resetStats()
+    {
+        _scansStarted = 0;
+        _duplicateScansAvoided = 0;
+        _scansTakenOver = 0;
+    }
 
-const std::string& FileNameContent::getExtension() const {
-    return _imp->extension;
-}
+private:
 
+    std::mutex _mutex;
+    ///the listings being read, by path
+    std::unordered_map<std::string,std::shared_ptr<SharedListing> > _listings;
+    std::atomic<unsigned long long> _scansStarted;
+    std::atomic<unsigned long long> _duplicateScansAvoided;
+    std::atomic<unsigned long long> _scansTakenOver;
+};
 
-/**
-     * @brief Returns true if a single number was found in the filename.
-     **/
-bool FileNameContent::hasSingleNumber() const {
-    return _imp->hasSingleNumber;
+static ScanCoordinator& getScanCoordinator()
+{
+    static ScanCoordinator coordinator;
+    return coordinator;
 }
 
-/**
-     * @brief Returns true if the filename is composed only of digits.
-     **/
-bool FileNameContent::isFileNameComposedOnlyOfDigits() const {
-    if ((_imp->orderedElements.size() == 1 || _imp->orderedElements.size() == 2)
-            && _imp->orderedElements[0].type == FileNameElement::FRAME_NUMBER) {
-        return true;
-    } else {
-        return false;
-    }
-}
+///Upper bound of the number of threads running the asynchronous scans given no executor. Like the sizes,
+///they mostly wait for the file system.
+#define SCAN_POOL_MAX_THREADS 8
 
 /**
-     * @brief Returns the file pattern found in the filename with hash characters style for frame number (i.e: ###)
+     * @brief Runs the tasks of the asynchronous scans given no executor, on up to SCAN_POOL_MAX_THREADS threads
+     * started on demand: the tasks beyond are queued.
+     * It is destroyed at exit before the ScanCoordinator: the tasks not started yet are dropped (their futures
+     * get a broken promise) and the threads are joined once their running task is done, so no scan outlives it.
      **/
-const std::string& FileNameContent::getFilePattern() const {
-    return _imp->generatedPattern;
-}
+class ScanThreadPool
+{
+public:
+
+    ScanThreadPool()
+        : _mutex()
+        , _wakeUp()
+        , _tasks()
+        , _threads()
+        , _idleThreadsCount(0)
+        , _stopping(false)
+    {
+        ///constructed first, the coordinator is destroyed after the pool
+        getScanCoordinator();
+    }
 
-/**
-     * @brief If the filename is composed of several numbers (e.g: file08_001.png),
-     * this functions returns the number at index as a string that will be stored in numberString.
-     * If Index is greater than the number of numbers in the filename or if this filename doesn't
-     * contain any number, this function returns false.
-     **/
-bool FileNameContent::getNumberByIndex(int index,std::string* numberString) const {
+    ~ScanThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+            _tasks.clear();
+        }
+        _wakeUp.notify_all();
+        for (std::size_t i = 0; i < _threads.size(); ++i) {
+            _threads[i].join();
+        }
+    }
 
-    int numbersElementsIndex = 0;
-    for (unsigned int i = 0; i < _imp->orderedElements.size(); ++i) {
+    void push(const std::function<void ()>& task)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push_back(task);
+        if (_tasks.size() > _idleThreadsCount && _threads.size() < SCAN_POOL_MAX_THREADS) {
+            _threads.push_back(std::thread(&ScanThreadPool::run, this));
+        } else {
+            _wakeUp.notify_one();
+        }
+    }
+
+private:
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (;;) {
+            ++_idleThreadsCount;
+            _wakeUp.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+            --_idleThreadsCount;
+            if (_stopping) {
+                return;
+            }
+            std::function<void ()> task = std::move(_tasks.front());
+            _tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _wakeUp;
+    std::deque< std::function<void ()> > _tasks;
+    std::vector<std::thread> _threads;
+    std::size_t _idleThreadsCount;
+    bool _stopping;
+};
+
+static ScanThreadPool& getScanThreadPool()
+{
+    static ScanThreadPool pool;
+    return pool;
+}
+
+/**
+     * @brief Reads the files of a directory like DirectoryReader::readBatch(files), but from the installed ScanCache
+     * if the directory didn't change since it was cached, which costs a single stat.
+     * Otherwise, if another scan is already reading the directory, its listing is shared (see ScanCoordinator).
+     * If not, the directory is read and its listing is stored in the cache once it has been read entirely.
+     **/
+class FilesListingReader
+{
+public:
+
+    ///token, if not null, is checked while waiting for the scan whose listing is shared
+    FilesListingReader(const SequenceParsing::ScanToken* token = 0)
+        : _reader()
+        , _token(token)
+        , _cache(getInstalledScanCache())
+        , _device(0)
+        , _inode(0)
+        , _modificationTime(0)
+        , _cachedFiles()
+        , _cachedFilesIndex(0)
+        , _readFiles()
+        , _path()
+        , _listing()
+        , _isLeader(false)
+        , _nextBatch(0)
+        , _position(0)
+        , _hasPosition(false)
+        , _servedFiles()
+    {
+    }
+
+    ~FilesListingReader()
+    {
+        abandon();
+    }
+
+    ///Returns false if the directory couldn't be opened.
+    bool open(const std::string& path)
+    {
+        abandon();
+        _cache.acquire();
+        _cachedFiles.reset();
+        _cachedFilesIndex = 0;
+        _readFiles.clear();
+        _nextBatch = 0;
+        _hasPosition = false;
+        _servedFiles.clear();
+        if (_cache.get() && !getDirectoryStamp(path, &_device, &_inode, &_modificationTime)) {
+            _cache.release();
+        }
+        if (_cache.get() && _cache->findFilesList(_device, _inode, _modificationTime, &_cachedFiles)) {
+            _cache.release();
+            return true;
+        }
+        if (_cache.get() && (long long)std::time(0) - _modificationTime / 1000000000LL < SCAN_CACHE_MIN_AGE) {
+            _cache.release();
+        }
+
+        _path = path;
+        _listing = getScanCoordinator().join(path, &_isLeader);
+        if (!_listing) {
+            return _reader.open(path);
+        }
+        if (_isLeader) {
+            if (!_reader.open(path)) {
+                getScanCoordinator().finish(_path, _listing, SharedListing::LISTING_FAILED);
+                _listing.reset();
+                _isLeader = false;
+                return false;
+            }
+            getScanCoordinator().setReading(_listing);
+            return true;
+        }
+
+        std::unique_lock<std::mutex> lock(_listing->mutex);
+        waitForLeader(lock);
+        if (_listing->state == SharedListing::LISTING_FAILED) {
+            stopFollowing(lock);
+            return false;
+        }
+        if (_listing->state == SharedListing::LISTING_OPENING) {
+            ///the leader is too slow, or the scan was cancelled
+            stopFollowing(lock);
+            return _reader.open(path);
+        }
+        return true;
+    }
+
+    /**
+         * @brief Same as DirectoryReader::readBatch(files). If the token is cancelled while waiting for the scan whose
+         * listing is shared, returns true without appending anything: the caller checks the token before the next batch.
+         **/
+    bool readBatch(StringList* files)
+    {
+        if (_cachedFiles) {
+            if (_cachedFilesIndex == _cachedFiles->size()) {
+                return false;
+            }
+            ///serve the cached files by batches too, so that the callers checking for cancellation still do
+            const std::size_t count = std::min<std::size_t>(CACHED_BATCH_SIZE, _cachedFiles->size() - _cachedFilesIndex);
+            files->insert(files->end(), _cachedFiles->begin() + _cachedFilesIndex, _cachedFiles->begin() + _cachedFilesIndex + count);
+            _cachedFilesIndex += count;
+            return true;
+        }
+        if (_listing && !_isLeader) {
+            return readSharedBatch(files);
+        }
+
+        const std::size_t firstFile = files->size();
+        if (!_listing) {
+            if (!readOwnBatch(files)) {
+                storeInCache();
+                return false;
+            }
+        } else {
+            if (!_reader.readBatch(files)) {
+                storeInCache();
+                getScanCoordinator().finish(_path, _listing, SharedListing::LISTING_DONE);
+                _listing.reset();
+                _isLeader = false;
+                return false;
+            }
+            long long position;
+            _listing->append(*files, firstFile, _reader.getPosition(&position) ? &position : 0);
+        }
+        if (_cache.get()) {
+            _readFiles.insert(_readFiles.end(), files->begin() + firstFile, files->end());
+        }
+        return true;
+    }
+
+private:
+
+    void storeInCache()
+    {
+        if (_cache.get()) {
+            _cache->storeFilesList(_device, _inode, _modificationTime, _readFiles);
+            _cache.release();
+            _readFiles.clear();
+        }
+    }
+
+    ///Reads the directory without sharing the listing, skipping the files already served from a listing followed
+    bool readOwnBatch(StringList* files)
+    {
+        if (_servedFiles.empty()) {
+            return _reader.readBatch(files);
+        }
+        StringList batch;
+        if (!_reader.readBatch(&batch)) {
+            return false;
+        }
+        for (StringList::iterator it = batch.begin(); it != batch.end(); ++it) {
+            if (!_servedFiles.count(*it)) {
+                files->push_back(std::move(*it));
+            }
+        }
+        return true;
+    }
+
+    /**
+         * @brief Waits until the leader opened the directory and appended the next batch to read, or stopped.
+         * Gives up after SHARED_LISTING_MAX_WAIT_MS or once the token is cancelled.
+         **/
+    void waitForLeader(std::unique_lock<std::mutex>& lock)
+    {
+        const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(SHARED_LISTING_MAX_WAIT_MS);
+        for (;;) {
+            const SharedListing::State state = _listing->state;
+            if ( state != SharedListing::LISTING_OPENING &&
+                 ( state != SharedListing::LISTING_READING || _nextBatch < _listing->firstBatch + _listing->batches.size() ) ) {
+                return;
+            }
+            if ( _token && _token->isCancelled() ) {
+                return;
+            }
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (now >= deadline) {
+                return;
+            }
+            _listing->changed.wait_for( lock, std::min<std::chrono::steady_clock::duration>(
+                                            deadline - now, std::chrono::milliseconds(SHARED_LISTING_CANCEL_CHECK_MS) ) );
+        }
+    }
+
+    void stopFollowing(std::unique_lock<std::mutex>& lock)
+    {
+        _listing->detach(_nextBatch);
+        lock.unlock();
+        _listing.reset();
+    }
+
+    ///Reads the next batch appended by the leader, waiting for it if needed
+    bool readSharedBatch(StringList* files)
+    {
+        std::unique_lock<std::mutex> lock(_listing->mutex);
+        waitForLeader(lock);
+        if ( _nextBatch >= _listing->firstBatch && _nextBatch < _listing->firstBatch + _listing->batches.size() ) {
+            SharedListing::Batch& batch = _listing->batches[_nextBatch - _listing->firstBatch];
+            files->insert(files->end(), batch.files.begin(), batch.files.end());
+            _hasPosition = batch.hasPosition;
+            _position = batch.position;
+            if (!batch.hasPosition) {
+                _servedFiles.insert(batch.files.begin(), batch.files.end());
+            }
+            --batch.readersLeft;
+            ++_nextBatch;
+            _listing->dropBatches();
+            return true;
+        }
+        if (_nextBatch >= _listing->firstBatch && _listing->state == SharedListing::LISTING_DONE) {
+            stopFollowing(lock);
+            return false;
+        }
+        if ( _nextBatch >= _listing->firstBatch && _listing->state == SharedListing::LISTING_READING &&
+             _token && _token->isCancelled() ) {
+            return true;
+        }
+
+        ///the leader stopped before the end, is too slow or went past the batches kept:
+        ///read the rest of the directory, from where the last batch read ended
+        stopFollowing(lock);
+        _cache.release();
+        getScanCoordinator().countTakeOver();
+        if (!_reader.open(_path)) {
+            return false;
+        }
+        if (_hasPosition && _nextBatch > 0) {
+            if (!_reader.seek(_position)) {
+                return false;
+            }
+            _servedFiles.clear();
+        }
+        return readOwnBatch(files);
+    }
+
+    ///Lets the followers know that the leader stopped reading, or the leader that this follower stopped following
+    void abandon()
+    {
+        if (_listing && _isLeader) {
+            getScanCoordinator().finish(_path, _listing, SharedListing::LISTING_ABANDONED);
+        } else if (_listing) {
+            std::unique_lock<std::mutex> lock(_listing->mutex);
+            stopFollowing(lock);
+        }
+        _listing.reset();
+        _isLeader = false;
+        _reader.close();
+    }
+
+    enum { CACHED_BATCH_SIZE = 4096 };
+
+    DirectoryReader _reader;
+    const SequenceParsing::ScanToken* _token;
+    ///the cache to read from or to store the listing in, null if there is none
+    InstalledObjectUse<SequenceParsing::ScanCache> _cache;
+    unsigned long long _device;
+    unsigned long long _inode;
+    long long _modificationTime;
+    std::shared_ptr<const StringList> _cachedFiles;
+    ///the files of _cachedFiles already read
+    std::size_t _cachedFilesIndex;
+    ///the files read so far, to be stored in _cache
+    StringList _readFiles;
+    std::string _path;
+    ///the listing led or followed, null if the directory is read without sharing its listing
+    std::shared_ptr<SharedListing> _listing;
+    bool _isLeader;
+    ///the number of the next batch of the listing followed
+    std::size_t _nextBatch;
+    ///the position following the last batch read from the listing followed, if _hasPosition
+    long long _position;
+    bool _hasPosition;
+    ///the files served from a listing that gives no position, to skip them when reading the directory again
+    std::unordered_set<std::string> _servedFiles;
+};
+
+///Lists the names of all the files of a directory. Returns false if the directory couldn't be opened.
+static bool getFilesFromDir(const std::string& path,StringList* ret)
+{
+    FilesListingReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+    while (reader.readBatch(ret)) {
+    }
+    return true;
+}
+
+///Files are dispatched to the workers by chunks of this size when their sizes are computed
+#define FILE_SIZES_CHUNK 64
+///Upper bound of the number of threads used to compute the files sizes. Most of the time is spent
+///waiting for the file system, so this is not tied to the number of cores.
+#define FILE_SIZES_MAX_THREADS 16
+
+/**
+     * @brief Runs work(first,last) over [0,count) split in chunks of chunkSize, on up to maxThreads threads
+     * (the calling thread included). Returns once all the chunks have been processed.
+     **/
+template <typename Work>
+static void parallelForChunks(std::size_t count,std::size_t chunkSize,unsigned int maxThreads,Work& work)
+{
+    const std::size_t chunksCount = (count + chunkSize - 1) / chunkSize;
+    unsigned int threadsCount = std::min<std::size_t>(maxThreads, chunksCount);
+    if (threadsCount <= 1) {
+        work(0, count);
+        return;
+    }
+
+    std::atomic<std::size_t> nextChunk(0);
+    std::function<void()> worker = [&]() {
+        for (std::size_t chunk = nextChunk++; chunk < chunksCount; chunk = nextChunk++) {
+            std::size_t first = chunk * chunkSize;
+            work(first, std::min(first + chunkSize, count));
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(threadsCount - 1);
+    for (unsigned int i = 1; i < threadsCount; ++i) {
+        threads.push_back(std::thread(worker));
+    }
+    worker();
+    for (unsigned int i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+}
+
+/**
+     * @brief A pool of threads running tasks that spawn other tasks, e.g: the scan of a directory spawns
+     * the scans of its sub-directories. Each thread has its own queue of tasks: the tasks it spawns are pushed
+     * to the back of its queue and it pops them from the back (depth first, which keeps its working set small).
+     * Once its queue is empty it steals from the front of the queue of another thread, i.e: the oldest tasks
+     * which are usually the biggest sub-trees, so that threads rarely have to steal twice in a row.
+     * The thread calling wait() works as well: a pool of N threads spawns N - 1 threads.
+     **/
+class WorkStealingPool
+{
+public:
+
+    ///A task receives the index of the thread running it, in [0, getThreadsCount())
+    typedef std::function<void(unsigned int)> Task;
+
+    explicit WorkStealingPool(unsigned int threadsCount);
+
+    ~WorkStealingPool();
+
+    unsigned int getThreadsCount() const {
+        return (unsigned int)_queues.size();
+    }
+
+    ///Adds a task to the pool. It can be called from a task, in which case the task goes to the queue of its thread.
+    void push(const Task& task);
+
+    ///Runs the tasks in the calling thread, as the thread of index 0, until all the tasks (and the tasks they spawned) are done
+    void wait();
+
+private:
+
+    WorkStealingPool(const WorkStealingPool&);
+    void operator=(const WorkStealingPool&);
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    ///Pops a task from the queue of the given thread or steals one from another thread
+    bool takeTask(unsigned int threadIndex,Task* task);
+
+    void runTask(unsigned int threadIndex,const Task& task);
+
+    void runThread(unsigned int threadIndex);
+
+    std::vector<std::unique_ptr<Queue> > _queues;
+    std::vector<std::thread> _threads;
+
+    ///the number of tasks pushed but not finished, and the number of tasks waiting in the queues
+    std::atomic<std::size_t> _pendingCount;
+    std::atomic<std::size_t> _queuedCount;
+    std::atomic<unsigned int> _nextQueue;
+
+    std::mutex _sleepMutex;
+    std::condition_variable _wakeUp;
+    bool _stopping;
+
+    ///the pool and the index of the calling thread if it is running a task
+    static thread_local WorkStealingPool* _currentPool;
+    static thread_local unsigned int _currentThreadIndex;
+};
+
+thread_local WorkStealingPool* WorkStealingPool::_currentPool = 0;
+thread_local unsigned int WorkStealingPool::_currentThreadIndex = 0;
+
+WorkStealingPool::WorkStealingPool(unsigned int threadsCount)
+    : _queues()
+    , _threads()
+    , _pendingCount(0)
+    , _queuedCount(0)
+    , _nextQueue(0)
+    , _sleepMutex()
+    , _wakeUp()
+    , _stopping(false)
+{
+    threadsCount = std::max(threadsCount, 1u);
+    for (unsigned int i = 0; i < threadsCount; ++i) {
+        _queues.push_back(std::unique_ptr<Queue>(new Queue));
+    }
+    for (unsigned int i = 1; i < threadsCount; ++i) {
+        _threads.push_back(std::thread(&WorkStealingPool::runThread, this, i));
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stopping = true;
+    }
+    _wakeUp.notify_all();
+    for (unsigned int i = 0; i < _threads.size(); ++i) {
+        _threads[i].join();
+    }
+}
+
+void WorkStealingPool::push(const Task& task)
+{
+    unsigned int queueIndex = _currentPool == this ? _currentThreadIndex : _nextQueue++ % _queues.size();
+    ++_pendingCount;
+    {
+        std::lock_guard<std::mutex> lock(_queues[queueIndex]->mutex);
+        _queues[queueIndex]->tasks.push_back(task);
+    }
+    ++_queuedCount;
+    ///lock so that a thread that just found the queues empty is either waiting or about to see the new task
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+    }
+    _wakeUp.notify_one();
+}
+
+bool WorkStealingPool::takeTask(unsigned int threadIndex,Task* task)
+{
+    if (_queuedCount == 0) {
+        return false;
+    }
+    {
+        Queue& queue = *_queues[threadIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            *task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            --_queuedCount;
+            return true;
+        }
+    }
+    for (unsigned int i = 1; i < _queues.size(); ++i) {
+        Queue& queue = *_queues[(threadIndex + i) % _queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            *task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            --_queuedCount;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::runTask(unsigned int threadIndex,const Task& task)
+{
+    WorkStealingPool* previousPool = _currentPool;
+    unsigned int previousThreadIndex = _currentThreadIndex;
+    _currentPool = this;
+    _currentThreadIndex = threadIndex;
+    task(threadIndex);
+    _currentPool = previousPool;
+    _currentThreadIndex = previousThreadIndex;
+    if (--_pendingCount == 0) {
+        ///wake up the thread in wait()
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+        }
+        _wakeUp.notify_all();
+    }
+}
+
+void WorkStealingPool::runThread(unsigned int threadIndex)
+{
+    Task task;
+    for (;;) {
+        if (takeTask(threadIndex, &task)) {
+            runTask(threadIndex, task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _wakeUp.wait(lock, [this]() { return _stopping || _queuedCount > 0; });
+        if (_stopping) {
+            return;
+        }
+    }
+}
+
+void WorkStealingPool::wait()
+{
+    Task task;
+    while (_pendingCount > 0) {
+        if (takeTask(0, &task)) {
+            runTask(0, task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _wakeUp.wait(lock, [this]() { return _pendingCount == 0 || _queuedCount > 0; });
+    }
+}
+
+///Returns true if name matches glob, where * matches any number of characters and ? a single one
+static bool matchesGlob(const char* name,const char* glob)
+{
+    ///on a mismatch, backtrack to the last * and let it match one more character
+    const char* starGlob = 0;
+    const char* starName = 0;
+    while (*name) {
+        if (*glob == '*') {
+            starGlob = ++glob;
+            starName = name;
+        } else if (*glob != '\0' && (*glob == '?' || *glob == *name)) {
+            ++glob;
+            ++name;
+        } else if (starGlob) {
+            glob = starGlob;
+            name = ++starName;
+        } else {
+            return false;
+        }
+    }
+    while (*glob == '*') {
+        ++glob;
+    }
+    return *glob == '\0';
+}
+
+static bool matchesAnyGlob(const std::string& name,const StringList& globs)
+{
+    for (StringList::const_iterator it = globs.begin(); it != globs.end(); ++it) {
+        if (matchesGlob(name.c_str(), it->c_str())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+     * @brief The state of SequenceFromFiles::getSequencesOutOfDirectoryTree shared by the threads of the pool.
+     * Scanning a directory lists its entries, pushes the scans of its sub-directories to the pool and
+     * then groups its files in sequences. The results are stored per thread so that threads never wait for each other.
+     **/
+struct DirectoryTreeScan
+{
+    ///the sequences of a directory
+    struct DirectorySequences
+    {
+        std::string path;
+        std::vector<SequenceParsing::SequenceFromFiles> sequences;
+
+        bool operator<(const DirectorySequences& other) const {
+            return path < other.path;
+        }
+    };
+
+    const SequenceParsing::DirectoryTreeOptions& options;
+    WorkStealingPool pool;
+    std::vector< std::vector<DirectorySequences> > results;
+
+    ///the identities of the directories scanned so far, only used when following links
+    std::mutex visitedMutex;
+    std::set< std::pair<unsigned long long,unsigned long long> > visited;
+
+    DirectoryTreeScan(const SequenceParsing::DirectoryTreeOptions& options,unsigned int threadsCount)
+        : options(options)
+        , pool(threadsCount)
+        , results(threadsCount)
+        , visitedMutex()
+        , visited()
+    {
+    }
+
+    ///Scans the directory path, which has a trailing separator. Returns false if it couldn't be opened.
+    bool scan(const std::string& path,int depth,unsigned int threadIndex);
+};
+
+bool DirectoryTreeScan::scan(const std::string& path,int depth,unsigned int threadIndex)
+{
+    DirectoryReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+    unsigned long long device,inode;
+    if (options.symlinkPolicy == SequenceParsing::DirectoryTreeOptions::FOLLOW_SYMLINKS && reader.getIdentity(&device, &inode)) {
+        std::lock_guard<std::mutex> lock(visitedMutex);
+        if (!visited.insert(std::make_pair(device, inode)).second) {
+            return true;
+        }
+    }
+
+    StringList files,directories;
+    StringList* subDirectories = options.maxDepth < 0 || depth < options.maxDepth ? &directories : 0;
+    while (reader.readBatch(&files, subDirectories, options.symlinkPolicy)) {
+    }
+    reader.close();
+
+    for (StringList::iterator it = directories.begin(); it != directories.end(); ++it) {
+        if (matchesAnyGlob(*it, options.excludeGlobs)) {
+            continue;
+        }
+        std::string subDirectory = path + *it + '/';
+        pool.push([this, subDirectory, depth](unsigned int index) {
+            scan(subDirectory, depth + 1, index);
+        });
+    }
+
+    StringList absoluteFileNames;
+    absoluteFileNames.reserve(files.size());
+    for (StringList::iterator it = files.begin(); it != files.end(); ++it) {
+        if ((options.includeGlobs.empty() || matchesAnyGlob(*it, options.includeGlobs)) && !matchesAnyGlob(*it, options.excludeGlobs)) {
+            absoluteFileNames.push_back(path + *it);
+        }
+    }
+    if (!absoluteFileNames.empty()) {
+        results[threadIndex].push_back(DirectorySequences());
+        results[threadIndex].back().path = path;
+        SequenceParsing::SequenceFromFiles::getSequencesOutOfFiles(absoluteFileNames, &results[threadIndex].back().sequences,
+                                                                   options.enableSizeEstimation);
+    }
+    return true;
+}
+
+/**
+     * @brief Fills sizes with the size in bytes of each of the given files of the directory path.
+     * The files are stat'ed relatively to a single directory descriptor (without ever opening them)
+     * by a pool of threads. Files that cannot be stat'ed count as 0 bytes.
+     * Once cancelled (if not null) is set, the files that are not stat'ed yet are skipped and count as 0 bytes as well.
+     **/
+static void getFilesSizes(const std::string& path,const std::vector<const char*>& fileNames,std::vector<unsigned long long>* sizes,
+                          const std::atomic<bool>* cancelled = 0)
+{
+    sizes->assign(fileNames.size(), 0);
+    if (fileNames.empty()) {
+        return;
+    }
+
+#ifdef __linux__
+    int dirFd = ::open(path.empty() ? "." : path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd == -1) {
+        return;
+    }
+    std::function<void(std::size_t,std::size_t)> work = [&](std::size_t first,std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            if (cancelled && cancelled->load(std::memory_order_relaxed)) {
+                return;
+            }
+#ifdef STATX_SIZE
+            ///only ask for the size, and accept the attributes cached by network file systems
+            struct statx stx;
+            if (::statx(dirFd, fileNames[i], AT_STATX_DONT_SYNC, STATX_SIZE, &stx) == 0) {
+                (*sizes)[i] = stx.stx_size;
+                continue;
+            } else if (errno != ENOSYS) {
+                continue;
+            }
+#endif
+            struct stat st;
+            if (::fstatat(dirFd, fileNames[i], &st, 0) == 0) {
+                (*sizes)[i] = st.st_size;
+            }
+        }
+    };
+#else
+    std::function<void(std::size_t,std::size_t)> work = [&](std::size_t first,std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            if (cancelled && cancelled->load(std::memory_order_relaxed)) {
+                return;
+            }
+            std::ifstream file((path + fileNames[i]).c_str(), std::ios::binary | std::ios::ate);
+            if (file) {
+                (*sizes)[i] = file.tellg();
+            }
+        }
+    };
+#endif
+
+    parallelForChunks(fileNames.size(), FILE_SIZES_CHUNK, FILE_SIZES_MAX_THREADS, work);
+
+#ifdef __linux__
+    ::close(dirFd);
+#endif
+}
+
+///Returns the cumulated sizes in bytes of the given files of the directory path. @see getFilesSizes
+static unsigned long long getFilesTotalSize(const std::string& path,const std::vector<const char*>& fileNames,
+                                            const std::atomic<bool>* cancelled = 0)
+{
+    std::vector<unsigned long long> sizes;
+    getFilesSizes(path, fileNames, &sizes, cancelled);
+    unsigned long long totalSize = 0;
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+        totalSize += sizes[i];
+    }
+    return totalSize;
+}
+
+/**
+     * @brief Sets the type of the variable (and its digits count if it is a frame number) depending on its token.
+     **/
+static void setVariableType(SequenceParsing::PatternVariable* variable) {
+    const std::string& token = variable->token;
+    variable->digitsCount = 0;
+    if (token == "%v") {
+        variable->type = SequenceParsing::PatternVariable::SHORT_VIEW;
+    } else if (token == "%V") {
+        variable->type = SequenceParsing::PatternVariable::LONG_VIEW;
+    } else if (token.find('#') != std::string::npos) {
+        variable->type = SequenceParsing::PatternVariable::FRAME_NUMBER_HASHES;
+        variable->digitsCount = token.size();
+    } else if (startsWith(token,"%0") && endsWith(token,"d")) {
+        variable->type = SequenceParsing::PatternVariable::FRAME_NUMBER_PADDED;
+        std::string digitsCountStr = token;
+        removeAllOccurences(digitsCountStr, "%0");
+        removeAllOccurences(digitsCountStr, "d");
+        variable->digitsCount = stringToInt(digitsCountStr);
+    } else if (token == "%d") {
+        variable->type = SequenceParsing::PatternVariable::FRAME_NUMBER;
+    } else {
+        variable->type = SequenceParsing::PatternVariable::UNSUPPORTED;
+    }
+}
+
+static bool isAsciiDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+///64 bits version of lowestBitIndex
+static int lowestBitIndex64(unsigned long long mask)
+{
+#if _MSC_VER && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return (int)index;
+#elif _MSC_VER
+    return (unsigned int)mask ? lowestBitIndex((unsigned int)mask) : 32 + lowestBitIndex((unsigned int)(mask >> 32));
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+///Sets bit i % 64 of masks[i / 64] if str[i] is a digit, the bits past length being left to 0
+typedef void (*ComputeDigitsMasksFunc)(const char* str,size_t length,unsigned long long* masks);
+
+static void computeDigitsMasksScalar(const char* str,size_t length,unsigned long long* masks)
+{
+    for (size_t block = 0; block * 64 < length; ++block) {
+        const size_t count = std::min<size_t>(64, length - block * 64);
+        unsigned long long mask = 0;
+        for (size_t i = 0; i < count; ++i) {
+            mask |= (unsigned long long)isAsciiDigit(str[block * 64 + i]) << i;
+        }
+        masks[block] = mask;
+    }
+}
+
+#ifdef SEQUENCEPARSING_SSE2
+///'0'-'9' are shifted to the bottom of the signed range so a single signed comparison finds them
+static unsigned long long digitsMask16(const char* str)
+{
+    const __m128i shifted = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)str), _mm_set1_epi8((char)('0' + 128)));
+    return (unsigned int)_mm_movemask_epi8(_mm_cmplt_epi8(shifted, _mm_set1_epi8(-128 + 10)));
+}
+
+static void computeDigitsMasksSSE2(const char* str,size_t length,unsigned long long* masks)
+{
+    for (size_t block = 0; block * 64 < length; ++block) {
+        const size_t count = std::min<size_t>(64, length - block * 64);
+        const char* blockStr = str + block * 64;
+        ///the last block is copied so that the loads do not read past the string
+        char padded[64];
+        if (count < 64) {
+            std::memset(padded, 0, sizeof(padded));
+            std::memcpy(padded, blockStr, count);
+            blockStr = padded;
+        }
+        masks[block] = digitsMask16(blockStr) | digitsMask16(blockStr + 16) << 16 |
+                digitsMask16(blockStr + 32) << 32 | digitsMask16(blockStr + 48) << 48;
+    }
+}
+#endif
+
+#ifdef SEQUENCEPARSING_AVX2
+SEQUENCEPARSING_TARGET_AVX2
+static void computeDigitsMasksAVX2(const char* str,size_t length,unsigned long long* masks)
+{
+    const __m256i offset = _mm256_set1_epi8((char)('0' + 128));
+    const __m256i limit = _mm256_set1_epi8(-128 + 10);
+    for (size_t block = 0; block * 64 < length; ++block) {
+        const size_t count = std::min<size_t>(64, length - block * 64);
+        const char* blockStr = str + block * 64;
+        char padded[64];
+        if (count < 64) {
+            std::memset(padded, 0, sizeof(padded));
+            std::memcpy(padded, blockStr, count);
+            blockStr = padded;
+        }
+        const __m256i low = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)blockStr), offset);
+        const __m256i high = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)(blockStr + 32)), offset);
+        masks[block] = (unsigned int)_mm256_movemask_epi8(_mm256_cmpgt_epi8(limit, low)) |
+                (unsigned long long)(unsigned int)_mm256_movemask_epi8(_mm256_cmpgt_epi8(limit, high)) << 32;
+    }
+}
+#endif
+
+static ComputeDigitsMasksFunc selectComputeDigitsMasks()
+{
+    switch (getSimdLevel()) {
+#ifdef SEQUENCEPARSING_AVX2
+    case SIMD_AVX2:
+        return computeDigitsMasksAVX2;
+#endif
+#ifdef SEQUENCEPARSING_SSE2
+    case SIMD_SSE2:
+        return computeDigitsMasksSSE2;
+#endif
+    default:
+        return computeDigitsMasksScalar;
+    }
+}
+
+/**
+     * @brief Splits a string in digits runs and text runs. The string is classified 16 or 32 characters at a time
+     * with the instruction set given by getSimdLevel(), into a bit mask of its digits:
+     * the run boundaries are then found from the bit positions without looking at the characters again.
+     **/
+class DigitsRuns
+{
+public:
+
+    ///Only str[offset] to str[length - 1] are classified, e.g: to skip the path of a file, but the indexes
+    ///given to and returned by the methods are still offsets in str.
+    DigitsRuns(const char* str,size_t length,size_t offset = 0)
+        : _heapMasks()
+        , _masks(_inlineMasks)
+        , _offset(offset)
+        , _length(length - offset)
+    {
+        static const ComputeDigitsMasksFunc computeDigitsMasks = selectComputeDigitsMasks();
+        const size_t blocksCount = (_length + 63) / 64;
+        if (blocksCount > INLINE_BLOCKS) {
+            _heapMasks.resize(blocksCount);
+            _masks = &_heapMasks[0];
+        }
+        computeDigitsMasks(str + offset, _length, _masks);
+    }
+
+    bool isDigit(size_t i) const
+    {
+        i -= _offset;
+        return (_masks[i / 64] >> (i % 64)) & 1;
+    }
+
+    ///Returns the end of the run starting at pos, that is the first index from pos whose character is not a digit
+    ///if inDigits, or is a digit otherwise. Returns the string length if there is none.
+    size_t findRunEnd(size_t pos,bool inDigits) const
+    {
+        pos -= _offset;
+        if (pos >= _length) {
+            return _offset + _length;
+        }
+        const unsigned long long flip = inDigits ? ~0ULL : 0;
+        size_t block = pos / 64;
+        ///the bits of the characters ending the run
+        unsigned long long ends = (_masks[block] ^ flip) & (~0ULL << (pos % 64));
+        while (!ends) {
+            if (++block * 64 >= _length) {
+                return _offset + _length;
+            }
+            ends = _masks[block] ^ flip;
+        }
+        return _offset + std::min(block * 64 + lowestBitIndex64(ends), _length);
+    }
+
+private:
+
+    ///the masks of filenames up to 256 characters do not need an allocation
+    enum { INLINE_BLOCKS = 4 };
+
+    unsigned long long _inlineMasks[INLINE_BLOCKS];
+    std::vector<unsigned long long> _heapMasks;
+    unsigned long long* _masks;
+    size_t _offset;
+    size_t _length;
+};
+
+///case insensitive comparison of the beginning of str with the lower case prefix
+static bool startsWithLowerCasePrefix(const char* str,size_t length,const char* prefix,size_t prefixLength)
+{
+    if (length < prefixLength) {
+        return false;
+    }
+    for (size_t i = 0; i < prefixLength; ++i) {
+        if (asciiToLower(str[i]) != prefix[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+///Converts a string of digits to an int, saturating to INT_MAX like stringToInt does.
+static int digitsToInt(const char* digits,size_t length)
+{
+    long long ret = 0;
+    for (size_t i = 0; i < length; ++i) {
+        ret = ret * 10 + (digits[i] - '0');
+        if (ret > INT_MAX) {
+            return INT_MAX;
+        }
+    }
+    return (int)ret;
+}
+
+/**
+     * @brief An Aho-Corasick automaton finding all the occurrences of a set of strings in a single scan.
+     * Bytes that do not appear in any string share the same input class so the transition table stays tiny.
+     **/
+class StringsAutomaton
+{
+public:
+
+    StringsAutomaton()
+        : _classes()
+        , _classesCount(1)
+        , _transitions()
+        , _outputsOffsets(1, 0)
+        , _outputs()
+    {
+        std::fill(_classes, _classes + 256, 0);
+    }
+
+    void compile(const StringList& strings);
+
+    int getStatesCount() const
+    {
+        return (int)_outputsOffsets.size() - 1;
+    }
+
+    ///the initial state is 0
+    int nextState(int state,char c) const
+    {
+        return _transitions[state * _classesCount + _classes[(unsigned char)c]];
+    }
+
+    ///The indexes of the strings ending at the last character fed when reaching state are in [begin,end).
+    ///The string at index i is the one at index i of the list given to compile.
+    const int* getOutputsBegin(int state) const
+    {
+        return _outputs.empty() ? 0 : &_outputs[0] + _outputsOffsets[state];
+    }
+
+    const int* getOutputsEnd(int state) const
+    {
+        return _outputs.empty() ? 0 : &_outputs[0] + _outputsOffsets[state + 1];
+    }
+
+private:
+
+    ///input class of each byte, 0 for bytes not found in any string
+    unsigned char _classes[256];
+    int _classesCount;
+    ///state * _classesCount + class -> next state
+    std::vector<int> _transitions;
+    ///the outputs of state s are _outputs[_outputsOffsets[s]] to _outputs[_outputsOffsets[s + 1]]
+    std::vector<int> _outputsOffsets;
+    std::vector<int> _outputs;
+};
+
+void StringsAutomaton::compile(const StringList& strings)
+{
+    std::fill(_classes, _classes + 256, 0);
+    _classesCount = 1;
+    _transitions.clear();
+    _outputsOffsets.assign(1, 0);
+    _outputs.clear();
+
+    for (unsigned int i = 0; i < strings.size(); ++i) {
+        for (unsigned int j = 0; j < strings[i].size(); ++j) {
+            unsigned char c = strings[i][j];
+            if (_classes[c] == 0) {
+                _classes[c] = _classesCount++;
+            }
+        }
+    }
+
+    ///build the trie, -1 meaning no transition yet
+    std::vector< std::vector<int> > trie(1, std::vector<int>(_classesCount, -1));
+    std::vector< std::vector<int> > outputs(1);
+    for (unsigned int i = 0; i < strings.size(); ++i) {
+        int state = 0;
+        for (unsigned int j = 0; j < strings[i].size(); ++j) {
+            int c = _classes[(unsigned char)strings[i][j]];
+            if (trie[state][c] == -1) {
+                trie[state][c] = trie.size();
+                trie.push_back(std::vector<int>(_classesCount, -1));
+                outputs.push_back(std::vector<int>());
+            }
+            state = trie[state][c];
+        }
+        outputs[state].push_back(i);
+    }
+
+    ///turn the trie in a deterministic automaton with a breadth-first traversal, following failure links
+    std::vector<int> failure(trie.size(), 0);
+    std::vector<int> queue;
+    for (int c = 0; c < _classesCount; ++c) {
+        if (trie[0][c] == -1) {
+            trie[0][c] = 0;
+        } else {
+            failure[trie[0][c]] = 0;
+            queue.push_back(trie[0][c]);
+        }
+    }
+    for (unsigned int q = 0; q < queue.size(); ++q) {
+        int state = queue[q];
+        const std::vector<int>& inherited = outputs[failure[state]];
+        outputs[state].insert(outputs[state].end(), inherited.begin(), inherited.end());
+        for (int c = 0; c < _classesCount; ++c) {
+            int next = trie[state][c];
+            if (next == -1) {
+                trie[state][c] = trie[failure[state]][c];
+            } else {
+                failure[next] = trie[failure[state]][c];
+                queue.push_back(next);
+            }
+        }
+    }
+
+    _transitions.resize(trie.size() * _classesCount);
+    _outputsOffsets.resize(trie.size() + 1);
+    for (unsigned int s = 0; s < trie.size(); ++s) {
+        std::copy(trie[s].begin(), trie[s].end(), _transitions.begin() + s * _classesCount);
+        _outputsOffsets[s] = _outputs.size();
+        _outputs.insert(_outputs.end(), outputs[s].begin(), outputs[s].end());
+    }
+    _outputsOffsets[trie.size()] = _outputs.size();
+}
+
+/**
+     * @brief A matcher compiled once from the common parts and the variables of a pattern.
+     * It scans a filename a single time, without any heap allocation:
+     * - The common parts are searched all at once with an Aho-Corasick automaton.
+     * - The variables are matched by a small state machine that walks the digit runs and view names
+     * of the filename in order.
+     *
+     * Note that if 2 variables have the exact same meaning (e.g: ### and %04d) and they do not correspond to the
+     * same frame number it will reject the filename against the pattern.
+     * @see extractCommonPartsAndVariablesFromPattern
+     **/
+class PatternMatcher
+{
+public:
+
+    PatternMatcher()
+        : _automaton()
+        , _outputs()
+        , _allPartsMask(0)
+        , _commonParts()
+        , _variables()
+    {
+    }
+
+    void compile(const StringList& commonParts,const SequenceParsing::PatternVariables& variables);
+
+    /**
+         * @brief Returns true if filename matches the pattern.
+         * @param frameNumber [out] The frame number found in the filename, 0 if the pattern has no frame number variable.
+         * @param viewNumber [out] The view number found in the filename, -1 if the pattern has no view variable.
+         **/
+    bool match(const char* filename,size_t length,int* frameNumber,int* viewNumber) const
+    {
+        return match(filename, length, true, frameNumber, viewNumber);
+    }
+
+    ///Same as match but the common parts are not searched: the caller knows the filename contains them.
+    bool matchVariables(const char* filename,size_t length,int* frameNumber,int* viewNumber) const
+    {
+        return match(filename, length, false, frameNumber, viewNumber);
+    }
+
+private:
+
+    ///The common parts are tracked with a bit mask: above this count we fallback on plain substring search.
+    enum { MAX_AUTOMATON_PARTS = 64 };
+
+    struct Variable
+    {
+        SequenceParsing::PatternVariable::Type type;
+        int digitsCount;
+        int commonCharactersBefore;
+    };
+
+    bool match(const char* filename,size_t length,bool searchCommonParts,int* frameNumber,int* viewNumber) const;
+
+    bool containsAllCommonParts(const char* filename,size_t length) const;
+
+    bool matchFrameNumber(const Variable& variable,const char* digits,size_t length,int* frameNumber) const;
+
+    bool matchViewName(const Variable& variable,bool isShortName,int viewNumber,int* ret) const;
+
+    StringsAutomaton _automaton;
+    ///for each state of the automaton, the mask of the common parts found when reaching it
+    std::vector<unsigned long long> _outputs;
+    unsigned long long _allPartsMask;
+    ///only used if there are more than MAX_AUTOMATON_PARTS common parts
+    StringList _commonParts;
+    std::vector<Variable> _variables;
+};
+
+void PatternMatcher::compile(const StringList& commonParts,const SequenceParsing::PatternVariables& variables)
+{
+    _variables.clear();
+    for (unsigned int i = 0; i < variables.size(); ++i) {
+        Variable v;
+        v.type = variables[i].type;
+        v.digitsCount = variables[i].digitsCount;
+        v.commonCharactersBefore = variables[i].commonCharactersBefore;
+        _variables.push_back(v);
+    }
+
+    _automaton.compile(StringList());
+    _outputs.assign(1, 0);
+    _commonParts.clear();
+    _allPartsMask = 0;
+
+#pragma message WARN("This will match common parts that could be longer,e.g: marleen would match marleenBG ")
+    if (commonParts.size() > MAX_AUTOMATON_PARTS) {
+        _commonParts = commonParts;
+        return;
+    }
+
+    _automaton.compile(commonParts);
+    _outputs.assign(_automaton.getStatesCount(), 0);
+    for (int s = 0; s < _automaton.getStatesCount(); ++s) {
+        for (const int* it = _automaton.getOutputsBegin(s); it != _automaton.getOutputsEnd(s); ++it) {
+            _outputs[s] |= 1ULL << *it;
+        }
+    }
+    for (unsigned int i = 0; i < commonParts.size(); ++i) {
+        _allPartsMask |= 1ULL << i;
+    }
+}
+
+bool PatternMatcher::containsAllCommonParts(const char* filename,size_t length) const
+{
+    if (!_commonParts.empty()) {
+        for (unsigned int i = 0; i < _commonParts.size(); ++i) {
+            if (asciiFind(filename, length, _commonParts[i].c_str(), _commonParts[i].size(), 0, true) == std::string::npos) {
+                return false;
+            }
+        }
+        return true;
+    }
+    unsigned long long found = 0;
+    int state = 0;
+    for (size_t i = 0; i < length && found != _allPartsMask; ++i) {
+        state = _automaton.nextState(state, filename[i]);
+        found |= _outputs[state];
+    }
+    return found == _allPartsMask;
+}
+
+bool PatternMatcher::matchFrameNumber(const Variable& variable,const char* digits,size_t length,int* frameNumber) const
+{
+    switch (variable.type) {
+    case SequenceParsing::PatternVariable::FRAME_NUMBER_HASHES:
+    case SequenceParsing::PatternVariable::FRAME_NUMBER_PADDED:
+        if ((int)length < variable.digitsCount) {
+            return false;
+        }
+        ///extra padding on numbers bigger than the hash chars count are not allowed.
+        if ((int)length > variable.digitsCount && digits[0] == '0') {
+            return false;
+        }
+        break;
+    case SequenceParsing::PatternVariable::FRAME_NUMBER:
+        break;
+    default:
+        ///the pattern wasn't expecting a frame number
+        return false;
+    }
+    *frameNumber = digitsToInt(digits, length);
+    return true;
+}
+
+bool PatternMatcher::matchViewName(const Variable& variable,bool isShortName,int viewNumber,int* ret) const
+{
+    switch (variable.type) {
+    case SequenceParsing::PatternVariable::SHORT_VIEW:
+        if (!isShortName) {
+            return false;
+        }
+        *ret = viewNumber;
+        return true;
+    case SequenceParsing::PatternVariable::LONG_VIEW:
+        if (isShortName) {
+            return false;
+        }
+        *ret = viewNumber;
+        return true;
+    case SequenceParsing::PatternVariable::FRAME_NUMBER:
+        ///%d accepts anything, the view name is then read as the number 0
+        *ret = 0;
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool PatternMatcher::match(const char* filename,size_t length,bool searchCommonParts,int* frameNumber,int* viewNumber) const
+{
+    ///initialize the view number
+    *viewNumber = -1;
+    *frameNumber = 0;
+
+    if (_variables.empty()) {
+        return !searchCommonParts || containsAllCommonParts(filename, length);
+    }
+
+    ///the automaton state and the common parts found so far
+    int state = 0;
+    unsigned long long found = 0;
+    const bool useAutomaton = searchCommonParts && _commonParts.empty();
+
+    const int variablesCount = (int)_variables.size();
+    ///the index in _variables to check
+    int nextVariableIndex = 0;
+    ///the number of characters of the filename that did not belong to a variable
+    int commonCharactersFound = 0;
+    bool wasFrameNumberSet = false;
+    bool wasViewNumberSet = false;
+    ///start of the current digits run, or -1
+    int digitsStart = -1;
+    const DigitsRuns digits(filename, length);
+
+    size_t i = 0;
+    ///the first character not fed to the automaton yet
+    size_t fedUpTo = 0;
+    while (i < length) {
+        const char c = filename[i];
+        if (isAsciiDigit(c)) {
+            digitsStart = i;
+            i = digits.findRunEnd(i, true);
+        } else {
+            if (digitsStart != -1) {
+                int fnumber;
+                ///the pattern wasn't expecting a frame number or the digits count doesn't respect the
+                ///hashes character count or the printf-like padding count is wrong.
+                if (nextVariableIndex >= variablesCount ||
+                        _variables[nextVariableIndex].commonCharactersBefore != commonCharactersFound ||
+                        !matchFrameNumber(_variables[nextVariableIndex], filename + digitsStart, i - digitsStart, &fnumber)) {
+                    return false;
+                }
+                ///a previous frame number variable had a different frame number
+                if (wasFrameNumberSet && fnumber != *frameNumber) {
+                    return false;
+                }
+                ++nextVariableIndex;
+                wasFrameNumberSet = true;
+                *frameNumber = fnumber;
+                digitsStart = -1;
+            }
+
+            const Variable* variable = nextVariableIndex < variablesCount ? &_variables[nextVariableIndex] : 0;
+            const bool isVariableHere = variable && variable->commonCharactersBefore == commonCharactersFound;
+            const char* mid = filename + i;
+            const size_t midLength = length - i;
+            const char clower = asciiToLower(c);
+            ///the number of characters consumed by this step
+            size_t consumed = 1;
+            int viewNo = -1;
+
+            ///these are characters that trigger a view name, start looking for a view name
+            if (clower == 'l' && !startsWithLowerCasePrefix(mid, midLength, "left", 4)) {
+                ///don't be so harsh with just short views name because the letter
+                /// 'l' or 'r' might be found somewhere else in the filename, so if theres
+                ///no variable expected here just continue
+                if (isVariableHere && variable->type == SequenceParsing::PatternVariable::SHORT_VIEW) {
+                    viewNo = 0;
+                } else {
+                    ++commonCharactersFound;
+                }
+            } else if (clower == 'r' && !startsWithLowerCasePrefix(mid, midLength, "right", 5)) {
+                if (isVariableHere && variable->type == SequenceParsing::PatternVariable::SHORT_VIEW) {
+                    viewNo = 1;
+                } else {
+                    ++commonCharactersFound;
+                }
+            } else if (clower == 'l' || clower == 'r') {
+                ///the pattern didn't expect a view name here
+                if (!isVariableHere || !matchViewName(*variable, false, clower == 'l' ? 0 : 1, &viewNo)) {
+                    return false;
+                }
+                consumed = clower == 'l' ? 4 : 5;
+            } else if (clower == 'v' && startsWithLowerCasePrefix(mid, midLength, "view", 4)) {
+                ///extract the view number
+                size_t j = digits.findRunEnd(i + 4, true) - i;
+                if (j > 4) {
+                    ///if the variable is %v the view is considered a short name, otherwise a long name
+                    ///this is because for either %v or %V we write view<N>
+                    if (!isVariableHere ||
+                            !matchViewName(*variable, variable->type == SequenceParsing::PatternVariable::SHORT_VIEW,
+                                           digitsToInt(mid + 4, j - 4), &viewNo)) {
+                        return false;
+                    }
+                } else {
+                    commonCharactersFound += 4;
+                }
+                consumed = j;
+            } else {
+                ++commonCharactersFound;
+            }
+
+            if (viewNo != -1) {
+                ///the view number doesn't correspond to a previous view variable
+                if (wasViewNumberSet && viewNo != *viewNumber) {
+                    return false;
+                }
+                wasViewNumberSet = true;
+                *viewNumber = viewNo;
+                ++nextVariableIndex;
+            }
+            i += consumed;
+        }
+
+        if (useAutomaton) {
+            ///feed the automaton with the characters consumed by this step
+            for (; fedUpTo < i; ++fedUpTo) {
+                state = _automaton.nextState(state, filename[fedUpTo]);
+                found |= _outputs[state];
+            }
+        }
+    }
+
+    ///a trailing digits run is not considered to be a variable
+    if (nextVariableIndex != variablesCount) {
+        return false;
+    }
+    if (useAutomaton) {
+        for (; fedUpTo < length; ++fedUpTo) {
+            state = _automaton.nextState(state, filename[fedUpTo]);
+            found |= _outputs[state];
+        }
+        return found == _allPartsMask;
+    }
+    return !searchCommonParts || containsAllCommonParts(filename, length);
+}
+
+/**
+     * @brief Matches a filename against many patterns in a single scan, so that classifying the files of a
+     * directory costs about the same whatever the number of patterns:
+     * - The distinct common parts of all the patterns are searched at once with one automaton.
+     * - Each pattern is keyed on its longest common part: only the patterns whose key was found are candidates,
+     * and only the candidates having all their common parts found get their variables matched.
+     **/
+class MultiPatternMatcher
+{
+public:
+
+    struct Match
+    {
+        int patternIndex;
+        int frameNumber;
+        int viewNumber;
+    };
+
+    ///The per-thread state of match, so that a compiled matcher can be shared by several threads
+    struct Scratch
+    {
+        ///foundStamps[i] == stamp if the common part i was found in the filename being matched
+        std::vector<unsigned int> foundStamps;
+        unsigned int stamp;
+        std::vector<int> foundParts;
+
+        Scratch()
+            : foundStamps()
+            , stamp(0)
+            , foundParts()
+        {
+        }
+    };
+
+    MultiPatternMatcher()
+        : _automaton()
+        , _parts()
+        , _partsIndexes()
+        , _patterns()
+        , _keyedPatterns()
+        , _unkeyedPatterns()
+    {
+    }
+
+    ///Adds a valid pattern, its index in the matches is the number of patterns added before it
+    void addPattern(const SequenceParsing::CompiledPattern& pattern);
+
+    ///Must be called once all the patterns were added and before match
+    void compile();
+
+    ///Appends to matches the patterns that filename matches
+    void match(const char* filename,size_t length,Scratch* scratch,std::vector<Match>* matches) const;
+
+private:
+
+    struct Pattern
+    {
+        PatternMatcher matcher;
+        ///the indexes in _parts of the distinct common parts of the pattern
+        std::vector<int> parts;
+    };
+
+    StringsAutomaton _automaton;
+    ///the distinct common parts of all the patterns
+    StringList _parts;
+    std::unordered_map<std::string,int> _partsIndexes;
+    std::vector<Pattern> _patterns;
+    ///for each common part, the patterns keyed on it
+    std::vector< std::vector<int> > _keyedPatterns;
+    ///the patterns without common parts, always candidates
+    std::vector<int> _unkeyedPatterns;
+};
+
+void MultiPatternMatcher::addPattern(const SequenceParsing::CompiledPattern& pattern)
+{
+    const StringList& commonParts = pattern.getCommonParts();
+    _patterns.push_back(Pattern());
+    Pattern& p = _patterns.back();
+    p.matcher.compile(commonParts, pattern.getVariables());
+
+    int key = -1;
+    for (unsigned int i = 0; i < commonParts.size(); ++i) {
+        std::pair<std::unordered_map<std::string,int>::iterator,bool> ret =
+                _partsIndexes.insert(std::make_pair(commonParts[i], (int)_parts.size()));
+        if (ret.second) {
+            _parts.push_back(commonParts[i]);
+            _keyedPatterns.push_back(std::vector<int>());
+        }
+        int part = ret.first->second;
+        if (std::find(p.parts.begin(), p.parts.end(), part) != p.parts.end()) {
+            continue;
+        }
+        p.parts.push_back(part);
+        if (key == -1 || _parts[part].size() > _parts[key].size()) {
+            key = part;
+        }
+    }
+    if (key == -1) {
+        _unkeyedPatterns.push_back((int)_patterns.size() - 1);
+    } else {
+        _keyedPatterns[key].push_back((int)_patterns.size() - 1);
+    }
+}
+
+void MultiPatternMatcher::compile()
+{
+    _automaton.compile(_parts);
+}
+
+void MultiPatternMatcher::match(const char* filename,size_t length,Scratch* scratch,std::vector<Match>* matches) const
+{
+    if (scratch->foundStamps.size() != _parts.size()) {
+        scratch->foundStamps.assign(_parts.size(), 0);
+        scratch->stamp = 0;
+    }
+    ///a new stamp clears the parts found in the previous filename
+    if (++scratch->stamp == 0) {
+        std::fill(scratch->foundStamps.begin(), scratch->foundStamps.end(), 0);
+        scratch->stamp = 1;
+    }
+    scratch->foundParts.clear();
+
+    int state = 0;
+    for (size_t i = 0; i < length; ++i) {
+        state = _automaton.nextState(state, filename[i]);
+        for (const int* it = _automaton.getOutputsBegin(state); it != _automaton.getOutputsEnd(state); ++it) {
+            if (scratch->foundStamps[*it] != scratch->stamp) {
+                scratch->foundStamps[*it] = scratch->stamp;
+                scratch->foundParts.push_back(*it);
+            }
+        }
+    }
+
+    Match m;
+    for (unsigned int i = 0; i < scratch->foundParts.size(); ++i) {
+        const std::vector<int>& candidates = _keyedPatterns[scratch->foundParts[i]];
+        for (unsigned int j = 0; j < candidates.size(); ++j) {
+            const Pattern& p = _patterns[candidates[j]];
+            bool allFound = true;
+            for (unsigned int k = 0; k < p.parts.size() && allFound; ++k) {
+                allFound = scratch->foundStamps[p.parts[k]] == scratch->stamp;
+            }
+            if (allFound && p.matcher.matchVariables(filename, length, &m.frameNumber, &m.viewNumber)) {
+                m.patternIndex = candidates[j];
+                matches->push_back(m);
+            }
+        }
+    }
+    for (unsigned int i = 0; i < _unkeyedPatterns.size(); ++i) {
+        if (_patterns[_unkeyedPatterns[i]].matcher.matchVariables(filename, length, &m.frameNumber, &m.viewNumber)) {
+            m.patternIndex = _unkeyedPatterns[i];
+            matches->push_back(m);
+        }
+    }
+}
+
+
+
+
+/**
+     * @brief What's needed to tell whether files may belong to the same sequence, @see computeFileLayout
+     **/
+struct FileLayout
+{
+    ///the path and the filename where each digit run was replaced by a '\0' character.
+    std::string key;
+    ///offset and length in the absolute file name of each digit run of the filename
+    std::vector< std::pair<int,int> > digitRuns;
+};
+
+/**
+     * @brief Computes the layout of a file: files of the same sequence are in the same directory, have the same
+     * text parts and the same number of digit runs at the same places in the name. Only the digits may differ.
+     * Since a file name cannot contain a '\0' character, two files can only belong to the same sequence if they
+     * have the same key.
+     **/
+static void computeFileLayout(const std::string& absoluteFileName,FileLayout* layout)
+{
+    size_t nameStart = absoluteFileName.find_last_of('/');
+    if (nameStart == std::string::npos) {
+        nameStart = absoluteFileName.find_last_of('\\');
+    }
+    nameStart = nameStart == std::string::npos ? 0 : nameStart + 1;
+
+    layout->key.assign(absoluteFileName, 0, nameStart);
+    layout->digitRuns.clear();
+    const DigitsRuns digits(absoluteFileName.data(), absoluteFileName.size(), nameStart);
+    size_t i = nameStart;
+    while (i < absoluteFileName.size()) {
+        if (isAsciiDigit(absoluteFileName[i])) {
+            size_t runStart = i;
+            i = digits.findRunEnd(i, true);
+            layout->digitRuns.push_back(std::make_pair((int)runStart, (int)(i - runStart)));
+            layout->key.push_back('\0');
+        } else {
+            layout->key.push_back(absoluteFileName[i]);
+            ++i;
+        }
+    }
+}
+
+struct FileIndexLess
+{
+    const StringList& files;
+
+    FileIndexLess(const StringList& files)
+        : files(files)
+    {
+    }
+
+    bool operator()(int a,int b) const {
+        return files[a] < files[b];
+    }
+};
+
+/**
+     * @brief Files of a bucket that share all their digit runs but the one at numberIndex.
+     **/
+struct FilesGroup
+{
+    int numberIndex;
+    std::vector<int> files;
+
+    bool operator<(const FilesGroup& other) const {
+        ///bigger groups first, then the right-most number as it is more likely to be the frame number
+        if (files.size() != other.files.size()) {
+            return files.size() > other.files.size();
+        } else if (numberIndex != other.numberIndex) {
+            return numberIndex > other.numberIndex;
+        }
+        return files[0] < other.files[0];
+    }
+};
+
+/**
+     * @brief A set of frame numbers stored as disjoint runs of frames with a constant stride, e.g: 1-100 or 1-99 by 2.
+     * Each run also holds a layout, i.e: an index telling how the file names of its frames are written.
+     * Runs of different layouts are never merged. Insertions and lookups are O(log(runs)).
+     **/
+class FrameRunSet
+{
+public:
+
+    ///A run has either a single frame (and a stride of 1) or at least 3 frames: 2 frames
+    ///are not enough to tell the stride of the sequence.
+    struct Run
+    {
+        int last;
+        int stride;
+        int layout;
+    };
+
+    ///the runs mapped to their first frame
+    typedef std::map<int,Run> Runs;
+
+    FrameRunSet()
+        : _runs()
+        , _framesCount(0)
+    {
+    }
+
+    ///Inserts the frame with the given layout. Returns false if the frame is already in the set, whatever its layout.
+    bool insert(int frame,int layout);
+
+    ///Returns true if the frame is in the set, and its layout in layout.
+    bool find(int frame,int* layout) const;
+
+    const Runs& getRuns() const { return _runs; }
+
+    std::size_t getFramesCount() const { return _framesCount; }
+
+    static std::size_t getRunFramesCount(int first,const Run& run) {
+        return (std::size_t)(((long long)run.last - first) / run.stride) + 1;
+    }
+
+private:
+
+    ///Splits the run in 2 single frames if it has only 2 frames
+    void splitPair(Runs::iterator it);
+
+    ///Merges the run it with its neighbours if the result still has a constant stride.
+    ///Returns true if it merged, it is then the merged run.
+    bool mergeAround(Runs::iterator* it);
+
+    Runs _runs;
+    std::size_t _framesCount;
+};
+
+bool FrameRunSet::insert(int frame,int layout)
+{
+    Runs::iterator next = _runs.upper_bound(frame);
+    if (next != _runs.begin()) {
+        Runs::iterator prev = next;
+        --prev;
+        if (frame <= prev->second.last) {
+            long long offset = ((long long)frame - prev->first) % prev->second.stride;
+            if (offset == 0) {
+                return false;
+            }
+            ///the frame falls between 2 frames of a strided run: split it around the frame
+            Run tail = prev->second;
+            int before = frame - (int)offset;
+            int after = before + prev->second.stride;
+            prev->second.last = before;
+            if (after == tail.last) {
+                tail.stride = 1;
+            }
+            next = _runs.insert(next, std::make_pair(after, tail));
+            if (before == prev->first) {
+                prev->second.stride = 1;
+            }
+            splitPair(prev);
+            splitPair(next);
+            next = _runs.upper_bound(frame);
+        }
+    }
+
+    Run single = { frame, 1, layout };
+    Runs::iterator it = _runs.insert(next, std::make_pair(frame, single));
+    ++_framesCount;
+    while (mergeAround(&it)) {
+    }
+    return true;
+}
+
+void FrameRunSet::splitPair(Runs::iterator it)
+{
+    if (it->first != it->second.last && getRunFramesCount(it->first, it->second) == 2) {
+        Run single = { it->second.last, 1, it->second.layout };
+        it->second.last = it->first;
+        it->second.stride = 1;
+        _runs.insert(std::make_pair(single.last, single));
+    }
+}
+
+bool FrameRunSet::mergeAround(Runs::iterator* it)
+{
+    Runs::iterator runs[5]; //< the 2 runs before it, it, the 2 runs after it. end() if there is none
+    runs[2] = *it;
+    runs[1] = runs[0] = runs[3] = runs[4] = _runs.end();
+    if (runs[2] != _runs.begin()) {
+        runs[1] = runs[2];
+        --runs[1];
+        if (runs[1] != _runs.begin()) {
+            runs[0] = runs[1];
+            --runs[0];
+        }
+    }
+    runs[3] = runs[2];
+    ++runs[3];
+    if (runs[3] != _runs.end()) {
+        runs[4] = runs[3];
+        ++runs[4];
+    }
+
+    const int layout = runs[2]->second.layout;
+    bool single[5];
+    for (int i = 0; i < 5; ++i) {
+        if (runs[i] != _runs.end() && runs[i]->second.layout != layout) {
+            runs[i] = _runs.end();
+        }
+        single[i] = runs[i] != _runs.end() && runs[i]->first == runs[i]->second.last;
+    }
+    if (runs[1] == _runs.end()) {
+        runs[0] = _runs.end();
+        single[0] = false;
+    }
+    if (runs[3] == _runs.end()) {
+        runs[4] = _runs.end();
+        single[4] = false;
+    }
+
+    ///a run followed by a run with the same stride, or by a single frame at the stride distance
+    for (int i = 1; i <= 2; ++i) {
+        Runs::iterator left = runs[i];
+        Runs::iterator right = runs[i + 1];
+        if (left == _runs.end() || right == _runs.end() || (single[i] && single[i + 1])) {
+            continue;
+        }
+        const long long gap = (long long)right->first - left->second.last;
+        const int stride = single[i] ? right->second.stride : left->second.stride;
+        if (gap == stride && (single[i] || single[i + 1] || left->second.stride == right->second.stride)) {
+            left->second.last = right->second.last;
+            left->second.stride = stride;
+            _runs.erase(right);
+            *it = left;
+            return true;
+        }
+    }
+
+    ///3 single frames evenly spaced
+    for (int i = 0; i <= 2; ++i) {
+        if (single[i] && single[i + 1] && single[i + 2] &&
+            (long long)runs[i + 1]->first - runs[i]->first == (long long)runs[i + 2]->first - runs[i + 1]->first) {
+            runs[i]->second.last = runs[i + 2]->first;
+            runs[i]->second.stride = runs[i + 1]->first - runs[i]->first;
+            _runs.erase(runs[i + 1]);
+            _runs.erase(runs[i + 2]);
+            *it = runs[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FrameRunSet::find(int frame,int* layout) const
+{
+    Runs::const_iterator it = _runs.upper_bound(frame);
+    if (it == _runs.begin()) {
+        return false;
+    }
+    --it;
+    if (frame > it->second.last || ((long long)frame - it->first) % it->second.stride != 0) {
+        return false;
+    }
+    *layout = it->second.layout;
+    return true;
+}
+
+}
+
+
+namespace SequenceParsing {
+/**
+     * @brief A small structure representing an element of a file name.
+     * It can be either a text part, or a view part or a frame number part.
+     * The element does not own its characters: it is a span of the absolute file name
+     * of the FileNameContent it belongs to. Numbers are decoded once when the name is parsed.
+     **/
+struct FileNameElement {
+
+    enum Type { TEXT = 0  , FRAME_NUMBER };
+
+    FileNameElement(std::size_t offset,std::size_t length,FileNameElement::Type type,int value,bool hasLeadingZeroes)
+        : offset(offset)
+        , length(length)
+        , type(type)
+        , value(value)
+        , hasLeadingZeroes(hasLeadingZeroes)
+    {}
+
+    std::size_t offset; //< offset of the element in the absolute file name
+    std::size_t length;
+    Type type;
+    int value; //< the value of a number, saturated to INT_MAX. 0 for a text part
+    bool hasLeadingZeroes; //< true if a number has more than 1 digit and starts with a 0
+
+    ///Returns true if this number and other have the same digits
+    bool isSameNumber(const FileNameElement& other,const std::string& name,const std::string& otherName) const {
+        if (length != other.length || value != other.value) {
+            return false;
+        }
+        ///saturated values do not tell the digits apart
+        return value != INT_MAX || name.compare(offset, length, otherName, other.offset, other.length) == 0;
+    }
+
+    ///Returns true if this number and other differ in a way a frame number could
+    bool isPotentialFrameNumber(const FileNameElement& other,const std::string& name,const std::string& otherName) const {
+        if (isSameNumber(other, name, otherName)) {
+            return false;
+        }
+        ///if one frame number string is longer than the other, make sure it is because the represented number
+        ///is bigger and not because there's extra padding
+        /// For example 10000 couldve been produced with ## only and is valid, and 01 would also produce be ##.
+        /// On the other hand 010000 could never have been produced with ## hence it is not valid.
+        return length == other.length || (!hasLeadingZeroes && !other.hasLeadingZeroes);
+    }
+};
+
+
+////////////////////FileNameContent//////////////////////////
+
+struct FileNameContentPrivate {
+    ///The only copy of the file name, every other part is a span of it
+    std::string absoluteFileName;
+    ///Ordered from left to right, these are the elements composing the filename without its path
+    std::vector<FileNameElement> orderedElements;
+    std::size_t fileNameOffset; //< where the filename without path starts, i.e: the size of the path
+    std::size_t extensionOffset; //< where the extension (without the dot) starts, npos if there's none
+    bool hasSingleNumber;
+
+    FileNameContentPrivate()
+        : absoluteFileName()
+        , orderedElements()
+        , fileNameOffset(0)
+        , extensionOffset(std::string::npos)
+        , hasSingleNumber(false)
+    {
+    }
+
+    void parse(const std::string& absoluteFileName);
+
+    std::string_view getElement(const FileNameElement& e) const {
+        return std::string_view(absoluteFileName.data() + e.offset, e.length);
+    }
+
+    std::string_view getPath() const {
+        return std::string_view(absoluteFileName.data(), fileNameOffset);
+    }
+
+    std::string_view getFileName() const {
+        return std::string_view(absoluteFileName.data() + fileNameOffset, absoluteFileName.size() - fileNameOffset);
+    }
+
+    std::string_view getExtension() const {
+        if (extensionOffset == std::string::npos) {
+            return std::string_view();
+        }
+        return std::string_view(absoluteFileName.data() + extensionOffset, absoluteFileName.size() - extensionOffset);
+    }
+};
+
+
+FileNameContent::FileNameContent(const std::string& absoluteFilename)
+    : _imp()
+{
+    std::shared_ptr<FileNameContentPrivate> imp = std::make_shared<FileNameContentPrivate>();
+    imp->parse(absoluteFilename);
+    _imp = imp;
+}
+
+FileNameContent::FileNameContent(const FileNameContent& other)
+    : _imp(other._imp)
+{
+}
+
+FileNameContent::FileNameContent(FileNameContent&& other) noexcept
+    : _imp(std::move(other._imp))
+{
+}
+
+FileNameContent::~FileNameContent() {
+}
+
+void FileNameContent::operator=(const FileNameContent& other) {
+    _imp = other._imp;
+}
+
+void FileNameContent::operator=(FileNameContent&& other) noexcept {
+    _imp = std::move(other._imp);
+}
+
+void FileNameContentPrivate::parse(const std::string& absoluteFileName) {
+    this->absoluteFileName = absoluteFileName;
+    const std::string& name = this->absoluteFileName;
+
+    ///find the last separator, the same way removePath does
+    size_t separatorPos = name.find_last_of('/');
+    if (separatorPos == std::string::npos) {
+        separatorPos = name.find_last_of('\\');
+    }
+    fileNameOffset = separatorPos == std::string::npos ? 0 : separatorPos + 1;
+
+    ///count the elements first so they can be allocated at once
+    std::size_t elementsCount = 0;
+    const DigitsRuns digits(name.data(), name.size(), fileNameOffset);
+    for (std::size_t i = fileNameOffset; i < name.size(); i = digits.findRunEnd(i, digits.isDigit(i))) {
+        ++elementsCount;
+    }
+    orderedElements.reserve(elementsCount);
+
+    int numbersCount = 0;
+    std::size_t i = fileNameOffset;
+    while (i < name.size()) {
+        const bool isDigit = digits.isDigit(i);
+        std::size_t end = digits.findRunEnd(i, isDigit);
+        if (isDigit) {
+            orderedElements.push_back(FileNameElement(i, end - i, FileNameElement::FRAME_NUMBER, digitsToInt(name.data() + i, end - i),
+                                                      name[i] == '0' && end - i > 1));
+            ++numbersCount;
+        } else {
+            orderedElements.push_back(FileNameElement(i, end - i, FileNameElement::TEXT, 0, false));
+        }
+        i = end;
+    }
+    ///this flag has always been flipped on each number found
+    hasSingleNumber = numbersCount % 2 == 1;
+
+    size_t lastDotPos = name.find_last_of('.');
+    if (lastDotPos != std::string::npos && lastDotPos >= fileNameOffset) {
+        extensionOffset = lastDotPos + 1;
+    }
+}
+
+StringList FileNameContent::getAllTextElements() const {
+    StringList ret;
+    for (unsigned int i = 0; i < _imp->orderedElements.size(); ++i) {
+        if (_imp->orderedElements[i].type == FileNameElement::TEXT) {
+            ret.push_back(std::string(_imp->getElement(_imp->orderedElements[i])));
+        }
+    }
+    return ret;
+}
+
+/**
+     * @brief Returns the file path, e.g: /Users/Lala/Pictures/ with the trailing separator.
+     **/
+std::string FileNameContent::getPath() const {
+    return std::string(_imp->getPath());
+}
+
+std::string_view FileNameContent::getPathView() const {
+    return _imp->getPath();
+}
+
+/**
+     * @brief Returns the filename without its path.
+     **/
+std::string FileNameContent::fileName() const {
+    return std::string(_imp->getFileName());
+}
+
+std::string_view FileNameContent::fileNameView() const {
+    return _imp->getFileName();
+}
+
+/**
+     * @brief Returns the absolute filename as it was given in the constructor arguments.
+     **/
+const std::string& FileNameContent::absoluteFileName() const {
+    return _imp->absoluteFileName;
+}
+
+std::string FileNameContent::getExtension() const {
+    return std::string(_imp->getExtension());
+}
+
+std::string_view FileNameContent::getExtensionView() const {
+    return _imp->getExtension();
+}
+
+
+std::size_t FileNameContent::getMemoryUsage() const {
+    std::size_t ret = sizeof(FileNameContent) + sizeof(FileNameContentPrivate);
+    ret += stringMemoryUsage(_imp->absoluteFileName);
+    ret += _imp->orderedElements.capacity() * sizeof(FileNameElement);
+    return ret;
+}
+
+/**
+     * @brief Returns true if a single number was found in the filename.
+     **/
+bool FileNameContent::hasSingleNumber() const {
+    return _imp->hasSingleNumber;
+}
+
+/**
+     * @brief Returns true if the filename is composed only of digits.
+     **/
+bool FileNameContent::isFileNameComposedOnlyOfDigits() const {
+    if ((_imp->orderedElements.size() == 1 || _imp->orderedElements.size() == 2)
+            && _imp->orderedElements[0].type == FileNameElement::FRAME_NUMBER) {
+        return true;
+    } else {
+        return false;
+    }
+}
+
+/**
+     * @brief Returns the file pattern found in the filename with hash characters style for frame number (i.e: ###)
+     **/
+std::string FileNameContent::getFilePattern() const {
+    std::string ret;
+    ret.reserve(_imp->absoluteFileName.size() - _imp->fileNameOffset + 2 * _imp->orderedElements.size());
+    int numberIndex = 0;
+    for (unsigned int i = 0; i < _imp->orderedElements.size(); ++i) {
+        const FileNameElement& e = _imp->orderedElements[i];
+        switch (e.type) {
+        case FileNameElement::TEXT:
+            ret.append(_imp->getElement(e));
+            break;
+        case FileNameElement::FRAME_NUMBER:
+            ret.append(e.length, '#');
+            appendInt(&ret, numberIndex, 1);
+            ++numberIndex;
+            break;
+        default:
+            break;
+        }
+    }
+    return ret;
+}
+
+/**
+     * @brief If the filename is composed of several numbers (e.g: file08_001.png),
+     * this functions returns the number at index as a string that will be stored in numberString.
+     * If Index is greater than the number of numbers in the filename or if this filename doesn't
+     * contain any number, this function returns false.
+     **/
+bool FileNameContent::getNumberByIndex(int index,std::string* numberString) const {
+    std::string_view number;
+    if (!getNumberViewByIndex(index, &number)) {
+        return false;
+    }
+    numberString->assign(number);
+    return true;
+}
+
+bool FileNameContent::getDecodedNumberByIndex(int index,FileNameNumber* number) const {
+
+    int numbersElementsIndex = 0;
+    for (unsigned int i = 0; i < _imp->orderedElements.size(); ++i) {
+        const FileNameElement& e = _imp->orderedElements[i];
+        if (e.type == FileNameElement::FRAME_NUMBER) {
+            if (numbersElementsIndex == index) {
+                number->value = e.value;
+                number->digitsCount = (int)e.length;
+                number->hasLeadingZeroes = e.hasLeadingZeroes;
+                return true;
+            }
+            ++numbersElementsIndex;
+        }
+    }
+    return false;
+}
+
+bool FileNameContent::getNumberViewByIndex(int index,std::string_view* numberString) const {
+
+    int numbersElementsIndex = 0;
+    for (unsigned int i = 0; i < _imp->orderedElements.size(); ++i) {
         if (_imp->orderedElements[i].type == FileNameElement::FRAME_NUMBER) {
             if (numbersElementsIndex == index) {
-                *numberString = _imp->orderedElements[i].data;
+                *numberString = _imp->getElement(_imp->orderedElements[i]);
                 return true;
             }
-            ++numbersElementsIndex;
+            ++numbersElementsIndex;
+        }
+    }
+    return false;
+}
+
+/**
+     * @brief Given the pattern of this file, it tries to match the other file name to this
+     * pattern.
+     * @param numberIndexToVary [out] In case the pattern contains several numbers (@see getNumberByIndex)
+     * this value will be fed the appropriate number index that should be used for frame number.
+     * For example, if this filename is myfile001_000.jpg and the other file is myfile001_001.jpg
+     * numberIndexToVary would be 1 as the frame number string indentied in that case is the last number.
+     * @returns True if it identified 'other' as belonging to the same sequence, false otherwise.
+     **/
+bool FileNameContent::matchesPattern(const FileNameContent& other,std::vector<int>* numberIndexesToVary) const {
+    const std::vector<FileNameElement>& elements = _imp->orderedElements;
+    const std::vector<FileNameElement>& otherElements = other._imp->orderedElements;
+    if (otherElements.size() != elements.size()) {
+        return false;
+    }
+
+    ///potential frame numbers are the numbers that differ between this filename and the other filename.
+    ///Among them we pick the ones with the minimum difference: for example if 1 pair is : < 0001, 802398 >
+    ///and the other pair is < 01 , 10 > we pick the second one.
+    ///This is done with the numbers decoded when the filenames were parsed, without building any temporary.
+    long long minimum = LLONG_MAX;
+    for (unsigned int i = 0; i < elements.size(); ++i) {
+        if (elements[i].type != otherElements[i].type) {
+            return false;
+        }
+        if (elements[i].type == FileNameElement::FRAME_NUMBER) {
+            if (elements[i].isPotentialFrameNumber(otherElements[i], _imp->absoluteFileName, other._imp->absoluteFileName)) {
+                minimum = std::min(minimum, std::abs((long long)elements[i].value - otherElements[i].value));
+            }
+        } else if (elements[i].length != otherElements[i].length ||
+                   _imp->absoluteFileName.compare(elements[i].offset, elements[i].length, other._imp->absoluteFileName,
+                                                  otherElements[i].offset, otherElements[i].length) != 0) {
+            return false;
+        }
+    }
+    ///strings are identical
+    if (minimum == LLONG_MAX) {
+        return false;
+    }
+
+    int numbersCount = 0;
+    for (unsigned int i = 0; i < elements.size(); ++i) {
+        if (elements[i].type == FileNameElement::FRAME_NUMBER) {
+            if (elements[i].isPotentialFrameNumber(otherElements[i], _imp->absoluteFileName, other._imp->absoluteFileName) &&
+                std::abs((long long)elements[i].value - otherElements[i].value) == minimum) {
+                numberIndexesToVary->push_back(numbersCount);
+            }
+            ++numbersCount;
+        }
+    }
+    return true;
+
+}
+
+bool FileNameContent::generatePatternWithFrameNumberAtIndexes(const std::vector<int>& indexes,std::string* pattern) const {
+    ///the pattern is written directly out of the elements: the numbers at indexes are replaced
+    ///by hash tags of their width, the others are kept as they are.
+    std::string ret(_imp->getPath());
+    ret.reserve(_imp->absoluteFileName.size());
+    int numbersCount = 0;
+    for (unsigned int i = 0; i < _imp->orderedElements.size(); ++i) {
+        const FileNameElement& e = _imp->orderedElements[i];
+        if (e.type == FileNameElement::FRAME_NUMBER) {
+            bool isNumberAFrameNumber = false;
+            for (unsigned int j = 0; j < indexes.size(); ++j) {
+                if (indexes[j] == numbersCount) {
+                    isNumberAFrameNumber = true;
+                    break;
+                }
+            }
+            if (isNumberAFrameNumber) {
+                ret.append(e.length, '#');
+            } else {
+                ret.append(_imp->getElement(e));
+            }
+            ++numbersCount;
+        } else {
+            ret.append(_imp->getElement(e));
+        }
+    }
+
+    for (unsigned int i = 0; i < indexes.size(); ++i) {
+        ///check that all index is valid.
+        if (indexes[i] >= numbersCount) {
+            return false;
+        }
+    }
+
+    pattern->swap(ret);
+    return true;
+}
+
+
+std::string removePath(std::string& filename) {
+
+    ///find the last separator
+    size_t pos = filename.find_last_of('/');
+    if (pos == std::string::npos) {
+        //try out \\ char
+        pos = filename.find_last_of('\\');
+    }
+    if(pos == std::string::npos) {
+        ///couldn't find a path
+        return "";
+    }
+    std::string path = filename.substr(0,pos+1); // + 1 to include the trailing separator
+    removeAllOccurences(filename, path,true);
+    return path;
+}
+
+
+////////////////////CompiledPattern//////////////////////////
+
+struct CompiledPatternPrivate
+{
+    std::string pattern;
+    std::string path; //< the pattern path with a trailing separator
+    std::string extension; //< the pattern extension without the dot
+    ///the common parts of the filename to find in a file in order for it to match the pattern.
+    StringList commonParts;
+    ///the variables ( ###  %04d %v etc...) found in the pattern ordered from left to right in the
+    ///original string.
+    PatternVariables variables;
+    bool valid;
+    PatternMatcher matcher;
+
+    CompiledPatternPrivate()
+        : pattern()
+        , path()
+        , extension()
+        , commonParts()
+        , variables()
+        , valid(false)
+        , matcher()
+    {
+    }
+
+    void compile(const std::string& pattern);
+};
+
+void CompiledPatternPrivate::compile(const std::string& pattern) {
+    this->pattern = pattern;
+
+    std::string patternUnPathed = pattern;
+    path = removePath(patternUnPathed);
+    extension = removeFileExtension(patternUnPathed);
+
+    ///offset of patternUnPathed in the pattern
+    int offset = path.size();
+
+    ///the pattern has no extension, switch the extension and the unpathed part
+    if (patternUnPathed.empty()) {
+        patternUnPathed = extension;
+        extension.clear();
+        ///skip the dot
+        ++offset;
+    }
+
+    valid = extractCommonPartsAndVariablesFromPattern(patternUnPathed, extension, &commonParts, &variables);
+    valid = valid && !pattern.empty();
+
+    for (PatternVariables::iterator it = variables.begin(); it != variables.end(); ++it) {
+        it->position += offset;
+        setVariableType(&*it);
+        if (it->type == PatternVariable::UNSUPPORTED) {
+            valid = false;
+        }
+    }
+    matcher.compile(commonParts, variables);
+}
+
+CompiledPattern::CompiledPattern(const std::string& pattern)
+    : _imp(new CompiledPatternPrivate())
+{
+    _imp->compile(pattern);
+}
+
+CompiledPattern::CompiledPattern(const CompiledPattern& other)
+    : _imp(new CompiledPatternPrivate())
+{
+    *this = other;
+}
+
+CompiledPattern::~CompiledPattern() {
+    delete _imp;
+}
+
+void CompiledPattern::operator=(const CompiledPattern& other) {
+    *_imp = *other._imp;
+}
+
+bool CompiledPattern::isValid() const {
+    return _imp->valid;
+}
+
+const std::string& CompiledPattern::getPattern() const {
+    return _imp->pattern;
+}
+
+const std::string& CompiledPattern::getPath() const {
+    return _imp->path;
+}
+
+const std::string& CompiledPattern::getExtension() const {
+    return _imp->extension;
+}
+
+const StringList& CompiledPattern::getCommonParts() const {
+    return _imp->commonParts;
+}
+
+const PatternVariables& CompiledPattern::getVariables() const {
+    return _imp->variables;
+}
+
+bool CompiledPattern::matches(const std::string& filename,int* frameNumber,int* viewNumber) const {
+    return matches(filename.c_str(), filename.size(), frameNumber, viewNumber);
+}
+
+bool CompiledPattern::matches(const char* filename,std::size_t length,int* frameNumber,int* viewNumber) const {
+    if (!_imp->valid) {
+        return false;
+    }
+    return _imp->matcher.match(filename, length, frameNumber, viewNumber);
+}
+
+bool filesListFromPattern(const std::string& pattern,SequenceParsing::SequenceFromPattern* sequence) {
+    return filesListFromPattern(CompiledPattern(pattern), sequence);
+}
+
+///Adds to sequence a file that matched its pattern
+static void addMatchingFile(const std::string& absoluteFileName,int frameNumber,int viewNumber,
+                            SequenceParsing::SequenceFromPattern* sequence) {
+    SequenceFromPattern::iterator it = sequence->find(frameNumber);
+    if (it != sequence->end()) {
+        std::pair<std::map<int,std::string>::iterator,bool> ret =
+                it->second.insert(std::make_pair(viewNumber,absoluteFileName));
+        if (!ret.second) {
+            std::cerr << "There was an issue populating the file sequence. Several files with the same frame number"
+                         " have the same view index." << std::endl;
+        }
+    } else {
+        std::map<int, std::string> viewsMap;
+        viewsMap.insert(std::make_pair(viewNumber, absoluteFileName));
+        sequence->insert(std::make_pair(frameNumber, viewsMap));
+    }
+}
+
+///Gathers the visited files in a sequence
+class SequenceFromPatternBuilder : public PatternFilesVisitor {
+public:
+
+    explicit SequenceFromPatternBuilder(SequenceParsing::SequenceFromPattern* sequence)
+        : _sequence(sequence)
+    {
+    }
+
+    virtual bool visitFile(int frameNumber,int viewNumber,const std::string& absoluteFileName) {
+        addMatchingFile(absoluteFileName, frameNumber, viewNumber, _sequence);
+        return true;
+    }
+
+private:
+
+    SequenceParsing::SequenceFromPattern* _sequence;
+};
+
+bool filesListFromPattern(const CompiledPattern& pattern,SequenceParsing::SequenceFromPattern* sequence) {
+    SequenceFromPatternBuilder builder(sequence);
+    return visitFilesFromPattern(pattern, &builder);
+}
+
+bool visitFilesFromPattern(const std::string& pattern,PatternFilesVisitor* visitor) {
+    return visitFilesFromPattern(CompiledPattern(pattern), visitor);
+}
+
+////////////////////ScanToken//////////////////////////
+
+struct ScanTokenPrivate
+{
+    std::atomic<bool> cancelled;
+    std::atomic<std::size_t> entriesScanned;
+    std::atomic<std::size_t> matchesFound;
+    ScanToken::ProgressCallback progressCallback;
+
+    ScanTokenPrivate()
+        : cancelled(false)
+        , entriesScanned(0)
+        , matchesFound(0)
+        , progressCallback()
+    {
+    }
+};
+
+ScanToken::ScanToken()
+    : _imp(std::make_shared<ScanTokenPrivate>())
+{
+}
+
+ScanToken::~ScanToken() {
+}
+
+void ScanToken::cancel() {
+    _imp->cancelled = true;
+}
+
+bool ScanToken::isCancelled() const {
+    return _imp->cancelled;
+}
+
+std::size_t ScanToken::getEntriesScanned() const {
+    return _imp->entriesScanned;
+}
+
+std::size_t ScanToken::getMatchesFound() const {
+    return _imp->matchesFound;
+}
+
+void ScanToken::setProgressCallback(const ProgressCallback& callback) {
+    _imp->progressCallback = callback;
+}
+
+void ScanToken::reportProgress(std::size_t entriesScanned,std::size_t matchesFound) const {
+    entriesScanned = _imp->entriesScanned += entriesScanned;
+    matchesFound = _imp->matchesFound += matchesFound;
+    if (_imp->progressCallback) {
+        _imp->progressCallback(entriesScanned, matchesFound);
+    }
+}
+
+///The scans report their progress through this, ScanToken::reportProgress being private
+class ScanProgressReporter
+{
+public:
+
+    static void report(const ScanToken& token,std::size_t entriesScanned,std::size_t matchesFound)
+    {
+        token.reportProgress(entriesScanned, matchesFound);
+    }
+};
+
+///Runs a task of an asynchronous scan on executor, or on the ScanThreadPool if there is none
+static void runScanTask(const ScanExecutor& executor,const std::function<void ()>& task) {
+    if (executor) {
+        executor(task);
+    } else {
+        getScanThreadPool().push(task);
+    }
+}
+
+///Implementation of visitFilesFromPattern, checking token (if not null) before reading each batch
+static ScanStatus scanFilesFromPattern(const CompiledPattern& pattern,PatternFilesVisitor* visitor,const ScanToken* token) {
+    if (!pattern.isValid()) {
+        return SCAN_FAILED;
+    }
+    FilesListingReader reader(token);
+    if (!reader.open(pattern.getPath())) {
+        return SCAN_FAILED;
+    }
+
+    ///the absolute file name given to the visitor, reused for all the files
+    std::string absoluteFileName = pattern.getPath();
+    const std::size_t pathLength = absoluteFileName.size();
+    StringList batch;
+    for (;;) {
+        if (token && token->isCancelled()) {
+            return SCAN_CANCELLED;
+        }
+        if (!reader.readBatch(&batch)) {
+            break;
+        }
+        std::size_t matchesCount = 0;
+        for (StringList::const_iterator it = batch.begin(); it != batch.end(); ++it) {
+            int frameNumber = 0;
+            int viewNumber = -1;
+            if (pattern.matches(*it, &frameNumber, &viewNumber)) {
+                ++matchesCount;
+                absoluteFileName.replace(pathLength, std::string::npos, *it);
+                if (!visitor->visitFile(frameNumber, viewNumber, absoluteFileName)) {
+                    if (token) {
+                        ScanProgressReporter::report(*token, batch.size(), matchesCount);
+                    }
+                    return SCAN_SUCCEEDED;
+                }
+            }
+        }
+        if (token) {
+            ScanProgressReporter::report(*token, batch.size(), matchesCount);
+        }
+        batch.clear();
+    }
+    return SCAN_SUCCEEDED;
+}
+
+bool visitFilesFromPattern(const CompiledPattern& pattern,PatternFilesVisitor* visitor) {
+    return scanFilesFromPattern(pattern, visitor, 0) == SCAN_SUCCEEDED;
+}
+
+std::future<PatternScanResult> filesListFromPatternAsync(const CompiledPattern& pattern,const ScanToken& token,
+                                                         const ScanExecutor& executor) {
+    std::shared_ptr< std::promise<PatternScanResult> > promise = std::make_shared< std::promise<PatternScanResult> >();
+    std::future<PatternScanResult> ret = promise->get_future();
+    runScanTask(executor, [pattern, token, promise]() {
+        try {
+            PatternScanResult result;
+            SequenceFromPatternBuilder builder(&result.sequence);
+            result.status = scanFilesFromPattern(pattern, &builder, &token);
+            promise->set_value(std::move(result));
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return ret;
+}
+
+int filesListFromPatterns(const StringList& patterns,std::vector<SequenceParsing::SequenceFromPattern>* sequences,
+                          unsigned int threadsCount) {
+    std::vector<CompiledPattern> compiledPatterns;
+    compiledPatterns.reserve(patterns.size());
+    for (StringList::const_iterator it = patterns.begin(); it != patterns.end(); ++it) {
+        compiledPatterns.push_back(CompiledPattern(*it));
+    }
+    return filesListFromPatterns(compiledPatterns, sequences, threadsCount);
+}
+
+int filesListFromPatterns(const std::vector<CompiledPattern>& patterns,std::vector<SequenceParsing::SequenceFromPattern>* sequences,
+                          unsigned int threadsCount) {
+    sequences->assign(patterns.size(), SequenceFromPattern());
+
+    ///group the valid patterns by directory, in the order of their first pattern
+    std::atomic<int> failuresCount(0);
+    std::unordered_map<std::string,std::size_t> directoriesIndexes;
+    std::vector< std::vector<std::size_t> > directories;
+    for (std::size_t i = 0; i < patterns.size(); ++i) {
+        if (!patterns[i].isValid()) {
+            ++failuresCount;
+            continue;
+        }
+        std::pair<std::unordered_map<std::string,std::size_t>::iterator,bool> ret =
+                directoriesIndexes.insert(std::make_pair(patterns[i].getPath(), directories.size()));
+        if (ret.second) {
+            directories.push_back(std::vector<std::size_t>());
+        }
+        directories[ret.first->second].push_back(i);
+    }
+    if (directories.empty()) {
+        return failuresCount;
+    }
+
+    if (threadsCount == 0) {
+        threadsCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    WorkStealingPool pool((unsigned int)std::min<std::size_t>(threadsCount, directories.size()));
+    for (std::size_t d = 0; d < directories.size(); ++d) {
+        const std::vector<std::size_t>& directoryPatterns = directories[d];
+        ///list the directory once, and then classify each of its files against all its patterns in a single scan
+        pool.push([&patterns, &directoryPatterns, &failuresCount, sequences](unsigned int) {
+            const std::string& path = patterns[directoryPatterns[0]].getPath();
+            StringList files;
+            if (!getFilesFromDir(path, &files)) {
+                failuresCount += (int)directoryPatterns.size();
+                return;
+            }
+            MultiPatternMatcher matcher;
+            for (std::size_t i = 0; i < directoryPatterns.size(); ++i) {
+                matcher.addPattern(patterns[directoryPatterns[i]]);
+            }
+            matcher.compile();
+
+            MultiPatternMatcher::Scratch scratch;
+            std::vector<MultiPatternMatcher::Match> matches;
+            for (std::size_t i = 0; i < files.size(); ++i) {
+                matches.clear();
+                matcher.match(files[i].c_str(), files[i].size(), &scratch, &matches);
+                for (std::size_t j = 0; j < matches.size(); ++j) {
+                    addMatchingFile(path + files[i], matches[j].frameNumber, matches[j].viewNumber,
+                                    &(*sequences)[directoryPatterns[matches[j].patternIndex]]);
+                }
+            }
+        });
+    }
+    pool.wait();
+    return failuresCount;
+}
+
+///Works with both SequenceFromPattern and FlatSequenceFromPattern as they can be iterated the same way
+template <typename Sequence>
+static StringList filesListFromSequence(const Sequence& sequence,int onlyViewIndex) {
+    StringList ret;
+    for (typename Sequence::const_iterator it = sequence.begin(); it!=sequence.end(); ++it) {
+        const typename Sequence::mapped_type& views = it->second;
+
+        for (typename Sequence::mapped_type::const_iterator it2 = views.begin(); it2!=views.end(); ++it2) {
+            if (onlyViewIndex != -1 && it2->first != onlyViewIndex && it2->first != -1) {
+                continue;
+            }
+            ret.push_back(it2->second);
+        }
+    }
+    return ret;
+}
+
+StringList sequenceFromPatternToFilesList(const SequenceParsing::SequenceFromPattern& sequence,int onlyViewIndex ) {
+    return filesListFromSequence(sequence, onlyViewIndex);
+}
+
+StringList sequenceFromPatternToFilesList(const SequenceParsing::FlatSequenceFromPattern& sequence,int onlyViewIndex ) {
+    return filesListFromSequence(sequence, onlyViewIndex);
+}
+
+bool filesListFromPattern(const std::string& pattern,SequenceParsing::FlatSequenceFromPattern* sequence) {
+    return filesListFromPattern(CompiledPattern(pattern), sequence);
+}
+
+bool filesListFromPattern(const CompiledPattern& pattern,SequenceParsing::FlatSequenceFromPattern* sequence) {
+    if (!pattern.isValid()) {
+        return false;
+    }
+
+    sequence->reset(pattern.getPath());
+    FilesListingReader reader;
+    if (!reader.open(pattern.getPath())) {
+        return false;
+    }
+
+    ///match the files batch by batch, only the names of the matching files are kept
+    StringList batch;
+    while (reader.readBatch(&batch)) {
+        for (StringList::const_iterator it = batch.begin(); it != batch.end(); ++it) {
+            int frameNumber = 0;
+            int viewNumber = -1;
+            if (pattern.matches(*it, &frameNumber, &viewNumber)) {
+                sequence->addFile(frameNumber, viewNumber, it->c_str(), it->size());
+            }
+        }
+        batch.clear();
+    }
+    if (!sequence->sortFiles()) {
+        std::cerr << "There was an issue populating the file sequence. Several files with the same frame number"
+                     " have the same view index." << std::endl;
+    }
+    return true;
+}
+
+FlatSequenceFromPattern::ViewIterator::ViewIterator()
+    : _sequence(0)
+    , _index(0)
+    , _entry()
+    , _entryValid(false)
+{
+}
+
+FlatSequenceFromPattern::ViewIterator::ViewIterator(const FlatSequenceFromPattern* sequence,std::size_t index)
+    : _sequence(sequence)
+    , _index(index)
+    , _entry()
+    , _entryValid(false)
+{
+}
+
+const FlatSequenceFromPattern::ViewEntry& FlatSequenceFromPattern::ViewIterator::operator*() const {
+    if (!_entryValid) {
+        const File& file = getFile();
+        _entry.first = file.view;
+        _entry.second = _sequence->getAbsoluteFileName(file);
+        _entryValid = true;
+    }
+    return _entry;
+}
+
+const FlatSequenceFromPattern::ViewEntry* FlatSequenceFromPattern::ViewIterator::operator->() const {
+    return &operator*();
+}
+
+FlatSequenceFromPattern::ViewIterator& FlatSequenceFromPattern::ViewIterator::operator++() {
+    ++_index;
+    _entryValid = false;
+    return *this;
+}
+
+FlatSequenceFromPattern::ViewIterator FlatSequenceFromPattern::ViewIterator::operator++(int) {
+    ViewIterator ret = *this;
+    ++*this;
+    return ret;
+}
+
+const FlatSequenceFromPattern::File& FlatSequenceFromPattern::ViewIterator::getFile() const {
+    return _sequence->_files[_index];
+}
+
+FlatSequenceFromPattern::ViewsRange::ViewsRange()
+    : _sequence(0)
+    , _first(0)
+    , _last(0)
+{
+}
+
+FlatSequenceFromPattern::ViewsRange::ViewsRange(const FlatSequenceFromPattern* sequence,std::size_t first,std::size_t last)
+    : _sequence(sequence)
+    , _first(first)
+    , _last(last)
+{
+}
+
+FlatSequenceFromPattern::ViewsRange::const_iterator FlatSequenceFromPattern::ViewsRange::begin() const {
+    return const_iterator(_sequence, _first);
+}
+
+FlatSequenceFromPattern::ViewsRange::const_iterator FlatSequenceFromPattern::ViewsRange::end() const {
+    return const_iterator(_sequence, _last);
+}
+
+FlatSequenceFromPattern::ViewsRange::const_iterator FlatSequenceFromPattern::ViewsRange::find(int view) const {
+    ///a frame has very few views
+    for (std::size_t i = _first; i < _last; ++i) {
+        if (_sequence->getFiles()[i].view == view) {
+            return const_iterator(_sequence, i);
+        }
+    }
+    return end();
+}
+
+FlatSequenceFromPattern::FrameIterator::FrameIterator()
+    : _sequence(0)
+    , _index(0)
+    , _entry()
+{
+}
+
+FlatSequenceFromPattern::FrameIterator::FrameIterator(const FlatSequenceFromPattern* sequence,std::size_t index)
+    : _sequence(sequence)
+    , _index(index)
+    , _entry()
+{
+    updateEntry();
+}
+
+void FlatSequenceFromPattern::FrameIterator::updateEntry() {
+    const std::vector<File>& files = _sequence->_files;
+    if (_index >= files.size()) {
+        _entry = FrameEntry();
+        return;
+    }
+    std::size_t last = _index + 1;
+    while (last < files.size() && files[last].frame == files[_index].frame) {
+        ++last;
+    }
+    _entry.first = files[_index].frame;
+    _entry.second = ViewsRange(_sequence, _index, last);
+}
+
+FlatSequenceFromPattern::FrameIterator& FlatSequenceFromPattern::FrameIterator::operator++() {
+    _index += _entry.second.size();
+    updateEntry();
+    return *this;
+}
+
+FlatSequenceFromPattern::FrameIterator FlatSequenceFromPattern::FrameIterator::operator++(int) {
+    FrameIterator ret = *this;
+    ++*this;
+    return ret;
+}
+
+FlatSequenceFromPattern::FrameIterator& FlatSequenceFromPattern::FrameIterator::operator--() {
+    const std::vector<File>& files = _sequence->_files;
+    assert(_index > 0);
+    --_index;
+    while (_index > 0 && files[_index - 1].frame == files[_index].frame) {
+        --_index;
+    }
+    updateEntry();
+    return *this;
+}
+
+FlatSequenceFromPattern::FrameIterator FlatSequenceFromPattern::FrameIterator::operator--(int) {
+    FrameIterator ret = *this;
+    --*this;
+    return ret;
+}
+
+///orders the files by frame number, view index and then by the order they were added
+struct FlatFileLess
+{
+    bool operator()(const FlatSequenceFromPattern::File& a,const FlatSequenceFromPattern::File& b) const {
+        if (a.frame != b.frame) {
+            return a.frame < b.frame;
+        } else if (a.view != b.view) {
+            return a.view < b.view;
+        }
+        return a.nameOffset < b.nameOffset;
+    }
+};
+
+FlatSequenceFromPattern::FlatSequenceFromPattern()
+    : _path()
+    , _files()
+    , _names()
+    , _framesCount(0)
+{
+}
+
+void FlatSequenceFromPattern::reset(const std::string& path) {
+    _path = path;
+    _files.clear();
+    _names.clear();
+    _framesCount = 0;
+}
+
+void FlatSequenceFromPattern::addFile(int frameNumber,int viewNumber,const char* name,std::size_t length) {
+    File file;
+    file.frame = frameNumber;
+    file.view = viewNumber;
+    file.nameOffset = (unsigned int)_names.size();
+    file.nameLength = (unsigned int)length;
+    _files.push_back(file);
+    _names.append(name, length);
+    _names.push_back('\0');
+}
+
+bool FlatSequenceFromPattern::sortFiles() {
+    std::sort(_files.begin(), _files.end(), FlatFileLess());
+    std::size_t count = 0;
+    _framesCount = 0;
+    for (std::size_t i = 0; i < _files.size(); ++i) {
+        if (count > 0 && _files[i].frame == _files[count - 1].frame && _files[i].view == _files[count - 1].view) {
+            continue;
+        }
+        if (count == 0 || _files[i].frame != _files[count - 1].frame) {
+            ++_framesCount;
+        }
+        _files[count++] = _files[i];
+    }
+    bool unique = count == _files.size();
+    _files.resize(count);
+    return unique;
+}
+
+FlatSequenceFromPattern::const_iterator FlatSequenceFromPattern::begin() const {
+    return const_iterator(this, 0);
+}
+
+FlatSequenceFromPattern::const_iterator FlatSequenceFromPattern::end() const {
+    return const_iterator(this, _files.size());
+}
+
+FlatSequenceFromPattern::const_iterator FlatSequenceFromPattern::find(int frameNumber) const {
+    File key;
+    key.frame = frameNumber;
+    key.view = INT_MIN;
+    key.nameOffset = 0;
+    std::vector<File>::const_iterator found = std::lower_bound(_files.begin(), _files.end(), key, FlatFileLess());
+    if (found == _files.end() || found->frame != frameNumber) {
+        return end();
+    }
+    return const_iterator(this, found - _files.begin());
+}
+
+std::string FlatSequenceFromPattern::getAbsoluteFileName(const File& file) const {
+    std::string ret;
+    ret.reserve(_path.size() + file.nameLength);
+    ret.append(_path);
+    ret.append(_names, file.nameOffset, file.nameLength);
+    return ret;
+}
+
+std::string generateFileNameFromPattern(const std::string& pattern,int frameNumber,int viewNumber) {
+    return generateFileNameFromPattern(CompiledPattern(pattern), frameNumber, viewNumber);
+}
+
+/**
+     * @brief Appends to output the file name of the pattern for the given frame and view.
+     * @param frameSlots [out] If not NULL, it will be fed the offset in output and the length
+     * of each frame number written.
+     **/
+static void appendFileNameFromPattern(const CompiledPattern& pattern,int frameNumber,int viewNumber,
+                                      std::string* output,std::vector< std::pair<size_t,size_t> >* frameSlots) {
+    const std::string& patternStr = pattern.getPattern();
+    const PatternVariables& variablesByOrder = pattern.getVariables();
+
+    ///position in the pattern of the first character that was not copied to the output yet
+    size_t lastVariableEnd = 0;
+    for (unsigned int i = 0; i < variablesByOrder.size(); ++i) {
+        const PatternVariable& variable = variablesByOrder[i];
+        output->append(patternStr, lastVariableEnd, variable.position - lastVariableEnd);
+        lastVariableEnd = variable.position + variable.token.size();
+
+        switch (variable.type) {
+        case PatternVariable::FRAME_NUMBER_HASHES:
+        case PatternVariable::FRAME_NUMBER_PADDED:
+        case PatternVariable::FRAME_NUMBER:
+        {
+            size_t slotStart = output->size();
+            ///%d has a digitsCount of 0 so it won't be padded
+            appendInt(output, frameNumber, variable.digitsCount);
+            if (frameSlots) {
+                frameSlots->push_back(std::make_pair(slotStart, output->size() - slotStart));
+            }
+        } break;
+        case PatternVariable::SHORT_VIEW:
+            if (viewNumber == 0) {
+                output->push_back('l');
+            } else if (viewNumber == 1) {
+                output->push_back('r');
+            } else {
+                output->append("view");
+                appendInt(output, viewNumber, 0);
+            }
+            break;
+        case PatternVariable::LONG_VIEW:
+            if (viewNumber == 0) {
+                output->append("left");
+            } else if (viewNumber == 1) {
+                output->append("right");
+            } else {
+                output->append("view");
+                appendInt(output, viewNumber, 0);
+            }
+            break;
+        default:
+            throw std::invalid_argument("Unrecognized pattern: " + patternStr);
+        }
+    }
+    output->append(patternStr, lastVariableEnd, std::string::npos);
+}
+
+std::string generateFileNameFromPattern(const CompiledPattern& pattern,int frameNumber,int viewNumber) {
+    std::string output;
+    appendFileNameFromPattern(pattern, frameNumber, viewNumber, &output, NULL);
+    return output;
+}
+
+////////////////////FileNameGenerator//////////////////////////
+
+/**
+     * @brief The file name of a pattern for a given frame and view, along with the position of the frame numbers in it
+     * so that it can be incremented in place.
+     **/
+struct GeneratedFileName
+{
+    std::string fileName;
+    ///offset and length of each frame number in fileName
+    std::vector< std::pair<size_t,size_t> > frameSlots;
+    int frame;
+    int view;
+    bool initialized;
+
+    GeneratedFileName()
+        : fileName()
+        , frameSlots()
+        , frame(0)
+        , view(0)
+        , initialized(false)
+    {
+    }
+
+    void generate(const CompiledPattern& pattern,int frameNumber,int viewNumber) {
+        fileName.clear();
+        frameSlots.clear();
+        appendFileNameFromPattern(pattern, frameNumber, viewNumber, &fileName, &frameSlots);
+        frame = frameNumber;
+        view = viewNumber;
+        initialized = true;
+    }
+
+    ///Increments all frame numbers in place. Returns false if a frame number needs an extra digit
+    ///in which case fileName is left in an unspecified state and must be regenerated.
+    bool increment() {
+        for (unsigned int i = 0; i < frameSlots.size(); ++i) {
+            size_t start = frameSlots[i].first;
+            size_t pos = start + frameSlots[i].second;
+            bool carry = true;
+            while (carry && pos > start) {
+                --pos;
+                char& c = fileName[pos];
+                if (c == '9') {
+                    c = '0';
+                } else {
+                    ++c;
+                    carry = false;
+                }
+            }
+            if (carry) {
+                return false;
+            }
+        }
+        ++frame;
+        return true;
+    }
+
+    void moveTo(const CompiledPattern& pattern,int frameNumber,int viewNumber) {
+        ///negative numbers are not incremented in place because of the sign, frame + 1 must not overflow
+        if (initialized && viewNumber == view && frame >= 0 && frame < INT_MAX && frameNumber == frame + 1 && increment()) {
+            return;
+        } else if (initialized && viewNumber == view && frameNumber == frame) {
+            return;
+        }
+        generate(pattern, frameNumber, viewNumber);
+    }
+};
+
+struct FileNameGeneratorPrivate
+{
+    CompiledPattern pattern;
+    GeneratedFileName current;
+
+    FileNameGeneratorPrivate(const CompiledPattern& pattern)
+        : pattern(pattern)
+        , current()
+    {
+    }
+};
+
+FileNameGenerator::FileNameGenerator(const CompiledPattern& pattern)
+    : _imp(new FileNameGeneratorPrivate(pattern))
+{
+}
+
+FileNameGenerator::FileNameGenerator(const FileNameGenerator& other)
+    : _imp(new FileNameGeneratorPrivate(other._imp->pattern))
+{
+    *this = other;
+}
+
+FileNameGenerator::~FileNameGenerator() {
+    delete _imp;
+}
+
+void FileNameGenerator::operator=(const FileNameGenerator& other) {
+    _imp->pattern = other._imp->pattern;
+    _imp->current = other._imp->current;
+}
+
+const std::string& FileNameGenerator::fileName(int frameNumber,int viewNumber) {
+    _imp->current.moveTo(_imp->pattern, frameNumber, viewNumber);
+    return _imp->current.fileName;
+}
+
+const std::string& FileNameGenerator::next() {
+    if (!_imp->current.initialized) {
+        return fileName(0, 0);
+    }
+    ///there is no frame after INT_MAX: the generator stops there
+    if (_imp->current.frame == INT_MAX) {
+        return _imp->current.fileName;
+    }
+    return fileName(_imp->current.frame + 1, _imp->current.view);
+}
+
+int FileNameGenerator::currentFrame() const {
+    return _imp->current.frame;
+}
+
+int FileNameGenerator::currentView() const {
+    return _imp->current.view;
+}
+
+void FileNameGenerator::generateRange(int firstFrame,int lastFrame,const std::vector<int>& views,
+                                      std::string* buffer,std::vector<std::size_t>* offsets) const {
+    buffer->clear();
+    offsets->clear();
+    if (lastFrame < firstFrame) {
+        return;
+    }
+
+    ///one odometer per view so that switching views doesn't regenerate the whole name
+    std::vector<GeneratedFileName> names(views.empty() ? 1 : views.size());
+    names[0].generate(_imp->pattern, firstFrame, views.empty() ? 0 : views[0]);
+
+    size_t count = (size_t)lastFrame - firstFrame + 1;
+    offsets->reserve(count * names.size());
+    ///the file names are at least as long as the first one, give some room for extra digits
+    buffer->reserve(count * names.size() * (names[0].fileName.size() + 2));
+
+    for (long long frame = firstFrame; frame <= lastFrame; ++frame) {
+        for (unsigned int v = 0; v < names.size(); ++v) {
+            names[v].moveTo(_imp->pattern, (int)frame, views.empty() ? 0 : views[v]);
+            offsets->push_back(buffer->size());
+            buffer->append(names[v].fileName);
+            buffer->push_back('\0');
+        }
+    }
+}
+
+////////////////////Expected files//////////////////////////
+
+///Expected files are checked by chunks of this size, by up to this many threads: like for the sizes of files,
+///most of the time is spent waiting for the file system.
+#define FILE_PROBES_CHUNK 64
+#define FILE_PROBES_MAX_THREADS 16
+///The expected files are generated and probed in batches of about this many names, so that the memory used
+///doesn't depend on the number of expected files
+#define PROBED_FILES_BATCH 4096
+///Even when PATTERN_SCAN_PROBE_FILES is asked for, the directory is listed if this many times more files are
+///expected than it is estimated to have entries: nearly all the probes would be for missing files
+#define PROBED_FILES_MAX_EXCESS 64
+
+///The file system type given by statfs for ext2, ext3 and ext4
+#define EXT_FILE_SYSTEM_MAGIC 0xEF53
+
+///Returns true if the pattern has a variable of one of the 2 given types
+static bool patternHasVariable(const CompiledPattern& pattern,PatternVariable::Type type1,PatternVariable::Type type2)
+{
+    const PatternVariables& variables = pattern.getVariables();
+    for (unsigned int i = 0; i < variables.size(); ++i) {
+        if (variables[i].type == type1 || variables[i].type == type2) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+     * @brief Estimates the number of entries of a directory whose file names are about fileNameLength characters long.
+     * This is exact if the listing of the directory is in the installed ScanCache. Otherwise it is derived from the
+     * size of the directory, which on ext2/3/4 grows by 8 bytes plus the name padded to 4 bytes for each entry.
+     * Other file systems size directories differently (or not at all), so returns -1 for them, as when it cannot be estimated.
+     **/
+static long long estimateDirectoryEntriesCount(const std::string& path,std::size_t fileNameLength)
+{
+    InstalledObjectUse<ScanCache> cache(getInstalledScanCache());
+    unsigned long long device, inode;
+    long long modificationTime;
+    std::shared_ptr<const StringList> cachedFiles;
+    if (cache.acquire() && getDirectoryStamp(path, &device, &inode, &modificationTime) &&
+            cache->findFilesList(device, inode, modificationTime, &cachedFiles)) {
+        return (long long)cachedFiles->size();
+    }
+#ifdef __linux__
+    struct statfs fileSystem;
+    if (statfs(path.empty() ? "." : path.c_str(), &fileSystem) != 0 || fileSystem.f_type != EXT_FILE_SYSTEM_MAGIC) {
+        return -1;
+    }
+    struct stat st;
+    if (stat(path.empty() ? "." : path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return -1;
+    }
+    return (long long)st.st_size / (long long)(8 + ((fileNameLength + 3) & ~(std::size_t)3));
+#else
+    (void)fileNameLength;
+    return -1;
+#endif
+}
+
+/**
+     * @brief Checks which of the given files (without path) of the directory path exist, like DirectoryReader would list them:
+     * links to directories are skipped but broken links are not. The files are checked by a pool of threads.
+     * @returns False if the directory couldn't be opened.
+     **/
+static bool probeFiles(const std::string& path,const std::vector<const char*>& fileNames,std::vector<char>* exist)
+{
+    exist->assign(fileNames.size(), 0);
+
+#ifdef __linux__
+    int dirFd = ::open(path.empty() ? "." : path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd == -1) {
+        return false;
+    }
+    std::function<void(std::size_t,std::size_t)> work = [&](std::size_t first,std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            struct stat st;
+            if (::fstatat(dirFd, fileNames[i], &st, AT_SYMLINK_NOFOLLOW) != 0 || S_ISDIR(st.st_mode)) {
+                continue;
+            }
+            if (S_ISLNK(st.st_mode) && ::fstatat(dirFd, fileNames[i], &st, 0) == 0 && S_ISDIR(st.st_mode)) {
+                continue;
+            }
+            (*exist)[i] = 1;
+        }
+    };
+#else
+    DirectoryReader directory;
+    if (!directory.open(path)) {
+        return false;
+    }
+    std::function<void(std::size_t,std::size_t)> work = [&](std::size_t first,std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            tinydir_file file;
+            if (tinydir_file_open(&file, (path + fileNames[i]).c_str()) == 0 && !file.is_dir) {
+                (*exist)[i] = 1;
+            }
+        }
+    };
+#endif
+
+    parallelForChunks(fileNames.size(), FILE_PROBES_CHUNK, FILE_PROBES_MAX_THREADS, work);
+
+#ifdef __linux__
+    ::close(dirFd);
+#endif
+    return true;
+}
+
+///Gathers the visited files that are expected
+class ExpectedFilesBuilder : public PatternFilesVisitor {
+public:
+
+    ExpectedFilesBuilder(const FrameRange& frames,const std::vector<int>* views,SequenceParsing::SequenceFromPattern* sequence)
+        : _frames(frames)
+        , _views(views)
+        , _sequence(sequence)
+    {
+    }
+
+    virtual bool visitFile(int frameNumber,int viewNumber,const std::string& absoluteFileName) {
+        if (frameNumber >= _frames.first && frameNumber <= _frames.last &&
+                ((long long)frameNumber - _frames.first) % _frames.stride == 0 &&
+                (!_views || std::binary_search(_views->begin(), _views->end(), viewNumber))) {
+            addMatchingFile(absoluteFileName, frameNumber, viewNumber, _sequence);
+        }
+        return true;
+    }
+
+private:
+
+    FrameRange _frames;
+    ///the expected views, sorted. Null if the pattern has no view variable
+    const std::vector<int>* _views;
+    SequenceParsing::SequenceFromPattern* _sequence;
+};
+
+bool filesListFromPattern(const std::string& pattern,const ExpectedPatternFiles& expectedFiles,
+                          SequenceParsing::SequenceFromPattern* sequence,PatternScanReport* report) {
+    return filesListFromPattern(CompiledPattern(pattern), expectedFiles, sequence, report);
+}
+
+bool filesListFromPattern(const CompiledPattern& pattern,const ExpectedPatternFiles& expectedFiles,
+                          SequenceParsing::SequenceFromPattern* sequence,PatternScanReport* report) {
+    PatternScanReport localReport;
+    if (!report) {
+        report = &localReport;
+    }
+    *report = PatternScanReport();
+    if (!pattern.isValid()) {
+        return false;
+    }
+
+    FrameRange frames = expectedFiles.frames;
+    frames.stride = std::max(frames.stride, 1);
+    std::vector<int> views = expectedFiles.views;
+    if (views.empty()) {
+        views.push_back(0);
+    }
+    std::sort(views.begin(), views.end());
+    views.erase(std::unique(views.begin(), views.end()), views.end());
+    const bool hasView = patternHasVariable(pattern, PatternVariable::SHORT_VIEW, PatternVariable::LONG_VIEW);
+    if (!hasView) {
+        views.resize(1);
+    }
+    ///the files of a pattern without frame number are found as frame 0
+    if (!patternHasVariable(pattern, PatternVariable::FRAME_NUMBER_HASHES, PatternVariable::FRAME_NUMBER_PADDED) &&
+            !patternHasVariable(pattern, PatternVariable::FRAME_NUMBER, PatternVariable::FRAME_NUMBER)) {
+        const bool hasFrame0 = frames.first <= 0 && frames.last >= 0 && (-(long long)frames.first) % frames.stride == 0;
+        frames.first = 0;
+        frames.last = hasFrame0 ? 0 : -1;
+    }
+
+    const unsigned long long framesCount = frames.last < frames.first ? 0 :
+            ((unsigned long long)((long long)frames.last - frames.first)) / frames.stride + 1;
+    report->expectedFilesCount = framesCount * views.size();
+
+    GeneratedFileName firstName;
+    firstName.generate(pattern, frames.first, views[0]);
+    const std::size_t pathLength = pattern.getPath().size();
+    report->estimatedEntriesCount = estimateDirectoryEntriesCount(pattern.getPath(), firstName.fileName.size() - pathLength);
+
+    report->strategy = expectedFiles.strategy;
+    if (report->strategy == PATTERN_SCAN_AUTOMATIC) {
+        ///%d matches any padding and views match other spellings than the generated one: only listing finds them all
+        const bool canonicalNames = !hasView && !patternHasVariable(pattern, PatternVariable::FRAME_NUMBER, PatternVariable::FRAME_NUMBER);
+        const bool probe = canonicalNames && report->estimatedEntriesCount >= 0 &&
+                (double)report->expectedFilesCount * expectedFiles.probeCost < (double)report->estimatedEntriesCount;
+        report->strategy = probe ? PATTERN_SCAN_PROBE_FILES : PATTERN_SCAN_LIST_DIRECTORY;
+    } else if (report->strategy == PATTERN_SCAN_PROBE_FILES && report->estimatedEntriesCount >= 0 &&
+               (double)report->expectedFilesCount > (double)report->estimatedEntriesCount * PROBED_FILES_MAX_EXCESS) {
+        report->strategy = PATTERN_SCAN_LIST_DIRECTORY;
+    }
+
+    if (report->strategy == PATTERN_SCAN_LIST_DIRECTORY) {
+        ExpectedFilesBuilder builder(frames, hasView ? &views : 0, sequence);
+        return visitFilesFromPattern(pattern, &builder);
+    }
+
+    ///generate the names of the expected files in a single buffer, with one odometer per view, and probe them
+    ///by batches. The directory is probed at least once, so that it is reported if it couldn't be opened.
+    std::vector<GeneratedFileName> names(views.size());
+    std::string buffer;
+    std::vector<std::size_t> offsets;
+    std::vector<const char*> fileNames;
+    std::vector<char> exist;
+    unsigned long long frameIndex = 0;
+    do {
+        buffer.clear();
+        offsets.clear();
+        for (; frameIndex < framesCount && offsets.size() < PROBED_FILES_BATCH; ++frameIndex) {
+            const int frame = (int)(frames.first + (long long)frameIndex * frames.stride);
+            for (unsigned int v = 0; v < views.size(); ++v) {
+                names[v].moveTo(pattern, frame, views[v]);
+                offsets.push_back(buffer.size());
+                buffer.append(names[v].fileName, pathLength, std::string::npos);
+                buffer.push_back('\0');
+            }
+        }
+        fileNames.resize(offsets.size());
+        for (std::size_t i = 0; i < offsets.size(); ++i) {
+            fileNames[i] = buffer.c_str() + offsets[i];
+        }
+
+        if (!probeFiles(pattern.getPath(), fileNames, &exist)) {
+            return false;
+        }
+        ///the frame and view are read back from the names, so that they are the same as when listing the directory
+        for (std::size_t i = 0; i < fileNames.size(); ++i) {
+            int frameNumber = 0;
+            int viewNumber = -1;
+            const std::size_t length = (i + 1 < offsets.size() ? offsets[i + 1] : buffer.size()) - offsets[i] - 1;
+            if (exist[i] && pattern.matches(fileNames[i], length, &frameNumber, &viewNumber)) {
+                addMatchingFile(pattern.getPath() + fileNames[i], frameNumber, viewNumber, sequence);
+            }
+        }
+    } while (frameIndex < framesCount);
+    return true;
+}
+
+/**
+     * @brief The exact total size of the files of a sequence, computed by a background thread.
+     * The thread only holds this state: nothing ever waits for it, and it stops early once cancelled is set.
+     **/
+struct BackgroundTotalSize
+{
+    ///the number of files being stat'ed
+    std::size_t filesCount;
+
+    ///the total size, only valid once ready is set (with release ordering)
+    unsigned long long totalSize;
+    std::atomic<bool> ready;
+
+    std::atomic<bool> cancelled;
+
+    BackgroundTotalSize(std::size_t filesCount)
+        : filesCount(filesCount)
+        , totalSize(0)
+        , ready(false)
+        , cancelled(false)
+    {
+    }
+};
+
+///Cancels the background computation of a total size when destroyed, i.e: once no sequence is interested in it anymore
+struct BackgroundTotalSizeRequest
+{
+    std::shared_ptr<BackgroundTotalSize> state;
+
+    BackgroundTotalSizeRequest(const std::shared_ptr<BackgroundTotalSize>& state)
+        : state(state)
+    {
+    }
+
+    ~BackgroundTotalSizeRequest() {
+        state->cancelled = true;
+    }
+};
+
+///The files picked by SequenceFromFilesPrivate::pickSizeSample to estimate the size of a sequence
+struct SizeSample
+{
+    ///the path of the files and their names without path
+    std::string path;
+    StringList names;
+
+    ///the number of files of the sequence when they were picked
+    std::size_t filesCount;
+
+    ///the index of the first file of each stratum, followed by filesCount. Empty if names has all the files.
+    std::vector<std::size_t> strataBegin;
+
+    SizeSample()
+        : path()
+        , names()
+        , filesCount(0)
+        , strataBegin()
+    {
+    }
+};
+
+struct SequenceFromFilesPrivate
+{
+    ///The layout of the files whose name cannot be generated from the template, @see irregularFiles
+    enum { IRREGULAR_LAYOUT = -1 };
+
+    ///a flat copy of a run of frames with the index in the sequence of its first file
+    struct IndexedRun
+    {
+        int first;
+        int last;
+        int stride;
+        int layout;
+        std::size_t firstIndex;
+    };
+
+    ///the first file inserted in the sequence: all the other files match its pattern.
+    FileNameContent* firstFile;
+
+    /// The index of the frame number string in case there're several numbers in a filename.
+    std::vector<int> frameNumberStringIndexes;
+
+    ///The name of a file of the sequence is made of templateParts[0] + frame number + templateParts[1] + ...
+    ///+ frame number + templateParts[n], where the frame number n is written with at least layouts[layout][n] digits.
+    ///There is usually a single layout, but e.g: file.5.exr and file.0005.exr can both belong to the sequence.
+    StringList templateParts;
+    std::vector< std::vector<int> > layouts;
+
+    ///the frames of the sequence, along with the layout of their file name
+    FrameRunSet frames;
+
+    ///the files whose name cannot be generated from the template (e.g: their frame number overflows) mapped to their frame
+    std::map<int,std::string> irregularFiles;
+
+    ///the files whose frame number was already taken by another file of the sequence, in insertion order
+    StringList sameFrameFiles;
+
+    ///the names of the files of irregularFiles and sameFrameFiles, for lookups
+    std::unordered_set<std::string> explicitFileNames;
+
+    ///The number of SequenceFromFiles sharing this, see SequenceFromFiles::detach(). It is decremented with release
+    ///ordering once a sequence is done with this and loaded with acquire ordering before modifying this in place,
+    ///so that the reads of the copies that were released happen before: shared_ptr::use_count() gives no such ordering.
+    std::atomic<long> handlesCount;
+
+    ///The members below are caches filled by the const functions of SequenceFromFiles. As the private data
+    ///may be shared by copies living in different threads, they are only accessed with cacheMutex locked.
+    std::mutex cacheMutex;
+
+    ///the runs of frames with the index of their first file, built on demand
+    std::vector<IndexedRun> runsIndex;
+    bool runsIndexValid;
+
+    ///the views of the files returned by getFrameIndexes() and getFilesList(), built on demand
+    std::map<int,std::string> filesMap;
+    bool filesMapValid;
+    StringList filesList;
+    bool filesListValid;
+
+    ///the cumulated sizes of the files of the sequence but the unsized ones
+    unsigned long long totalSize;
+
+    ///the names of the files inserted since the last call to getEstimatedTotalSize(), whose size is not known yet.
+    ///Only filled if the size estimation is enabled.
+    StringList unsizedFiles;
+
+    ///the names of the files getEstimatedTotalSize() is stat'ing without cacheMutex locked, and notified once they are
+    ///added to totalSize: other calls wait for it rather than return a total missing them.
+    StringList sizingFiles;
+    std::condition_variable totalSizeUpdated;
+
+    bool sizeEstimationEnabled;
+
+    ///the exact total size computed in the background, shared with the copies of the sequence
+    std::shared_ptr<BackgroundTotalSizeRequest> exactTotalSize;
+
+    ///the last estimation returned by getSampledSizeEstimation and the parameters it was computed with
+    SizeEstimation sampledEstimation;
+    std::size_t sampledEstimationFilesCount;
+    int sampledEstimationSampleSize;
+
+    SequenceFromFilesPrivate(bool enableSizeEstimation)
+        : firstFile(0)
+        , frameNumberStringIndexes()
+        , templateParts()
+        , layouts()
+        , frames()
+        , irregularFiles()
+        , sameFrameFiles()
+        , explicitFileNames()
+        , handlesCount(1)
+        , runsIndex()
+        , runsIndexValid(false)
+        , filesMap()
+        , filesMapValid(false)
+        , filesList()
+        , filesListValid(false)
+        , totalSize(0)
+        , unsizedFiles()
+        , sizingFiles()
+        , totalSizeUpdated()
+        , sizeEstimationEnabled(enableSizeEstimation)
+        , exactTotalSize()
+        , sampledEstimation()
+        , sampledEstimationFilesCount(0)
+        , sampledEstimationSampleSize(0)
+    {
+
+    }
+
+    ///Copies the sequence so it can be modified without affecting the copies sharing other.
+    ///The views are not copied, they'll be rebuilt on demand.
+    SequenceFromFilesPrivate(SequenceFromFilesPrivate& other)
+        : firstFile(other.firstFile ? new FileNameContent(*other.firstFile) : 0)
+        , frameNumberStringIndexes(other.frameNumberStringIndexes)
+        , templateParts(other.templateParts)
+        , layouts(other.layouts)
+        , frames(other.frames)
+        , irregularFiles(other.irregularFiles)
+        , sameFrameFiles(other.sameFrameFiles)
+        , explicitFileNames(other.explicitFileNames)
+        , handlesCount(1)
+        , cacheMutex()
+        , runsIndex()
+        , runsIndexValid(false)
+        , filesMap()
+        , filesMapValid(false)
+        , filesList()
+        , filesListValid(false)
+        , totalSize(0)
+        , unsizedFiles()
+        , sizingFiles()
+        , totalSizeUpdated()
+        , sizeEstimationEnabled(other.sizeEstimationEnabled)
+        , exactTotalSize()
+        , sampledEstimation()
+        , sampledEstimationFilesCount(0)
+        , sampledEstimationSampleSize(0)
+    {
+        std::lock_guard<std::mutex> lock(other.cacheMutex);
+        totalSize = other.totalSize;
+        ///the files other is stat'ing are not in its total yet
+        unsizedFiles = other.sizingFiles;
+        unsizedFiles.insert(unsizedFiles.end(), other.unsizedFiles.begin(), other.unsizedFiles.end());
+        exactTotalSize = other.exactTotalSize;
+        sampledEstimation = other.sampledEstimation;
+        sampledEstimationFilesCount = other.sampledEstimationFilesCount;
+        sampledEstimationSampleSize = other.sampledEstimationSampleSize;
+    }
+
+    ~SequenceFromFilesPrivate() {
+        delete firstFile;
+    }
+
+    ///Returns true if the exact size computed in the background accounts for all the files and is ready.
+    ///cacheMutex must be locked.
+    bool isExactTotalSizeAvailable() const {
+        return exactTotalSize && exactTotalSize->state->filesCount == filesCount() &&
+               exactTotalSize->state->ready.load(std::memory_order_acquire);
+    }
+
+    std::size_t filesCount() const {
+        if (!firstFile) {
+            return 0;
+        } else if (frames.getFramesCount() == 0) {
+            return 1;
+        }
+        return frames.getFramesCount() + sameFrameFiles.size();
+    }
+
+    void invalidateViews() {
+        runsIndexValid = false;
+        filesMapValid = false;
+        filesListValid = false;
+    }
+
+    void addFile(std::string_view fileName) {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (sizeEstimationEnabled) {
+            unsizedFiles.push_back(std::string(fileName));
+        }
+        invalidateViews();
+    }
+
+    ///Reads the numbers of file at the given indexes. They must all represent the same frame number.
+    static bool getFrameNumber(const FileNameContent& file,const std::vector<int>& indexes,int* frame,std::vector<FileNameNumber>* numbers);
+
+    ///Builds templateParts out of the first file once the frame number indexes are known
+    void buildTemplate();
+
+    ///Appends the name of the file (without path) of the given frame with the given layout
+    void appendFileName(int frame,int layout,std::string* fileName) const;
+
+    ///Inserts the frame of a file matching the pattern of the sequence, numbers being its frame number strings.
+    void insertFrame(int frame,const std::vector<FileNameNumber>& numbers,std::string_view fileName);
+
+    ///Returns true if the file name (without path) is generated by the template, and its frame number.
+    bool parseFrame(const char* fileName,std::size_t length,int* frame) const;
+
+    const std::vector<IndexedRun>& getRunsIndex();
+
+    ///Returns the name without path of the file at the given index: files are ordered by frame number, followed by sameFrameFiles.
+    std::string getFileName(std::size_t index);
+
+    ///Returns the names without path of all the files of the sequence, in the order of getFileName
+    void getFileNames(StringList* fileNames);
+
+    ///Returns the number of frames lower or equal to frame
+    std::size_t countFramesUpTo(int frame);
+
+    ///Picks the files whose size estimates the size of the sequence, see SequenceFromFiles::getSampledSizeEstimation
+    void pickSizeSample(int sampleSize,SizeSample* sample);
+};
+
+bool SequenceFromFilesPrivate::getFrameNumber(const FileNameContent& file,const std::vector<int>& indexes,int* frame,std::vector<FileNameNumber>* numbers)
+{
+    numbers->resize(indexes.size());
+    for (unsigned int i = 0; i < indexes.size(); ++i) {
+        if (!file.getDecodedNumberByIndex(indexes[i], &(*numbers)[i])) {
+            return false;
+        }
+        int value = (*numbers)[i].value;
+        if (i == 0) {
+            *frame = value;
+        } else if (value != *frame) {
+            return false;
+        }
+    }
+    return !indexes.empty();
+}
+
+void SequenceFromFilesPrivate::buildTemplate()
+{
+    const std::string_view fileName = firstFile->fileNameView();
+    templateParts.assign(1, std::string());
+    int numberIndex = 0;
+    unsigned int nextFrameNumber = 0;
+    std::size_t i = 0;
+    while (i < fileName.size()) {
+        if (!isAsciiDigit(fileName[i])) {
+            templateParts.back().push_back(fileName[i]);
+            ++i;
+            continue;
+        }
+        std::size_t end = i;
+        while (end < fileName.size() && isAsciiDigit(fileName[end])) {
+            ++end;
+        }
+        if (nextFrameNumber < frameNumberStringIndexes.size() && frameNumberStringIndexes[nextFrameNumber] == numberIndex) {
+            templateParts.push_back(std::string());
+            ++nextFrameNumber;
+        } else {
+            templateParts.back().append(fileName, i, end - i);
+        }
+        ++numberIndex;
+        i = end;
+    }
+}
+
+void SequenceFromFilesPrivate::appendFileName(int frame,int layout,std::string* fileName) const
+{
+    if (layout == IRREGULAR_LAYOUT) {
+        std::map<int,std::string>::const_iterator found = irregularFiles.find(frame);
+        assert(found != irregularFiles.end());
+        fileName->append(found->second);
+        return;
+    }
+    const std::vector<int>& digitsCounts = layouts[layout];
+    fileName->append(templateParts[0]);
+    for (unsigned int i = 0; i < digitsCounts.size(); ++i) {
+        appendInt(fileName, frame, digitsCounts[i]);
+        fileName->append(templateParts[i + 1]);
+    }
+}
+
+void SequenceFromFilesPrivate::insertFrame(int frame,const std::vector<FileNameNumber>& numbers,std::string_view fileName)
+{
+    ///find a layout that writes the numbers as they are: a number with leading zeroes
+    ///needs exactly its digits count, otherwise any count up to its digits count will do.
+    int layout = -1;
+    for (unsigned int l = 0; l < layouts.size() && layout == -1; ++l) {
+        bool compatible = true;
+        for (unsigned int i = 0; i < numbers.size() && compatible; ++i) {
+            const int digitsCount = numbers[i].digitsCount;
+            compatible = numbers[i].hasLeadingZeroes ? layouts[l][i] == digitsCount : layouts[l][i] <= digitsCount;
+        }
+        if (compatible) {
+            layout = l;
+        }
+    }
+    bool newLayout = layout == -1;
+    if (newLayout) {
+        std::vector<int> digitsCounts(numbers.size());
+        for (unsigned int i = 0; i < numbers.size(); ++i) {
+            digitsCounts[i] = numbers[i].hasLeadingZeroes ? numbers[i].digitsCount : 1;
+        }
+        layout = layouts.size();
+        layouts.push_back(digitsCounts);
+    }
+
+    ///make sure the name can be generated back, it cannot if e.g: the frame number overflows
+    std::string generated;
+    appendFileName(frame, layout, &generated);
+    if (generated != fileName) {
+        if (newLayout) {
+            layouts.pop_back();
+        }
+        layout = IRREGULAR_LAYOUT;
+    }
+
+    if (!frames.insert(frame, layout)) {
+        sameFrameFiles.push_back(std::string(fileName));
+        explicitFileNames.insert(std::string(fileName));
+    } else if (layout == IRREGULAR_LAYOUT) {
+        irregularFiles.insert(std::make_pair(frame, std::string(fileName)));
+        explicitFileNames.insert(std::string(fileName));
+    }
+}
+
+bool SequenceFromFilesPrivate::parseFrame(const char* fileName,std::size_t length,int* frame) const
+{
+    std::size_t pos = 0;
+    for (unsigned int i = 0; i < templateParts.size(); ++i) {
+        const std::string& part = templateParts[i];
+        if (length - pos < part.size() || part.compare(0, part.size(), fileName + pos, part.size()) != 0) {
+            return false;
+        }
+        pos += part.size();
+        if (i + 1 == templateParts.size()) {
+            break;
+        }
+        std::size_t digitsStart = pos;
+        while (pos < length && isAsciiDigit(fileName[pos])) {
+            ++pos;
+        }
+        if (pos == digitsStart) {
+            return false;
+        }
+        int value = digitsToInt(fileName + digitsStart, pos - digitsStart);
+        if (i > 0 && value != *frame) {
+            return false;
+        }
+        *frame = value;
+    }
+    return pos == length && templateParts.size() > 1;
+}
+
+const std::vector<SequenceFromFilesPrivate::IndexedRun>& SequenceFromFilesPrivate::getRunsIndex()
+{
+    if (!runsIndexValid) {
+        const FrameRunSet::Runs& runs = frames.getRuns();
+        runsIndex.clear();
+        runsIndex.reserve(runs.size());
+        std::size_t index = 0;
+        for (FrameRunSet::Runs::const_iterator it = runs.begin(); it != runs.end(); ++it) {
+            IndexedRun run = { it->first, it->second.last, it->second.stride, it->second.layout, index };
+            runsIndex.push_back(run);
+            index += FrameRunSet::getRunFramesCount(it->first, it->second);
+        }
+        runsIndexValid = true;
+    }
+    return runsIndex;
+}
+
+std::string SequenceFromFilesPrivate::getFileName(std::size_t index)
+{
+    if (frames.getFramesCount() == 0) {
+        return firstFile->fileName();
+    } else if (index >= frames.getFramesCount()) {
+        return sameFrameFiles[index - frames.getFramesCount()];
+    }
+    const std::vector<IndexedRun>& runs = getRunsIndex();
+    ///find the last run starting at or before index
+    std::size_t low = 0, high = runs.size();
+    while (high - low > 1) {
+        std::size_t mid = (low + high) / 2;
+        if (runs[mid].firstIndex <= index) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    const IndexedRun& run = runs[low];
+    std::string ret;
+    appendFileName(run.first + (int)(index - run.firstIndex) * run.stride, run.layout, &ret);
+    return ret;
+}
+
+void SequenceFromFilesPrivate::getFileNames(StringList* fileNames)
+{
+    if (frames.getFramesCount() == 0) {
+        if (firstFile) {
+            fileNames->push_back(firstFile->fileName());
+        }
+        return;
+    }
+    fileNames->reserve(fileNames->size() + filesCount());
+    const FrameRunSet::Runs& runs = frames.getRuns();
+    for (FrameRunSet::Runs::const_iterator it = runs.begin(); it != runs.end(); ++it) {
+        for (long long frame = it->first; frame <= it->second.last; frame += it->second.stride) {
+            fileNames->push_back(std::string());
+            appendFileName((int)frame, it->second.layout, &fileNames->back());
+        }
+    }
+    fileNames->insert(fileNames->end(), sameFrameFiles.begin(), sameFrameFiles.end());
+}
+
+std::size_t SequenceFromFilesPrivate::countFramesUpTo(int frame)
+{
+    const std::vector<IndexedRun>& runs = getRunsIndex();
+    if (runs.empty() || frame < runs[0].first) {
+        return 0;
+    }
+    ///find the last run starting at or before frame
+    std::size_t low = 0, high = runs.size();
+    while (high - low > 1) {
+        std::size_t mid = (low + high) / 2;
+        if (runs[mid].first <= frame) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    const IndexedRun& run = runs[low];
+    long long last = std::min(frame, run.last);
+    return run.firstIndex + (std::size_t)((last - run.first) / run.stride) + 1;
+}
+
+SequenceFromFiles::SequenceFromFiles(bool enableSizeEstimation)
+    : _imp(std::make_shared<SequenceFromFilesPrivate>(enableSizeEstimation))
+{
+
+}
+
+SequenceFromFiles::SequenceFromFiles(const FileNameContent& firstFile,  bool enableSizeEstimation)
+    : _imp(std::make_shared<SequenceFromFilesPrivate>(enableSizeEstimation))
+{
+    _imp->firstFile = new FileNameContent(firstFile);
+    _imp->addFile(firstFile.fileNameView());
+}
+
+///Lets the other sequences sharing imp know that the calling one is done with it
+static void releaseSequenceInternals(const std::shared_ptr<SequenceFromFilesPrivate>& imp)
+{
+    if (imp) {
+        imp->handlesCount.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+SequenceFromFiles::~SequenceFromFiles() {
+    releaseSequenceInternals(_imp);
+}
+
+SequenceFromFiles::SequenceFromFiles(const SequenceFromFiles& other)
+    : _imp(other._imp)
+{
+    if (_imp) {
+        _imp->handlesCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+SequenceFromFiles::SequenceFromFiles(SequenceFromFiles&& other) noexcept
+    : _imp(std::move(other._imp))
+{
+}
+
+void SequenceFromFiles::operator=(const SequenceFromFiles& other) {
+    if (other._imp) {
+        other._imp->handlesCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    releaseSequenceInternals(_imp);
+    _imp = other._imp;
+}
+
+void SequenceFromFiles::operator=(SequenceFromFiles&& other) noexcept {
+    if (this != &other) {
+        releaseSequenceInternals(_imp);
+        _imp = std::move(other._imp);
+    }
+}
+
+void SequenceFromFiles::detach() {
+    if (_imp->handlesCount.load(std::memory_order_acquire) > 1) {
+        std::shared_ptr<SequenceFromFilesPrivate> copy = std::make_shared<SequenceFromFilesPrivate>(*_imp);
+        releaseSequenceInternals(_imp);
+        _imp = copy;
+    }
+}
+
+bool SequenceFromFiles::tryInsertFile(const FileNameContent& file) {
+
+    if (!_imp->firstFile) {
+        detach();
+        _imp->firstFile = new FileNameContent(file);
+        _imp->addFile(file.fileNameView());
+        return true;
+    }
+
+    if (file.getPathView() != _imp->firstFile->getPathView()) {
+        return false;
+    }
+
+    ///the file is already in the sequence
+    if (contains(file.absoluteFileName())) {
+        return false;
+    }
+
+    std::vector<int> frameNumberIndexes;
+    if (!file.matchesPattern(*_imp->firstFile, &frameNumberIndexes)) {
+        return false;
+    }
+
+    int frame;
+    std::vector<FileNameNumber> numbers;
+    ///if this is the second file we add to the sequence, we can now
+    ///determine where is the frame number string placed.
+    const bool isSecondFile = _imp->frameNumberStringIndexes.empty();
+    int firstFrame;
+    std::vector<FileNameNumber> firstNumbers;
+    if (isSecondFile) {
+        if (!SequenceFromFilesPrivate::getFrameNumber(*_imp->firstFile, frameNumberIndexes, &firstFrame, &firstNumbers) ||
+            !SequenceFromFilesPrivate::getFrameNumber(file, frameNumberIndexes, &frame, &numbers)) {
+            return false;
+        }
+    } else if (frameNumberIndexes != _imp->frameNumberStringIndexes ||
+               !SequenceFromFilesPrivate::getFrameNumber(file, frameNumberIndexes, &frame, &numbers)) {
+        return false;
+    }
+
+    ///the file is accepted, stop sharing the internals with the copies of this sequence before modifying them.
+    detach();
+    if (isSecondFile) {
+        _imp->frameNumberStringIndexes = frameNumberIndexes;
+        _imp->buildTemplate();
+        _imp->insertFrame(firstFrame, firstNumbers, _imp->firstFile->fileNameView());
+    }
+    _imp->insertFrame(frame, numbers, file.fileNameView());
+    _imp->addFile(file.fileNameView());
+    return true;
+}
+
+bool SequenceFromFiles::contains(const std::string& absoluteFileName) const {
+    if (!_imp->firstFile) {
+        return false;
+    } else if (_imp->frames.getFramesCount() == 0) {
+        return absoluteFileName == _imp->firstFile->absoluteFileName();
+    }
+    const std::string_view path = _imp->firstFile->getPathView();
+    if (absoluteFileName.compare(0, path.size(), path) != 0) {
+        return false;
+    }
+    const char* fileName = absoluteFileName.c_str() + path.size();
+    const std::size_t length = absoluteFileName.size() - path.size();
+
+    int frame,layout;
+    if (_imp->parseFrame(fileName, length, &frame) && _imp->frames.find(frame, &layout) && layout != SequenceFromFilesPrivate::IRREGULAR_LAYOUT) {
+        std::string generated;
+        _imp->appendFileName(frame, layout, &generated);
+        if (generated.size() == length && generated.compare(0, length, fileName, length) == 0) {
+            return true;
+        }
+    }
+    return !_imp->explicitFileNames.empty() && _imp->explicitFileNames.find(std::string(fileName, length)) != _imp->explicitFileNames.end();
+}
+
+bool SequenceFromFiles::empty() const {
+    return _imp->firstFile == 0;
+}
+
+int SequenceFromFiles::count() const {
+    return (int)_imp->filesCount();
+}
+
+bool SequenceFromFiles::isSingleFile() const {
+    return _imp->filesCount() == 1;
+}
+
+int SequenceFromFiles::getFirstFrame() const {
+    const FrameRunSet::Runs& runs = _imp->frames.getRuns();
+    if (runs.empty()) {
+        return INT_MIN;
+    } else {
+        return runs.begin()->first;
+    }
+}
+
+int SequenceFromFiles::getLastFrame() const {
+    const FrameRunSet::Runs& runs = _imp->frames.getRuns();
+    if (runs.empty()) {
+        return INT_MAX;
+    } else {
+        return runs.rbegin()->second.last;
+    }
+}
+
+const std::map<int,std::string>& SequenceFromFiles::getFrameIndexes() const {
+    std::lock_guard<std::mutex> lock(_imp->cacheMutex);
+    if (!_imp->filesMapValid) {
+        _imp->filesMap.clear();
+        const std::string path = _imp->firstFile ? _imp->firstFile->getPath() : std::string();
+        const FrameRunSet::Runs& runs = _imp->frames.getRuns();
+        std::map<int,std::string>::iterator hint = _imp->filesMap.end();
+        for (FrameRunSet::Runs::const_iterator it = runs.begin(); it != runs.end(); ++it) {
+            for (long long frame = it->first; frame <= it->second.last; frame += it->second.stride) {
+                hint = _imp->filesMap.insert(hint, std::make_pair((int)frame, path));
+                _imp->appendFileName((int)frame, it->second.layout, &hint->second);
+            }
+        }
+        _imp->filesMapValid = true;
+    }
+    return _imp->filesMap;
+}
+
+const StringList& SequenceFromFiles::getFilesList() const {
+    std::lock_guard<std::mutex> lock(_imp->cacheMutex);
+    if (!_imp->filesListValid) {
+        StringList fileNames;
+        _imp->getFileNames(&fileNames);
+        const std::string path = _imp->firstFile ? _imp->firstFile->getPath() : std::string();
+        for (StringList::iterator it = fileNames.begin(); it != fileNames.end(); ++it) {
+            it->insert(0, path);
+        }
+        _imp->filesList.swap(fileNames);
+        _imp->filesListValid = true;
+    }
+    return _imp->filesList;
+}
+
+std::vector<FrameRange> SequenceFromFiles::getFrameRanges() const {
+    std::vector<FrameRange> ret;
+    const FrameRunSet::Runs& runs = _imp->frames.getRuns();
+    ret.reserve(runs.size());
+    for (FrameRunSet::Runs::const_iterator it = runs.begin(); it != runs.end(); ++it) {
+        ///runs only differing by the layout of their file names are merged
+        if (!ret.empty() && ret.back().stride == it->second.stride && (long long)ret.back().last + ret.back().stride == it->first) {
+            ret.back().last = it->second.last;
+        } else {
+            FrameRange range;
+            range.first = it->first;
+            range.last = it->second.last;
+            range.stride = it->second.stride;
+            ret.push_back(range);
         }
     }
-    return false;
+    return ret;
+}
+
+bool SequenceFromFiles::containsFrame(int frame) const {
+    int layout;
+    return _imp->frames.find(frame, &layout);
+}
+
+int SequenceFromFiles::getFramesCount(int first,int last) const {
+    if (last < first) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(_imp->cacheMutex);
+    std::size_t ret = _imp->countFramesUpTo(last);
+    if (first > INT_MIN) {
+        ret -= _imp->countFramesUpTo(first - 1);
+    }
+    return (int)ret;
+}
+
+bool SequenceFromFiles::getFileNameForFrame(int frame,std::string* absoluteFileName) const {
+    int layout;
+    if (!_imp->frames.find(frame, &layout)) {
+        return false;
+    }
+    *absoluteFileName = _imp->firstFile->getPath();
+    _imp->appendFileName(frame, layout, absoluteFileName);
+    return true;
+}
+
+///Returns the names of fileNames as c strings
+static std::vector<const char*> getFileNamesPointers(const StringList& fileNames)
+{
+    std::vector<const char*> ret(fileNames.size());
+    for (std::size_t i = 0; i < fileNames.size(); ++i) {
+        ret[i] = fileNames[i].c_str();
+    }
+    return ret;
+}
+
+unsigned long long SequenceFromFiles::getEstimatedTotalSize() const {
+    std::unique_lock<std::mutex> lock(_imp->cacheMutex);
+    _imp->totalSizeUpdated.wait(lock, [this]() { return _imp->sizingFiles.empty(); });
+    if (_imp->unsizedFiles.empty()) {
+        return _imp->totalSize;
+    }
+
+    ///stat the files inserted since the last call without cacheMutex locked, so the other const functions don't wait for it.
+    ///All the files of a sequence live in the same directory.
+    _imp->sizingFiles.swap(_imp->unsizedFiles);
+    const std::string path = _imp->firstFile->getPath();
+    const std::vector<const char*> fileNames = getFileNamesPointers(_imp->sizingFiles);
+    lock.unlock();
+    unsigned long long size = 0;
+    try {
+        size = getFilesTotalSize(path, fileNames);
+    } catch (...) {
+        lock.lock();
+        _imp->unsizedFiles.insert(_imp->unsizedFiles.end(), _imp->sizingFiles.begin(), _imp->sizingFiles.end());
+        StringList().swap(_imp->sizingFiles);
+        _imp->totalSizeUpdated.notify_all();
+        throw;
+    }
+    lock.lock();
+    _imp->totalSize += size;
+    StringList().swap(_imp->sizingFiles);
+    _imp->totalSizeUpdated.notify_all();
+    return _imp->totalSize;
 }
 
-/**
-     * @brief Given the pattern of this file, it tries to match the other file name to this
-     * pattern.
-     * @param numberIndexToVary [out] In case the pattern contains several numbers (@see getNumberByIndex)
-     * this value will be fed the appropriate number index that should be used for frame number.
-     * For example, if this filename is myfile001_000.jpg and the other file is myfile001_001.jpg
-     * numberIndexToVary would be 1 as the frame number string indentied in that case is the last number.
-     * @returns True if it identified 'other' as belonging to the same sequence, false otherwise.
-     **/
-bool FileNameContent::matchesPattern(const FileNameContent& other,std::vector<int>* numberIndexesToVary) const {
-    const std::vector<FileNameElement>& otherElements = other._imp->orderedElements;
-    if (otherElements.size() != _imp->orderedElements.size()) {
-        return false;
+bool SequenceFromFiles::isSizeEstimationEnabled() const {
+    return _imp->sizeEstimationEnabled;
+}
+
+void SequenceFromFilesPrivate::pickSizeSample(int sampleSize,SizeSample* sample)
+{
+    sample->filesCount = filesCount();
+    if (sample->filesCount == 0) {
+        return;
+    }
+    sample->path = firstFile->getPath();
+    if (sampleSize < 2 || (std::size_t)sampleSize >= sample->filesCount) {
+        getFileNames(&sample->names);
+        return;
     }
 
-    ///potential frame numbers are pairs of strings from this filename and the same
-    ///string in the other filename.
-    ///Same numbers are not inserted in this vector.
-    std::vector< std::pair< int, std::pair<std::string,std::string> > > potentialFrameNumbers;
-    int numbersCount = 0;
-    for (unsigned int i = 0; i < _imp->orderedElements.size(); ++i) {
-        if (_imp->orderedElements[i].type != otherElements[i].type) {
-            return false;
+    ///split the files in strata of at least 2 files and pick 2 distinct files at random in each.
+    ///The generator is seeded with the sequence size so that the same sequence always gives the same estimation.
+    const std::size_t filesCount = sample->filesCount;
+    const std::size_t strataCount = sampleSize / 2;
+    std::mt19937 generator((unsigned int)(filesCount * 2654435761u) ^ (unsigned int)sampleSize);
+    std::vector<std::size_t>& strataBegin = sample->strataBegin;
+    strataBegin.resize(strataCount + 1);
+    sample->names.reserve(strataCount * 2);
+    for (std::size_t h = 0; h <= strataCount; ++h) {
+        strataBegin[h] = h * filesCount / strataCount;
+    }
+    for (std::size_t h = 0; h < strataCount; ++h) {
+        std::size_t stratumSize = strataBegin[h + 1] - strataBegin[h];
+        std::size_t first = std::uniform_int_distribution<std::size_t>(0, stratumSize - 1)(generator);
+        std::size_t second = std::uniform_int_distribution<std::size_t>(0, stratumSize - 2)(generator);
+        if (second >= first) {
+            ++second;
         }
-        if (_imp->orderedElements[i].type == FileNameElement::FRAME_NUMBER) {
-            if (_imp->orderedElements[i].data != otherElements[i].data) {
-                ///if one frame number string is longer than the other, make sure it is because the represented number
-                ///is bigger and not because there's extra padding
-                /// For example 10000 couldve been produced with ## only and is valid, and 01 would also produce be ##.
-                /// On the other hand 010000 could never have been produced with ## hence it is not valid.
-
-                bool valid = true;
-                ///if they have different sizes, if one of them starts with a 0 its over.
-                if (_imp->orderedElements[i].data.size() != otherElements[i].data.size()) {
-
-                    if (_imp->orderedElements[i].data.size() > otherElements[i].data.size()) {
-                        if (otherElements[i].data.at(0) == '0' && otherElements[i].data.size() > 1) {
-                            valid = false;
-                        } else {
-                            int k = 0;
-                            int diff = std::abs((int)_imp->orderedElements[i].data.size()  - (int)otherElements[i].data.size());
-                            while (k < (int)_imp->orderedElements[i].data.size() && k < diff) {
-                                if (_imp->orderedElements[i].data.at(k) == '0') {
-                                    valid = false;
-                                }
-                                break;
-                                ++k;
-                            }
-                        }
-                    } else {
-                        if (_imp->orderedElements[i].data.at(0) == '0' && _imp->orderedElements[i].data.size() > 1) {
-                            valid = false;
-                        } else {
-                            int k = 0;
-                            int diff = std::abs((int)_imp->orderedElements[i].data.size()  - (int)otherElements[i].data.size());
-                            while (k < (int)otherElements[i].data.size() && k < diff) {
-                                if (otherElements[i].data.at(k) == '0') {
-                                    valid = false;
-                                }
-                                break;
-                                ++k;
-                            }
-                        }
-                    }
+        sample->names.push_back(getFileName(strataBegin[h] + first));
+        sample->names.push_back(getFileName(strataBegin[h] + second));
+    }
+}
 
-                }
-                if (valid) {
-                    potentialFrameNumbers.push_back(std::make_pair(numbersCount,
-                                                                   std::make_pair(_imp->orderedElements[i].data, otherElements[i].data)));
-                }
+///Stats the files of sample and estimates the size of the sequence they were picked from
+static SizeEstimation estimateSizeFromSample(const SizeSample& sample)
+{
+    SizeEstimation ret;
+    if (sample.filesCount == 0) {
+        return ret;
+    }
+    const std::vector<const char*> fileNames = getFileNamesPointers(sample.names);
+    if (sample.strataBegin.empty()) {
+        ret.totalSize = getFilesTotalSize(sample.path, fileNames);
+        ret.lowerBound = ret.upperBound = ret.totalSize;
+        ret.sampledFilesCount = (int)sample.filesCount;
+        return ret;
+    }
+    std::vector<unsigned long long> sizes;
+    getFilesSizes(sample.path, fileNames, &sizes);
+
+    ///stratified estimator of the total and of its variance, with the finite population correction
+    const std::vector<std::size_t>& strataBegin = sample.strataBegin;
+    const std::size_t strataCount = strataBegin.size() - 1;
+    double total = 0.;
+    double variance = 0.;
+    unsigned long long sampledSize = 0;
+    for (std::size_t h = 0; h < strataCount; ++h) {
+        double stratumSize = (double)(strataBegin[h + 1] - strataBegin[h]);
+        double a = (double)sizes[h * 2];
+        double b = (double)sizes[h * 2 + 1];
+        double sampleVariance = (a - b) * (a - b) / 2.;
+        total += stratumSize * (a + b) / 2.;
+        variance += stratumSize * stratumSize * (1. - 2. / stratumSize) * sampleVariance / 2.;
+        sampledSize += sizes[h * 2] + sizes[h * 2 + 1];
+    }
+    const double margin = 1.96 * std::sqrt(variance);
 
-            }
-            ++numbersCount;
-        } else if (_imp->orderedElements[i].type == FileNameElement::TEXT && _imp->orderedElements[i].data != otherElements[i].data) {
-            return false;
+    ret.totalSize = (unsigned long long)(total + 0.5);
+    ret.lowerBound = std::max(sampledSize, (unsigned long long)std::max(0., total - margin));
+    ret.upperBound = (unsigned long long)(total + margin + 0.5);
+    ret.sampledFilesCount = (int)fileNames.size();
+    ret.exact = false;
+    return ret;
+}
+
+SizeEstimation SequenceFromFiles::getSampledSizeEstimation(int sampleSize) const {
+    ///the files are picked with cacheMutex locked but stat'ed without
+    SizeSample sample;
+    {
+        std::lock_guard<std::mutex> lock(_imp->cacheMutex);
+        if (_imp->isExactTotalSizeAvailable()) {
+            SizeEstimation ret;
+            ret.totalSize = ret.lowerBound = ret.upperBound = _imp->exactTotalSize->state->totalSize;
+            ret.sampledFilesCount = (int)_imp->exactTotalSize->state->filesCount;
+            return ret;
         }
+        if (_imp->sampledEstimationFilesCount == _imp->filesCount() && _imp->sampledEstimationSampleSize == sampleSize) {
+            return _imp->sampledEstimation;
+        }
+        _imp->pickSizeSample(sampleSize, &sample);
     }
-    ///strings are identical
-    if (potentialFrameNumbers.empty()) {
-        return false;
-    }
+    const SizeEstimation ret = estimateSizeFromSample(sample);
+    std::lock_guard<std::mutex> lock(_imp->cacheMutex);
+    _imp->sampledEstimation = ret;
+    _imp->sampledEstimationFilesCount = sample.filesCount;
+    _imp->sampledEstimationSampleSize = sampleSize;
+    return ret;
+}
 
-    ///find out in the potentialFrameNumbers what is the minimum with pairs and pick it up
-    /// for example if 1 pair is : < 0001, 802398 > and the other pair is < 01 , 10 > we pick
-    /// the second one.
-    std::vector<int> minIndexes;
-    int minimum = INT_MAX;
-    for (unsigned int i = 0; i < potentialFrameNumbers.size(); ++i) {
-        int thisNumber = stringToInt(potentialFrameNumbers[i].second.first);
-        int otherNumber = stringToInt(potentialFrameNumbers[i].second.second);
-        int diff = std::abs(thisNumber - otherNumber);
-        if (diff < minimum) {
-            minimum = diff;
-            minIndexes.clear();
-            minIndexes.push_back(i);
-        } else if (diff == minimum) {
-            minIndexes.push_back(i);
+void SequenceFromFiles::computeExactTotalSizeInBackground() const {
+    std::lock_guard<std::mutex> lock(_imp->cacheMutex);
+    if (_imp->exactTotalSize && _imp->exactTotalSize->state->filesCount == _imp->filesCount()) {
+        return;
+    }
+    if (empty()) {
+        return;
+    }
+    ///the background thread works on its own copy of the names so the sequence can keep changing.
+    ///Replacing the previous request cancels its computation unless a copy of the sequence still holds it.
+    std::string path = _imp->firstFile->getPath();
+    StringList fileNames;
+    _imp->getFileNames(&fileNames);
+    std::shared_ptr<BackgroundTotalSize> state = std::make_shared<BackgroundTotalSize>(fileNames.size());
+    _imp->exactTotalSize = std::make_shared<BackgroundTotalSizeRequest>(state);
+    std::thread([path, fileNames, state]() {
+        try {
+            state->totalSize = getFilesTotalSize(path, getFileNamesPointers(fileNames), &state->cancelled);
+            ///a cancelled total misses files, and no sequence is left to read it anyway
+            if (!state->cancelled) {
+                state->ready.store(true, std::memory_order_release);
+            }
+        } catch (const std::exception&) {
+            ///the size is never available
         }
+    }).detach();
+}
+
+bool SequenceFromFiles::isExactTotalSizeAvailable() const {
+    std::lock_guard<std::mutex> lock(_imp->cacheMutex);
+    return _imp->isExactTotalSizeAvailable();
+}
+
+std::size_t SequenceFromFiles::getMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(_imp->cacheMutex);
+    std::size_t ret = sizeof(SequenceFromFiles) + sizeof(SequenceFromFilesPrivate);
+    if (_imp->firstFile) {
+        ret += _imp->firstFile->getMemoryUsage();
     }
-    for (unsigned int i = 0; i < minIndexes.size(); ++i) {
-        numberIndexesToVary->push_back(potentialFrameNumbers[minIndexes[i]].first);
+    ret += _imp->frameNumberStringIndexes.capacity() * sizeof(int);
+    ret += _imp->templateParts.capacity() * sizeof(std::string);
+    for (StringList::const_iterator it = _imp->templateParts.begin(); it != _imp->templateParts.end(); ++it) {
+        ret += stringMemoryUsage(*it);
     }
-    return true;
+    ret += _imp->layouts.capacity() * sizeof(std::vector<int>);
+    for (unsigned int i = 0; i < _imp->layouts.size(); ++i) {
+        ret += _imp->layouts[i].capacity() * sizeof(int);
+    }
+    ret += _imp->frames.getRuns().size() * (MAP_NODE_OVERHEAD + sizeof(FrameRunSet::Runs::value_type));
+    for (std::map<int,std::string>::const_iterator it = _imp->irregularFiles.begin(); it != _imp->irregularFiles.end(); ++it) {
+        ret += MAP_NODE_OVERHEAD + sizeof(*it) + stringMemoryUsage(it->second);
+    }
+    ret += _imp->sameFrameFiles.capacity() * sizeof(std::string);
+    for (StringList::const_iterator it = _imp->sameFrameFiles.begin(); it != _imp->sameFrameFiles.end(); ++it) {
+        ret += stringMemoryUsage(*it);
+    }
+    ret += _imp->explicitFileNames.bucket_count() * sizeof(void*);
+    for (std::unordered_set<std::string>::const_iterator it = _imp->explicitFileNames.begin(); it != _imp->explicitFileNames.end(); ++it) {
+        ret += HASH_NODE_OVERHEAD + sizeof(*it) + stringMemoryUsage(*it);
+    }
+    ret += _imp->runsIndex.capacity() * sizeof(SequenceFromFilesPrivate::IndexedRun);
+    for (std::map<int,std::string>::const_iterator it = _imp->filesMap.begin(); it != _imp->filesMap.end(); ++it) {
+        ret += MAP_NODE_OVERHEAD + sizeof(*it) + stringMemoryUsage(it->second);
+    }
+    ret += _imp->filesList.capacity() * sizeof(std::string);
+    for (StringList::const_iterator it = _imp->filesList.begin(); it != _imp->filesList.end(); ++it) {
+        ret += stringMemoryUsage(*it);
+    }
+    ret += _imp->unsizedFiles.capacity() * sizeof(std::string);
+    for (StringList::const_iterator it = _imp->unsizedFiles.begin(); it != _imp->unsizedFiles.end(); ++it) {
+        ret += stringMemoryUsage(*it);
+    }
+    ret += _imp->sizingFiles.capacity() * sizeof(std::string);
+    for (StringList::const_iterator it = _imp->sizingFiles.begin(); it != _imp->sizingFiles.end(); ++it) {
+        ret += stringMemoryUsage(*it);
+    }
+    return ret;
+}
 
+std::string SequenceFromFiles::generateValidSequencePattern() const
+{
+    if (empty()) {
+        return "";
+    }
+    if (isSingleFile()) {
+        return _imp->firstFile->absoluteFileName();
+    }
+    assert(!_imp->frameNumberStringIndexes.empty());
+    std::string firstFramePattern ;
+    _imp->firstFile->generatePatternWithFrameNumberAtIndexes(_imp->frameNumberStringIndexes, &firstFramePattern);
+    return firstFramePattern;
 }
 
-bool FileNameContent::generatePatternWithFrameNumberAtIndexes(const std::vector<int>& indexes,std::string* pattern) const {
-    int numbersCount = 0;
-    size_t lastNumberPos = 0;
-    std::string indexedPattern = getFilePattern();
-    for (unsigned int i = 0; i < _imp->orderedElements.size(); ++i) {
-        if (_imp->orderedElements[i].type == FileNameElement::FRAME_NUMBER) {
-            lastNumberPos = findStr(indexedPattern, "#", lastNumberPos,true);
-            assert(lastNumberPos != std::string::npos);
+std::string SequenceFromFiles::generateUserFriendlySequencePattern() const {
+    if (isSingleFile()) {
+        return _imp->firstFile->fileName();
+    }
+    std::string pattern = generateValidSequencePattern();
+    removePath(pattern);
 
-            int endTagPos = lastNumberPos;
-            while (endTagPos < (int)indexedPattern.size() && indexedPattern.at(endTagPos) == '#') {
-                ++endTagPos;
+    ///gather the consecutive frames in chunks, stopping at the first hole of NATRON_DIALOG_MAX_SEQUENCES_HOLE frames
+    std::vector< std::pair<int,int> > chunks;
+    const FrameRunSet::Runs& runs = _imp->frames.getRuns();
+    bool holeTooBig = false;
+    for (FrameRunSet::Runs::const_iterator it = runs.begin(); it != runs.end() && !holeTooBig; ++it) {
+        const int step = it->second.stride == 1 ? it->second.last - it->first + 1 : it->second.stride;
+        for (long long first = it->first; first <= it->second.last; first += step) {
+            const int last = it->second.stride == 1 ? it->second.last : (int)first;
+            if (chunks.empty()) {
+                chunks.push_back(std::make_pair((int)first, last));
+            } else if (first == (long long)chunks.back().second + 1) {
+                chunks.back().second = last;
+            } else if (first - chunks.back().second - 1 >= NATRON_DIALOG_MAX_SEQUENCES_HOLE) {
+                holeTooBig = true;
+                break;
+            } else {
+                chunks.push_back(std::make_pair((int)first, last));
             }
+        }
+    }
 
-            ///assert that the end of the tag is composed of  a digit
-            if (endTagPos < (int)indexedPattern.size()) {
-                assert(std::isdigit(indexedPattern.at(endTagPos)));
+    if (chunks.size() == 1) {
+        pattern += ' ';
+        pattern += stringFromInt(chunks[0].first);
+        pattern += '-';
+        pattern += stringFromInt(chunks[0].second);
+    } else {
+        pattern.append(" ( ");
+        for(unsigned int i = 0 ; i < chunks.size() ; ++i) {
+            if(chunks[i].first != chunks[i].second){
+                pattern += ' ';
+                pattern += stringFromInt(chunks[i].first);
+                pattern += '-';
+                pattern += stringFromInt(chunks[i].second);
+            }else{
+                pattern += ' ';
+                pattern += stringFromInt(chunks[i].first);
             }
+            if(i < chunks.size() -1) pattern.append(" /");
+        }
+        pattern.append(" ) ");
+    }
+    return pattern;
+}
 
-            bool isNumberAFrameNumber = false;
-            for (unsigned int j = 0; j < indexes.size(); ++j) {
-                if (indexes[j] == numbersCount) {
-                    isNumberAFrameNumber = true;
-                    break;
+std::string SequenceFromFiles::fileExtension() const {
+    if (!empty()) {
+        return _imp->firstFile->getExtension();
+    } else {
+        return "";
+    }
+}
+
+std::string SequenceFromFiles::getPath() const {
+    if (!empty()) {
+        return _imp->firstFile->getPath();
+    } else {
+        return "";
+    }
+}
+
+/**
+     * @brief Groups in sequences the files of a bucket, i.e: files that have the same layout, @see computeFileLayout.
+     * For each number index, the files are hashed by all their digit runs but the one at this index: files with the same hash
+     * only differ by this number. The biggest of these groups are turned in sequences first.
+     * Files that could not be grouped that way (e.g: several numbers vary at once) are then inserted one by one in the
+     * remaining sequences of the bucket.
+     * @param bucket The index of the files of the bucket, sorted by name.
+     **/
+static void groupBucket(const StringList& files,const std::vector<FileLayout>& layouts,const std::vector<int>& bucket,
+                        bool enableSizeEstimation,std::vector<SequenceFromFiles*>* sequences)
+{
+    const int numbersCount = layouts[bucket[0]].digitRuns.size();
+
+    std::vector<FilesGroup> groups;
+    if (bucket.size() > 1) {
+        for (int n = 0; n < numbersCount; ++n) {
+            std::unordered_map<std::string,int> groupsByHash;
+            std::string hash;
+            for (unsigned int i = 0; i < bucket.size(); ++i) {
+                const std::string& file = files[bucket[i]];
+                const std::vector< std::pair<int,int> >& runs = layouts[bucket[i]].digitRuns;
+                hash.clear();
+                for (int r = 0; r < numbersCount; ++r) {
+                    if (r != n) {
+                        hash.append(file, runs[r].first, runs[r].second);
+                    }
+                    hash.push_back('\0');
+                }
+                std::pair<std::unordered_map<std::string,int>::iterator,bool> ret =
+                        groupsByHash.insert(std::make_pair(hash, (int)groups.size()));
+                if (ret.second) {
+                    groups.push_back(FilesGroup());
+                    groups.back().numberIndex = n;
                 }
+                groups[ret.first->second].files.push_back(bucket[i]);
             }
-            if (!isNumberAFrameNumber) {
-                ///if this is not the number we're interested in to keep the ###, just expand the variable
-                ///replace the whole tag with the original data
-                indexedPattern.replace(lastNumberPos, endTagPos - lastNumberPos + 1, _imp->orderedElements[i].data);
-            } else {
-                ///remove the index of the tag and keep the tag.
-                if (endTagPos < (int)indexedPattern.size()) {
-                    indexedPattern.erase(endTagPos, 1);
+        }
+    }
+    std::sort(groups.begin(), groups.end());
+
+    std::set<int> assigned;
+    std::vector<int> leftOvers;
+    for (unsigned int g = 0; g < groups.size() && groups[g].files.size() > 1; ++g) {
+        ///order the files by frame number
+        std::vector< std::pair<long long,int> > frames;
+        for (unsigned int i = 0; i < groups[g].files.size(); ++i) {
+            int index = groups[g].files[i];
+            if (assigned.find(index) == assigned.end()) {
+                const std::pair<int,int>& run = layouts[index].digitRuns[groups[g].numberIndex];
+                long long frame = 0;
+                for (int c = run.first; c < run.first + run.second && frame < INT_MAX; ++c) {
+                    frame = frame * 10 + files[index][c] - '0';
                 }
+                frames.push_back(std::make_pair(frame, index));
+            }
+        }
+        if (frames.size() < 2) {
+            continue;
+        }
+        std::sort(frames.begin(), frames.end());
+
+        SequenceFromFiles* sequence = new SequenceFromFiles(enableSizeEstimation);
+        std::vector<int> rejected;
+        for (unsigned int i = 0; i < frames.size(); ++i) {
+            assigned.insert(frames[i].second);
+            if (!sequence->tryInsertFile(FileNameContent(files[frames[i].second]))) {
+                rejected.push_back(frames[i].second);
             }
-            lastNumberPos = endTagPos;
+        }
+        if (sequence->count() < 2) {
+            ///let the left overs pass handle it
+            rejected.push_back(frames[0].second);
+            delete sequence;
+        } else {
+            sequences->push_back(sequence);
+        }
+        leftOvers.insert(leftOvers.end(), rejected.begin(), rejected.end());
+    }
 
-            ++numbersCount;
+    for (unsigned int i = 0; i < bucket.size(); ++i) {
+        if (assigned.find(bucket[i]) == assigned.end()) {
+            leftOvers.push_back(bucket[i]);
         }
     }
+    std::sort(leftOvers.begin(), leftOvers.end(), FileIndexLess(files));
+
+    ///the sequences made out of the left overs
+    std::vector<SequenceFromFiles*> leftOversSequences;
+    for (unsigned int i = 0; i < leftOvers.size(); ++i) {
+        FileNameContent file(files[leftOvers[i]]);
+        bool inserted = false;
+        for (unsigned int s = 0; s < leftOversSequences.size() && !inserted; ++s) {
+            inserted = leftOversSequences[s]->tryInsertFile(file);
+        }
+        if (!inserted) {
+            leftOversSequences.push_back(new SequenceFromFiles(file, enableSizeEstimation));
+        }
+    }
+    sequences->insert(sequences->end(), leftOversSequences.begin(), leftOversSequences.end());
+}
+
+///Implementation of getSequenceOutOfFile, checking token (if not null) before reading each batch
+static ScanStatus scanSequenceOutOfFile(const std::string& absoluteFileName,SequenceFromFiles* sequence,const ScanToken* token)
+{
+    FileNameContent firstFile(absoluteFileName);
+    if (sequence->tryInsertFile(firstFile) && token) {
+        ScanProgressReporter::report(*token, 0, 1);
+    }
 
-    for (unsigned int i = 0; i < indexes.size(); ++i) {
-        ///check that all index is valid.
-        if (indexes[i] >= numbersCount) {
-            return false;
+    const std::string path = firstFile.getPath();
+    FilesListingReader reader(token);
+    if (!reader.open(path)) {
+        return SCAN_FAILED;
+    }
+
+    std::string absoluteName;
+    StringList batch;
+    for (;;) {
+        if (token && token->isCancelled()) {
+            return SCAN_CANCELLED;
+        }
+        if (!reader.readBatch(&batch)) {
+            break;
         }
+        std::size_t matchesCount = 0;
+        for (StringList::iterator it = batch.begin(); it != batch.end(); ++it) {
+            absoluteName.assign(path).append(*it);
+            if (sequence->tryInsertFile(FileNameContent(absoluteName))) {
+                ++matchesCount;
+            }
+        }
+        if (token) {
+            ScanProgressReporter::report(*token, batch.size(), matchesCount);
+        }
+        batch.clear();
     }
+    return SCAN_SUCCEEDED;
+}
 
-    *pattern = getPath() + indexedPattern;
-    return true;
+bool SequenceFromFiles::getSequenceOutOfFile(const std::string& absoluteFileName,SequenceFromFiles* sequence)
+{
+    InstalledObjectUse<SequenceIndex> index(getInstalledSequenceIndex());
+    if (index.acquire()) {
+        return index->getSequenceOutOfFile(absoluteFileName, sequence) == SCAN_SUCCEEDED;
+    }
+    return scanSequenceOutOfFile(absoluteFileName, sequence, 0) == SCAN_SUCCEEDED;
 }
 
+std::future<SequenceFromFilesScanResult> SequenceFromFiles::getSequenceOutOfFileAsync(const std::string& absoluteFileName,
+                                                                                      const ScanToken& token,
+                                                                                      const ScanExecutor& executor)
+{
+    std::shared_ptr< std::promise<SequenceFromFilesScanResult> > promise = std::make_shared< std::promise<SequenceFromFilesScanResult> >();
+    std::future<SequenceFromFilesScanResult> ret = promise->get_future();
+    runScanTask(executor, [absoluteFileName, token, promise]() {
+        try {
+            SequenceFromFilesScanResult result;
+            InstalledObjectUse<SequenceIndex> index(getInstalledSequenceIndex());
+            if (index.acquire()) {
+                result.status = index->getSequenceOutOfFile(absoluteFileName, &result.sequence, token);
+            } else {
+                result.status = scanSequenceOutOfFile(absoluteFileName, &result.sequence, &token);
+            }
+            promise->set_value(std::move(result));
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return ret;
+}
 
-std::string removePath(std::string& filename) {
+bool SequenceFromFiles::getSequencesOutOfDirectory(const std::string& directory,std::vector<SequenceFromFiles>* sequences,
+                                                   bool enableSizeEstimation)
+{
+    StringList allFiles;
+    if (!getFilesFromDir(directory, &allFiles)) {
+        return false;
+    }
 
-    ///find the last separator
-    size_t pos = filename.find_last_of('/');
-    if (pos == std::string::npos) {
-        //try out \\ char
-        pos = filename.find_last_of('\\');
+    std::string path = directory;
+    if (!path.empty() && path[path.size() - 1] != '/' && path[path.size() - 1] != '\\') {
+        path.push_back('/');
     }
-    if(pos == std::string::npos) {
-        ///couldn't find a path
-        return "";
+    for (StringList::iterator it = allFiles.begin(); it!=allFiles.end(); ++it) {
+        it->insert(0, path);
     }
-    std::string path = filename.substr(0,pos+1); // + 1 to include the trailing separator
-    removeAllOccurences(filename, path,true);
-    return path;
+    getSequencesOutOfFiles(allFiles, sequences, enableSizeEstimation);
+    return true;
 }
 
+bool SequenceFromFiles::getSequencesOutOfDirectoryTree(const std::string& root,const DirectoryTreeOptions& options,
+                                                       std::vector<SequenceFromFiles>* sequences)
+{
+    std::string path = root;
+    if (!path.empty() && path[path.size() - 1] != '/' && path[path.size() - 1] != '\\') {
+        path.push_back('/');
+    }
+    unsigned int threadsCount = options.threadsCount;
+    if (threadsCount == 0) {
+        threadsCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
 
-bool filesListFromPattern(const std::string& pattern,SequenceParsing::SequenceFromPattern* sequence) {
-    if (pattern.empty()) {
+    DirectoryTreeScan scan(options, threadsCount);
+    ///the root is scanned by the calling thread, which then helps the pool with the sub-directories
+    if (!scan.scan(path, 0, 0)) {
         return false;
     }
+    scan.pool.wait();
 
-    std::string patternUnPathed = pattern;
-    std::string patternPath = removePath(patternUnPathed);
-    std::string patternExtension = removeFileExtension(patternUnPathed);
+    std::vector<DirectoryTreeScan::DirectorySequences> directories;
+    for (unsigned int i = 0; i < scan.results.size(); ++i) {
+        std::move(scan.results[i].begin(), scan.results[i].end(), std::back_inserter(directories));
+    }
+    std::sort(directories.begin(), directories.end());
+    for (unsigned int i = 0; i < directories.size(); ++i) {
+        std::move(directories[i].sequences.begin(), directories[i].sequences.end(), std::back_inserter(*sequences));
+    }
+    return true;
+}
 
-    ///the pattern has no extension, switch the extension and the unpathed part
-    if (patternUnPathed.empty()) {
-        patternUnPathed = patternExtension;
-        patternExtension.clear();
+void SequenceFromFiles::getSequencesOutOfFiles(const StringList& absoluteFileNames,std::vector<SequenceFromFiles>* sequences,
+                                               bool enableSizeEstimation)
+{
+    ///sort the files by name so that the result doesn't depend on the order of the directory listing
+    std::vector<int> sortedFiles(absoluteFileNames.size());
+    for (unsigned int i = 0; i < sortedFiles.size(); ++i) {
+        sortedFiles[i] = i;
+    }
+    std::sort(sortedFiles.begin(), sortedFiles.end(), FileIndexLess(absoluteFileNames));
+
+    ///bucket the files by layout, see computeFileLayout
+    std::vector<FileLayout> layouts(absoluteFileNames.size());
+    typedef std::unordered_map<std::string, std::vector<int> > Buckets;
+    Buckets buckets;
+    std::vector<const std::vector<int>*> orderedBuckets;
+    for (unsigned int i = 0; i < sortedFiles.size(); ++i) {
+        int index = sortedFiles[i];
+        ///skip duplicates
+        if (i > 0 && absoluteFileNames[index] == absoluteFileNames[sortedFiles[i - 1]]) {
+            continue;
+        }
+        computeFileLayout(absoluteFileNames[index], &layouts[index]);
+        std::pair<Buckets::iterator,bool> ret = buckets.insert(std::make_pair(layouts[index].key, std::vector<int>()));
+        ret.first->second.push_back(index);
+        if (ret.second) {
+            orderedBuckets.push_back(&ret.first->second);
+        }
+        layouts[index].key.clear();
     }
 
-    tinydir_dir patternDir;
-    if (tinydir_open(&patternDir, patternPath.c_str()) == -1) {
-        return false;
+    ///the sequences found, in no particular order
+    std::vector<SequenceFromFiles*> found;
+    for (unsigned int b = 0; b < orderedBuckets.size(); ++b) {
+        groupBucket(absoluteFileNames, layouts, *orderedBuckets[b], enableSizeEstimation, &found);
     }
 
-    ///this list represents the common parts of the filename to find in a file in order for it to match the pattern.
-    StringList commonPartsToFind;
-    ///this list represents the variables ( ###  %04d %v etc...) found in the pattern ordered from left to right in the
-    ///original string.
-    std::vector< std::pair<std::string,int> > variablesByOrder;
+    std::vector<std::pair<std::string,int> > order(found.size());
+    for (unsigned int i = 0; i < found.size(); ++i) {
+        ///avoid building the whole files list of big sequences
+        if (found[i]->isSingleFile() || !found[i]->getFileNameForFrame(found[i]->getFirstFrame(), &order[i].first)) {
+            order[i].first = found[i]->getFilesList()[0];
+        }
+        order[i].second = i;
+    }
+    std::sort(order.begin(), order.end());
+    sequences->reserve(sequences->size() + found.size());
+    for (unsigned int i = 0; i < order.size(); ++i) {
+        sequences->push_back(std::move(*found[order[i].second]));
+        delete found[order[i].second];
+    }
+}
 
-    extractCommonPartsAndVariablesFromPattern(patternUnPathed, patternExtension, &commonPartsToFind, &variablesByOrder);
 
+////////////////////PatternWatcher//////////////////////////
 
-    ///all the interesting files of the pattern directory
-    StringList files;
-    getFilesFromDir(patternDir, &files);
-    tinydir_close(&patternDir);
+struct PatternWatcherPrivate
+{
+    CompiledPattern pattern;
+    SequenceFromPattern sequence;
+    PatternWatcher::ChangesCallback changesCallback;
+    int coalescingDelay;
+    bool started;
+#ifdef __linux__
+    int inotifyFd;
+    ///set once the directory path is not watched anymore (e.g: it was deleted), poll() then rescans it
+    bool watchRemoved;
+#endif
 
-    for (int i = 0; i < (int)files.size(); ++i) {
-        int frameNumber;
-        int viewNumber;
-        if (matchesPattern(files.at(i), commonPartsToFind, variablesByOrder, &frameNumber, &viewNumber)) {
-            SequenceFromPattern::iterator it = sequence->find(frameNumber);
-            std::string absoluteFileName = patternPath + files.at(i);
-            if (it != sequence->end()) {
-                std::pair<std::map<int,std::string>::iterator,bool> ret =
-                        it->second.insert(std::make_pair(viewNumber,absoluteFileName));
-                if (!ret.second) {
-                    std::cerr << "There was an issue populating the file sequence. Several files with the same frame number"
-                                 " have the same view index." << std::endl;
-                }
-            } else {
-                std::map<int, std::string> viewsMap;
-                viewsMap.insert(std::make_pair(viewNumber, absoluteFileName));
-                sequence->insert(std::make_pair(frameNumber, viewsMap));
+    PatternWatcherPrivate(const CompiledPattern& pattern)
+        : pattern(pattern)
+        , sequence()
+        , changesCallback()
+        , coalescingDelay(50)
+        , started(false)
+#ifdef __linux__
+        , inotifyFd(-1)
+        , watchRemoved(false)
+#endif
+    {
+    }
+
+    ///Adds or removes a file of the directory, depending on whether it exists
+    void applyFileState(const std::string& fileName,bool exists,std::vector<SequenceChange>* changes);
+
+    ///Lists the directory again and applies the differences with the sequence
+    void rescan(std::vector<SequenceChange>* changes);
+
+#ifdef __linux__
+    ///Returns true if the file just created is complete, i.e: it is not a regular file being written.
+    ///Like when listing the directory, links to directories don't count as files.
+    bool isCompleteOnCreation(const char* fileName) const;
+
+    ///Reads the pending inotify events: the last state of each file is put in files, in the order they were first seen.
+    ///Returns false if events were lost or the directory is not watched anymore.
+    bool readEvents(std::vector< std::pair<std::string,bool> >* files,std::unordered_map<std::string,std::size_t>* filesIndexes);
+#endif
+};
+
+static void addSequenceChange(SequenceChange::Type type,int frameNumber,int viewNumber,const std::string& absoluteFileName,
+                              std::vector<SequenceChange>* changes)
+{
+    SequenceChange change;
+    change.type = type;
+    change.frameNumber = frameNumber;
+    change.viewNumber = viewNumber;
+    change.absoluteFileName = absoluteFileName;
+    changes->push_back(change);
+}
+
+void PatternWatcherPrivate::applyFileState(const std::string& fileName,bool exists,std::vector<SequenceChange>* changes)
+{
+    int frameNumber = 0;
+    int viewNumber = -1;
+    if (!pattern.matches(fileName, &frameNumber, &viewNumber)) {
+        return;
+    }
+    const std::string absoluteFileName = pattern.getPath() + fileName;
+    SequenceFromPattern::iterator frame = sequence.find(frameNumber);
+    if (exists) {
+        ///a file already in the sequence was written again, or another file has the same frame and view
+        if (frame != sequence.end() && frame->second.find(viewNumber) != frame->second.end()) {
+            return;
+        }
+        sequence[frameNumber].insert(std::make_pair(viewNumber, absoluteFileName));
+        addSequenceChange(SequenceChange::FILE_ADDED, frameNumber, viewNumber, absoluteFileName, changes);
+    } else {
+        if (frame == sequence.end()) {
+            return;
+        }
+        std::map<int,std::string>::iterator view = frame->second.find(viewNumber);
+        if (view == frame->second.end() || view->second != absoluteFileName) {
+            return;
+        }
+        frame->second.erase(view);
+        if (frame->second.empty()) {
+            sequence.erase(frame);
+        }
+        addSequenceChange(SequenceChange::FILE_REMOVED, frameNumber, viewNumber, absoluteFileName, changes);
+    }
+}
+
+void PatternWatcherPrivate::rescan(std::vector<SequenceChange>* changes)
+{
+    ///a directory that cannot be opened anymore has no files
+    SequenceFromPattern newSequence;
+    filesListFromPattern(pattern, &newSequence);
+
+    for (SequenceFromPattern::const_iterator it = sequence.begin(); it != sequence.end(); ++it) {
+        SequenceFromPattern::const_iterator newFrame = newSequence.find(it->first);
+        for (std::map<int,std::string>::const_iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
+            std::map<int,std::string>::const_iterator newView;
+            if (newFrame == newSequence.end() || (newView = newFrame->second.find(it2->first)) == newFrame->second.end() ||
+                    newView->second != it2->second) {
+                addSequenceChange(SequenceChange::FILE_REMOVED, it->first, it2->first, it2->second, changes);
             }
         }
     }
-    return true;
+    for (SequenceFromPattern::const_iterator it = newSequence.begin(); it != newSequence.end(); ++it) {
+        SequenceFromPattern::const_iterator oldFrame = sequence.find(it->first);
+        for (std::map<int,std::string>::const_iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
+            std::map<int,std::string>::const_iterator oldView;
+            if (oldFrame == sequence.end() || (oldView = oldFrame->second.find(it2->first)) == oldFrame->second.end() ||
+                    oldView->second != it2->second) {
+                addSequenceChange(SequenceChange::FILE_ADDED, it->first, it2->first, it2->second, changes);
+            }
+        }
+    }
+    sequence.swap(newSequence);
+}
+
+#ifdef __linux__
+bool PatternWatcherPrivate::isCompleteOnCreation(const char* fileName) const
+{
+    const std::string absoluteFileName = pattern.getPath() + fileName;
+    struct stat st;
+    if (::lstat(absoluteFileName.c_str(), &st) != 0 || S_ISDIR(st.st_mode)) {
+        return false;
+    }
+    if (S_ISLNK(st.st_mode)) {
+        ///broken links are files too
+        return ::stat(absoluteFileName.c_str(), &st) != 0 || !S_ISDIR(st.st_mode);
+    }
+    ///a new hard link to a file has more than one link, a file being written has a single one
+    return !S_ISREG(st.st_mode) || st.st_nlink > 1;
 }
 
-StringList sequenceFromPatternToFilesList(const SequenceParsing::SequenceFromPattern& sequence,int onlyViewIndex ) {
-    StringList ret;
-    for (SequenceParsing::SequenceFromPattern::const_iterator it = sequence.begin(); it!=sequence.end(); ++it) {
-        const std::map<int,std::string>& views = it->second;
+bool PatternWatcherPrivate::readEvents(std::vector< std::pair<std::string,bool> >* files,
+                                       std::unordered_map<std::string,std::size_t>* filesIndexes)
+{
+    bool ret = true;
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    for (;;) {
+        ssize_t bytesCount = ::read(inotifyFd, buffer, sizeof(buffer));
+        if (bytesCount <= 0) {
+            break;
+        }
+        for (char* it = buffer; it < buffer + bytesCount; ) {
+            const struct inotify_event* event = (const struct inotify_event*)it;
+            it += sizeof(struct inotify_event) + event->len;
 
-        for (std::map<int,std::string>::const_iterator it2 = views.begin(); it2!=views.end(); ++it2) {
-            if (onlyViewIndex != -1 && it2->first != onlyViewIndex && it2->first != -1) {
+            if (event->mask & IN_Q_OVERFLOW) {
+                ret = false;
                 continue;
             }
-            ret.push_back(it2->second);
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                watchRemoved = true;
+                ret = false;
+                continue;
+            }
+            if (event->len == 0 || (event->mask & IN_ISDIR)) {
+                continue;
+            }
+            ///a new file is added once written and closed, but links and special files are complete once created
+            if ((event->mask & IN_CREATE) && !isCompleteOnCreation(event->name)) {
+                continue;
+            }
+            const bool exists = (event->mask & (IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO)) != 0;
+            std::pair<std::unordered_map<std::string,std::size_t>::iterator,bool> inserted =
+                    filesIndexes->insert(std::make_pair(std::string(event->name), files->size()));
+            if (inserted.second) {
+                files->push_back(std::make_pair(inserted.first->first, exists));
+            } else {
+                (*files)[inserted.first->second].second = exists;
+            }
         }
     }
     return ret;
 }
 
-std::string generateFileNameFromPattern(const std::string& pattern,int frameNumber,int viewNumber) {
-    std::string patternUnPathed = pattern;
-    std::string patternPath = removePath(patternUnPathed);
-    std::string patternExtension = removeFileExtension(patternUnPathed);
+///Waits up to timeoutMs (-1 for ever) for fd to be readable
+static bool waitReadable(int fd,int timeoutMs)
+{
+    struct pollfd pollFd;
+    pollFd.fd = fd;
+    pollFd.events = POLLIN;
+    pollFd.revents = 0;
+    int ret;
+    do {
+        ret = ::poll(&pollFd, 1, timeoutMs);
+    } while (ret == -1 && errno == EINTR);
+    return ret > 0;
+}
+#endif
 
-    ///the pattern has no extension, switch the extension and the unpathed part
-    if (patternUnPathed.empty()) {
-        patternUnPathed = patternExtension;
-        patternExtension.clear();
+PatternWatcher::PatternWatcher(const CompiledPattern& pattern)
+    : _imp(new PatternWatcherPrivate(pattern))
+{
+}
+
+PatternWatcher::PatternWatcher(const SequenceFromFiles& sequence)
+    : _imp(new PatternWatcherPrivate(CompiledPattern(sequence.generateValidSequencePattern())))
+{
+}
+
+PatternWatcher::~PatternWatcher() {
+    stop();
+    delete _imp;
+}
+
+bool PatternWatcher::start() {
+    stop();
+    if (!_imp->pattern.isValid()) {
+        return false;
     }
-    ///this list represents the common parts of the filename to find in a file in order for it to match the pattern.
-    StringList commonPartsToFind;
-    ///this list represents the variables ( ###  %04d %v etc...) found in the pattern ordered from left to right in the
-    ///original string.
-    std::vector<std::pair<std::string,int> > variablesByOrder;
-    extractCommonPartsAndVariablesFromPattern(patternUnPathed, patternExtension, &commonPartsToFind, &variablesByOrder);
+#ifdef __linux__
+    ///watch before the scan so that no change is missed, the changes seen by both are ignored by poll()
+    const std::string& path = _imp->pattern.getPath();
+    _imp->watchRemoved = false;
+    _imp->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_imp->inotifyFd != -1 &&
+            inotify_add_watch(_imp->inotifyFd, path.empty() ? "." : path.c_str(),
+                              IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF |
+                              IN_ONLYDIR) == -1) {
+        ::close(_imp->inotifyFd);
+        _imp->inotifyFd = -1;
+    }
+#endif
+    _imp->sequence.clear();
+    if (!filesListFromPattern(_imp->pattern, &_imp->sequence)) {
+        stop();
+        return false;
+    }
+    _imp->started = true;
+    return true;
+}
 
-    std::string output = pattern;
-    size_t lastVariablePos = std::string::npos;
-    for (unsigned int i = 0; i < variablesByOrder.size(); ++i) {
-        const std::string& variable = variablesByOrder[i].first;
-        lastVariablePos = findStr(output, variable, lastVariablePos != std::string::npos ? lastVariablePos : 0);
+void PatternWatcher::stop() {
+#ifdef __linux__
+    if (_imp->inotifyFd != -1) {
+        ::close(_imp->inotifyFd);
+        _imp->inotifyFd = -1;
+    }
+#endif
+    _imp->started = false;
+}
 
-        ///if we can't find the variable that means extractCommonPartsAndVariablesFromPattern is bugged.
-        assert(lastVariablePos != std::string::npos);
+void PatternWatcher::setChangesCallback(const ChangesCallback& callback) {
+    _imp->changesCallback = callback;
+}
 
-        if (variable.find_first_of('#') != std::string::npos) {
-            std::string frameNoStr = stringFromInt(frameNumber);
-            ///prepend with extra 0's
-            while (frameNoStr.size() < variable.size()) {
-                frameNoStr.insert(0,1,'0');
-            }
-            output.replace(lastVariablePos, variable.size(), frameNoStr);
-        } else if (variable.find("%v") != std::string::npos) {
-            std::string viewNumberStr;
-            if (viewNumber == 0) {
-                viewNumberStr = "l";
-            } else if (viewNumber == 1) {
-                viewNumberStr = "r";
-            } else {
-                viewNumberStr = std::string("view") + stringFromInt(viewNumber);
-            }
+void PatternWatcher::setCoalescingDelay(int milliseconds) {
+    _imp->coalescingDelay = milliseconds;
+}
 
-            output.replace(lastVariablePos,variable.size(), viewNumberStr);
-        } else if (variable.find("%V") != std::string::npos) {
-            std::string viewNumberStr;
-            if (viewNumber == 0) {
-                viewNumberStr = "left";
-            } else if (viewNumber == 1) {
-                viewNumberStr = "right";
-            } else {
-                viewNumberStr = std::string("view") + stringFromInt(viewNumber);
-            }
-
-            output.replace(lastVariablePos, variable.size(), viewNumberStr);
-        } else if(startsWith(variable, "%0") && endsWith(variable,"d")) {
-            std::string digitsCountStr = variable;
-            removeAllOccurences(digitsCountStr,"%0");
-            removeAllOccurences(digitsCountStr,"d");
-            int digitsCount = stringToInt(digitsCountStr);
-            std::string frameNoStr = stringFromInt(frameNumber);
-            //prepend with extra 0's
-            while ((int)frameNoStr.size() < digitsCount) {
-                frameNoStr.insert(0,1,'0');
-            }
-            output.replace(lastVariablePos, variable.size(), frameNoStr);
-        } else if (variable == "%d") {
-            output.replace(lastVariablePos, variable.size(), stringFromInt(frameNumber));
+int PatternWatcher::poll(int timeoutMs) {
+    if (!_imp->started) {
+        return 0;
+    }
+    std::vector<SequenceChange> changes;
+#ifdef __linux__
+    if (_imp->inotifyFd != -1) {
+        if (!waitReadable(_imp->inotifyFd, timeoutMs)) {
+            return 0;
+        }
+        std::vector< std::pair<std::string,bool> > files;
+        std::unordered_map<std::string,std::size_t> filesIndexes;
+        bool eventsLost = !_imp->readEvents(&files, &filesIndexes);
+        const std::chrono::steady_clock::time_point deadline =
+                std::chrono::steady_clock::now() + std::chrono::milliseconds(_imp->coalescingDelay);
+        for (;;) {
+            int remaining = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0 || !waitReadable(_imp->inotifyFd, remaining)) {
+                break;
+            }
+            eventsLost = !_imp->readEvents(&files, &filesIndexes) || eventsLost;
+        }
+        if (_imp->watchRemoved) {
+            ::close(_imp->inotifyFd);
+            _imp->inotifyFd = -1;
+        }
+        if (eventsLost) {
+            _imp->rescan(&changes);
         } else {
-            throw std::invalid_argument("Unrecognized pattern: " + pattern);
+            for (std::size_t i = 0; i < files.size(); ++i) {
+                _imp->applyFileState(files[i].first, files[i].second, &changes);
+            }
+        }
+    } else
+#endif
+    {
+        if (timeoutMs > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
         }
+        _imp->rescan(&changes);
     }
-    return output;
+    if (!changes.empty() && _imp->changesCallback) {
+        _imp->changesCallback(changes);
+    }
+    return (int)changes.size();
 }
 
-struct SequenceFromFilesPrivate
-{
-    /// the parsed files that have matching content with respect to variables.
-    std::vector < FileNameContent > sequence;
-
-    ///a list with all the files in the sequence, with their absolute file names.
-    StringList filesList;
+int PatternWatcher::getFileDescriptor() const {
+#ifdef __linux__
+    return _imp->inotifyFd;
+#else
+    return -1;
+#endif
+}
 
-    ///all the files mapped to their index
-    std::map<int,std::string> filesMap;
+const SequenceFromPattern& PatternWatcher::getSequence() const {
+    return _imp->sequence;
+}
 
-    /// The index of the frame number string in case there're several numbers in a filename.
-    std::vector<int> frameNumberStringIndexes;
 
-    unsigned long long totalSize;
+////////////////////ScanCache//////////////////////////
 
-    bool sizeEstimationEnabled;
+///"SPSC" read in the native byte order: a file written on a machine with another byte order is rejected
+#define SCAN_CACHE_MAGIC 0x53505343u
+#define SCAN_CACHE_VERSION 1u
 
-    SequenceFromFilesPrivate(bool enableSizeEstimation)
-        : sequence()
-        , filesList()
-        , filesMap()
-        , frameNumberStringIndexes()
-        , totalSize(0)
-        , sizeEstimationEnabled(enableSizeEstimation)
+struct ScanCachePrivate
+{
+    struct Directory
     {
+        long long modificationTime;
+        std::shared_ptr<const StringList> files;
+    };
 
-    }
+    mutable std::mutex mutex;
+    ///directories by device and inode
+    std::map<std::pair<unsigned long long,unsigned long long>,Directory> directories;
 
-    bool isInSequence(int index) const {
-        return filesMap.find(index) != filesMap.end();
+    ScanCachePrivate()
+        : mutex()
+        , directories()
+    {
     }
 };
 
-SequenceFromFiles::SequenceFromFiles(bool enableSizeEstimation)
-    : _imp(new SequenceFromFilesPrivate(enableSizeEstimation))
+template <typename T>
+static void writeValue(std::string* buffer,T value)
 {
-
+    buffer->append(reinterpret_cast<const char*>(&value), sizeof(T));
 }
 
-SequenceFromFiles::SequenceFromFiles(const FileNameContent& firstFile,  bool enableSizeEstimation)
-    : _imp(new SequenceFromFilesPrivate(enableSizeEstimation))
+///Reads a value at *pos from data, returns false if there are not enough bytes left
+template <typename T>
+static bool readValue(const std::string& data,std::size_t* pos,T* value)
 {
-    _imp->sequence.push_back(firstFile);
-    _imp->filesList.push_back(firstFile.absoluteFileName());
-    if (enableSizeEstimation) {
-        std::ifstream file(firstFile.absoluteFileName().c_str(), std::ios::binary | std::ios::ate);
-        _imp->totalSize += file.tellg();
+    if (data.size() - *pos < sizeof(T)) {
+        return false;
     }
+    std::memcpy(value, data.data() + *pos, sizeof(T));
+    *pos += sizeof(T);
+    return true;
 }
 
-SequenceFromFiles::~SequenceFromFiles() {
-    delete _imp;
-}
-
-SequenceFromFiles::SequenceFromFiles(const SequenceFromFiles& other)
-    : _imp(new SequenceFromFilesPrivate(false))
+ScanCache::ScanCache()
+    : _imp(new ScanCachePrivate())
 {
-    *this = other;
 }
 
-void SequenceFromFiles::operator=(const SequenceFromFiles& other) const {
-    _imp->sequence = other._imp->sequence;
-    _imp->filesList = other._imp->filesList;
-    _imp->filesMap = other._imp->filesMap;
-    _imp->frameNumberStringIndexes = other._imp->frameNumberStringIndexes;
-    _imp->totalSize = other._imp->totalSize;
-    _imp->sizeEstimationEnabled = other._imp->sizeEstimationEnabled;
+ScanCache::~ScanCache() {
+    ///uninstall this cache if it is the installed one, once the scans using it are done
+    getInstalledScanCache().uninstall(this);
+    delete _imp;
 }
 
-bool SequenceFromFiles::tryInsertFile(const FileNameContent& file) {
-
-    if (_imp->filesList.empty()) {
-        _imp->sequence.push_back(file);
-        _imp->filesList.push_back(file.absoluteFileName());
-        if (_imp->sizeEstimationEnabled) {
-            std::ifstream f(file.absoluteFileName().c_str(), std::ios::binary | std::ios::ate);
-            _imp->totalSize += f.tellg();
-        }
-        return true;
+bool ScanCache::load(const std::string& cacheFilePath) {
+    clear();
+    std::ifstream file(cacheFilePath.c_str(), std::ios::binary);
+    if (!file) {
+        return false;
     }
-
-    if (file.getPath() != _imp->sequence[0].getPath()) {
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    std::size_t pos = 0;
+    unsigned int magic, version;
+    unsigned long long directoriesCount;
+    if (!readValue(data, &pos, &magic) || magic != SCAN_CACHE_MAGIC ||
+            !readValue(data, &pos, &version) || version != SCAN_CACHE_VERSION ||
+            !readValue(data, &pos, &directoriesCount)) {
         return false;
     }
-
-    std::vector<int> frameNumberIndexes;
-    bool insert = false;
-    if (file.matchesPattern(_imp->sequence[0], &frameNumberIndexes)) {
-
-        if (std::find(_imp->filesList.begin(),_imp->filesList.end(),file.absoluteFileName()) != _imp->filesList.end()) {
+    std::map<std::pair<unsigned long long,unsigned long long>,ScanCachePrivate::Directory> directories;
+    for (unsigned long long i = 0; i < directoriesCount; ++i) {
+        unsigned long long device, inode;
+        ScanCachePrivate::Directory directory;
+        unsigned int filesCount;
+        if (!readValue(data, &pos, &device) || !readValue(data, &pos, &inode) ||
+                !readValue(data, &pos, &directory.modificationTime) || !readValue(data, &pos, &filesCount)) {
             return false;
         }
-
-        if (_imp->frameNumberStringIndexes.empty()) {
-            ///this is the second file we add to the sequence, we can now
-            ///determine where is the frame number string placed.
-            _imp->frameNumberStringIndexes = frameNumberIndexes;
-            insert = true;
-
-            ///insert the first frame number in the frameIndexes.
-            std::string firstFrameNumberStr;
-
-            for (unsigned int i = 0; i < frameNumberIndexes.size(); ++i) {
-                std::string frameNumberStr;
-                bool ok = _imp->sequence[0].getNumberByIndex(_imp->frameNumberStringIndexes[i], &frameNumberStr);
-                if (ok && firstFrameNumberStr.empty()) {
-                    _imp->filesMap.insert(std::make_pair(stringToInt(frameNumberStr),file.absoluteFileName()));
-                    firstFrameNumberStr = frameNumberStr;
-                } else if (!firstFrameNumberStr.empty() && stringToInt(frameNumberStr) != stringToInt(firstFrameNumberStr)) {
-                    return false;
-                }
+        std::shared_ptr<StringList> files = std::make_shared<StringList>();
+        ///each file takes at least 4 bytes, don't trust a corrupted count to reserve memory
+        files->reserve(std::min<std::size_t>(filesCount, (data.size() - pos) / sizeof(unsigned int)));
+        for (unsigned int j = 0; j < filesCount; ++j) {
+            unsigned int length;
+            if (!readValue(data, &pos, &length) || data.size() - pos < length) {
+                return false;
             }
+            files->push_back(data.substr(pos, length));
+            pos += length;
+        }
+        directory.files = files;
+        directories[std::make_pair(device, inode)] = directory;
+    }
+    if (pos != data.size()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(_imp->mutex);
+    _imp->directories.swap(directories);
+    return true;
+}
 
+bool ScanCache::save(const std::string& cacheFilePath) const {
+    std::string data;
+    {
+        std::lock_guard<std::mutex> lock(_imp->mutex);
+        writeValue(&data, (unsigned int)SCAN_CACHE_MAGIC);
+        writeValue(&data, (unsigned int)SCAN_CACHE_VERSION);
+        writeValue(&data, (unsigned long long)_imp->directories.size());
+        for (std::map<std::pair<unsigned long long,unsigned long long>,ScanCachePrivate::Directory>::const_iterator it = _imp->directories.begin();
+             it != _imp->directories.end(); ++it) {
+            writeValue(&data, it->first.first);
+            writeValue(&data, it->first.second);
+            writeValue(&data, it->second.modificationTime);
+            writeValue(&data, (unsigned int)it->second.files->size());
+            for (StringList::const_iterator it2 = it->second.files->begin(); it2 != it->second.files->end(); ++it2) {
+                writeValue(&data, (unsigned int)it2->size());
+                data.append(*it2);
+            }
+        }
+    }
 
-        } else if(frameNumberIndexes == _imp->frameNumberStringIndexes) {
-            insert = true;
+    const std::string temporaryPath = cacheFilePath + ".tmp";
+    {
+        std::ofstream file(temporaryPath.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file.write(data.data(), data.size()) || !file.flush()) {
+            return false;
         }
-        if (insert) {
+    }
+    if (std::rename(temporaryPath.c_str(), cacheFilePath.c_str()) != 0) {
+        ///rename doesn't replace existing files on every platform
+        std::remove(cacheFilePath.c_str());
+        if (std::rename(temporaryPath.c_str(), cacheFilePath.c_str()) != 0) {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+    return true;
+}
 
-            std::string firstFrameNumberStr;
+void ScanCache::clear() {
+    std::lock_guard<std::mutex> lock(_imp->mutex);
+    _imp->directories.clear();
+}
 
-            for (unsigned int i = 0; i < frameNumberIndexes.size(); ++i) {
-                std::string frameNumberStr;
-                bool ok = file.getNumberByIndex(_imp->frameNumberStringIndexes[i], &frameNumberStr);
-                if (ok && firstFrameNumberStr.empty()) {
-                    _imp->sequence.push_back(file);
-                    _imp->filesList.push_back(file.absoluteFileName());
-                    _imp->filesMap.insert(std::make_pair(stringToInt(frameNumberStr),file.absoluteFileName()));
-                    if (_imp->sizeEstimationEnabled) {
-                        std::ifstream f(file.absoluteFileName().c_str(), std::ios::binary | std::ios::ate);
-                        _imp->totalSize += f.tellg();
-                    }
+std::size_t ScanCache::getDirectoriesCount() const {
+    std::lock_guard<std::mutex> lock(_imp->mutex);
+    return _imp->directories.size();
+}
 
-                    firstFrameNumberStr = frameNumberStr;
-                } else if (!firstFrameNumberStr.empty() && stringToInt(frameNumberStr) != stringToInt(firstFrameNumberStr)) {
-                    return false;
-                }
-            }
-        }
+bool ScanCache::findFilesList(unsigned long long device,unsigned long long inode,long long modificationTime,
+                              std::shared_ptr<const StringList>* files) const {
+    std::lock_guard<std::mutex> lock(_imp->mutex);
+    std::map<std::pair<unsigned long long,unsigned long long>,ScanCachePrivate::Directory>::const_iterator found =
+            _imp->directories.find(std::make_pair(device, inode));
+    if (found == _imp->directories.end() || found->second.modificationTime != modificationTime) {
+        return false;
     }
-    return insert;
+    *files = found->second.files;
+    return true;
 }
 
-bool SequenceFromFiles::contains(const std::string& absoluteFileName) const {
-    return std::find(_imp->filesList.begin(),_imp->filesList.end(),absoluteFileName) != _imp->filesList.end();
+void ScanCache::storeFilesList(unsigned long long device,unsigned long long inode,long long modificationTime,const StringList& files) {
+    ScanCachePrivate::Directory directory;
+    directory.modificationTime = modificationTime;
+    directory.files = std::make_shared<const StringList>(files);
+    std::lock_guard<std::mutex> lock(_imp->mutex);
+    _imp->directories[std::make_pair(device, inode)] = directory;
 }
 
-bool SequenceFromFiles::empty() const {
-    return _imp->filesList.empty();
+void setScanCache(ScanCache* cache) {
+    getInstalledScanCache().install(cache);
 }
 
-int SequenceFromFiles::count() const {
-    return (int)_imp->filesList.size();
+ScanCache* getScanCache() {
+    return getInstalledScanCache().get();
 }
 
-bool SequenceFromFiles::isSingleFile() const {
-    return _imp->sequence.size() == 1;
-}
+struct SequenceIndexPrivate
+{
+    struct Directory
+    {
+        std::string path;
+        unsigned long long device;
+        unsigned long long inode;
+        long long modificationTime;
+        ///the files of the directory, parsed, in the order they were listed
+        std::shared_ptr<const std::vector<FileNameContent> > files;
+        ///the sequences found by getSequenceOutOfFile, by file name (without path)
+        std::unordered_map<std::string,SequenceFromFiles> sequences;
+        std::size_t memoryUsage;
+    };
+    typedef std::list<Directory> Directories;
+
+    mutable std::mutex mutex;
+    std::size_t maxMemoryUsage;
+    std::size_t memoryUsage;
+    ///the most recently used first
+    Directories directories;
+    std::unordered_map<std::string,Directories::iterator> directoriesByPath;
+
+    SequenceIndexPrivate(std::size_t maxMemoryUsage)
+        : mutex()
+        , maxMemoryUsage(maxMemoryUsage)
+        , memoryUsage(0)
+        , directories()
+        , directoriesByPath()
+    {
+    }
 
-int SequenceFromFiles::getFirstFrame() const {
-    if (_imp->filesMap.empty()) {
-        return INT_MIN;
-    } else {
-        return _imp->filesMap.begin()->first;
+    void erase(Directories::iterator it)
+    {
+        memoryUsage -= it->memoryUsage;
+        directoriesByPath.erase(it->path);
+        directories.erase(it);
     }
-}
 
-int SequenceFromFiles::getLastFrame() const {
-    if (_imp->filesMap.empty()) {
-        return INT_MAX;
-    } else {
-        std::map<int,std::string>::const_iterator it = _imp->filesMap.end();
-        --it;
-        return it->first;
+    ///Returns the directory indexed for path, if it has the given stamp, and marks it as the most recently used.
+    ///A directory indexed with another stamp is removed.
+    Directories::iterator find(const std::string& path,unsigned long long device,unsigned long long inode,long long modificationTime)
+    {
+        std::unordered_map<std::string,Directories::iterator>::iterator found = directoriesByPath.find(path);
+        if (found == directoriesByPath.end()) {
+            return directories.end();
+        }
+        Directories::iterator it = found->second;
+        if (it->device != device || it->inode != inode || it->modificationTime != modificationTime) {
+            erase(it);
+            return directories.end();
+        }
+        directories.splice(directories.begin(), directories, it);
+        return it;
     }
-}
 
-const std::map<int,std::string>& SequenceFromFiles::getFrameIndexes() const {
-    return _imp->filesMap;
-}
+    ///Evicts the least recently used directories until the memory usage fits in maxMemoryUsage
+    void trim()
+    {
+        while (memoryUsage > maxMemoryUsage && !directories.empty()) {
+            erase(std::prev(directories.end()));
+        }
+    }
+};
 
-const StringList& SequenceFromFiles::getFilesList() const {
-    return _imp->filesList;
+static std::size_t filesMemoryUsage(const std::string& path,const std::vector<FileNameContent>& files)
+{
+    std::size_t ret = sizeof(SequenceIndexPrivate::Directory) + MAP_NODE_OVERHEAD + 2 * stringMemoryUsage(path);
+    ret += files.capacity() * sizeof(FileNameContent);
+    for (std::vector<FileNameContent>::const_iterator it = files.begin(); it != files.end(); ++it) {
+        ret += it->getMemoryUsage() - sizeof(FileNameContent);
+    }
+    return ret;
 }
 
-unsigned long long SequenceFromFiles::getEstimatedTotalSize() const {
-    return _imp->totalSize;
+SequenceIndex::SequenceIndex(std::size_t maxMemoryUsage)
+    : _imp(new SequenceIndexPrivate(maxMemoryUsage))
+{
 }
 
-std::string SequenceFromFiles::generateValidSequencePattern() const
-{
-    if (empty()) {
-        return "";
-    }
-    if (isSingleFile()) {
-        return _imp->sequence[0].absoluteFileName();
-    }
-    assert(_imp->filesMap.size() >= 2);
-    std::string firstFramePattern ;
-    _imp->sequence[0].generatePatternWithFrameNumberAtIndexes(_imp->frameNumberStringIndexes, &firstFramePattern);
-    return firstFramePattern;
+SequenceIndex::~SequenceIndex() {
+    ///uninstall this index if it is the installed one, once the calls using it are done
+    getInstalledSequenceIndex().uninstall(this);
+    delete _imp;
 }
 
-std::string SequenceFromFiles::generateUserFriendlySequencePattern() const {
-    if (isSingleFile()) {
-        return _imp->sequence[0].fileName();
+ScanStatus SequenceIndex::getSequenceOutOfFile(const std::string& absoluteFileName,SequenceFromFiles* sequence,
+                                               const ScanToken& token) {
+    FileNameContent firstFile(absoluteFileName);
+    const std::string path = firstFile.getPath();
+    unsigned long long device, inode;
+    long long modificationTime;
+    if (!getDirectoryStamp(path, &device, &inode, &modificationTime)) {
+        return scanSequenceOutOfFile(absoluteFileName, sequence, &token);
     }
-    std::string pattern = generateValidSequencePattern();
-    removePath(pattern);
-
-    std::vector< std::pair<int,int> > chunks;
-    int first = getFirstFrame();
-    while(first <= getLastFrame()){
 
-        int breakCounter = 0;
-        while (!(_imp->isInSequence(first)) && breakCounter < NATRON_DIALOG_MAX_SEQUENCES_HOLE) {
-            ++first;
-            ++breakCounter;
+    ///the result only depends on the file and the directory if the sequence starts empty
+    const bool rememberSequence = sequence->empty() && !sequence->isSizeEstimationEnabled();
+    const std::string fileName = firstFile.fileName();
+    std::shared_ptr<const std::vector<FileNameContent> > files;
+    bool sequenceFound = false;
+    {
+        std::lock_guard<std::mutex> lock(_imp->mutex);
+        SequenceIndexPrivate::Directories::iterator found = _imp->find(path, device, inode, modificationTime);
+        if (found != _imp->directories.end()) {
+            files = found->files;
+            std::unordered_map<std::string,SequenceFromFiles>::const_iterator foundSequence = found->sequences.find(fileName);
+            if (rememberSequence && foundSequence != found->sequences.end()) {
+                *sequence = foundSequence->second;
+                sequenceFound = true;
+            }
         }
+    }
+    if (sequenceFound) {
+        ScanProgressReporter::report(token, files->size(), sequence->count());
+        return SCAN_SUCCEEDED;
+    }
 
-        if (breakCounter >= NATRON_DIALOG_MAX_SEQUENCES_HOLE) {
-            break;
+    if (sequence->tryInsertFile(firstFile)) {
+        ScanProgressReporter::report(token, 0, 1);
+    }
+    std::size_t readFilesMemoryUsage = 0;
+    if (!files) {
+        FilesListingReader reader(&token);
+        if (!reader.open(path)) {
+            return SCAN_FAILED;
         }
-
-        chunks.push_back(std::make_pair(first, getLastFrame()));
-        int next = first + 1;
-        int prev = first;
-        int count = 1;
-        while((next <= getLastFrame())
-              && _imp->isInSequence(next)
-              && (next == prev + 1) ){
-            prev = next;
-            ++next;
-            ++count;
+        std::shared_ptr<std::vector<FileNameContent> > readFiles = std::make_shared<std::vector<FileNameContent> >();
+        std::string absoluteName;
+        StringList batch;
+        for (;;) {
+            if (token.isCancelled()) {
+                return SCAN_CANCELLED;
+            }
+            if (!reader.readBatch(&batch)) {
+                break;
+            }
+            for (StringList::iterator it = batch.begin(); it != batch.end(); ++it) {
+                absoluteName.assign(path).append(*it);
+                readFiles->push_back(FileNameContent(absoluteName));
+            }
+            ScanProgressReporter::report(token, batch.size(), 0);
+            batch.clear();
         }
-        --next;
-        chunks.back().second = next;
-        first += count;
+        readFilesMemoryUsage = filesMemoryUsage(path, *readFiles);
+        files = readFiles;
+    } else {
+        ScanProgressReporter::report(token, files->size(), 0);
     }
 
-    if (chunks.size() == 1) {
-        pattern += ' ';
-        pattern += stringFromInt(chunks[0].first);
-        pattern += '-';
-        pattern += stringFromInt(chunks[0].second);
-    } else {
-        pattern.append(" ( ");
-        for(unsigned int i = 0 ; i < chunks.size() ; ++i) {
-            if(chunks[i].first != chunks[i].second){
-                pattern += ' ';
-                pattern += stringFromInt(chunks[i].first);
-                pattern += '-';
-                pattern += stringFromInt(chunks[i].second);
-            }else{
-                pattern += ' ';
-                pattern += stringFromInt(chunks[i].first);
-            }
-            if(i < chunks.size() -1) pattern.append(" /");
+    std::size_t matchesCount = 0;
+    for (std::vector<FileNameContent>::const_iterator it = files->begin(); it != files->end(); ++it) {
+        if (sequence->tryInsertFile(*it)) {
+            ++matchesCount;
         }
-        pattern.append(" ) ");
     }
-    return pattern;
-}
+    ScanProgressReporter::report(token, 0, matchesCount);
 
-std::string SequenceFromFiles::fileExtension() const {
-    if (!empty()) {
-        return _imp->sequence[0].getExtension();
-    } else {
-        return "";
+    if ((long long)std::time(0) - modificationTime / 1000000000LL < SCAN_CACHE_MIN_AGE) {
+        return SCAN_SUCCEEDED;
+    }
+    const std::size_t sequenceMemoryUsage = rememberSequence ?
+            MAP_NODE_OVERHEAD + stringMemoryUsage(fileName) + sequence->getMemoryUsage() : 0;
+
+    std::lock_guard<std::mutex> lock(_imp->mutex);
+    SequenceIndexPrivate::Directories::iterator found = _imp->find(path, device, inode, modificationTime);
+    if (found == _imp->directories.end()) {
+        SequenceIndexPrivate::Directory directory;
+        directory.path = path;
+        directory.device = device;
+        directory.inode = inode;
+        directory.modificationTime = modificationTime;
+        directory.files = files;
+        ///the directory may have been evicted while its files were matched
+        directory.memoryUsage = readFilesMemoryUsage ? readFilesMemoryUsage : filesMemoryUsage(path, *files);
+        _imp->directories.push_front(directory);
+        found = _imp->directories.begin();
+        _imp->directoriesByPath[path] = found;
+        _imp->memoryUsage += directory.memoryUsage;
     }
+    if (rememberSequence && found->sequences.insert(std::make_pair(fileName, *sequence)).second) {
+        found->memoryUsage += sequenceMemoryUsage;
+        _imp->memoryUsage += sequenceMemoryUsage;
+    }
+    _imp->trim();
+    return SCAN_SUCCEEDED;
 }
 
-std::string SequenceFromFiles::getPath() const {
-    if (!empty()) {
-        return _imp->sequence[0].getPath();
-    } else {
-        return "";
-    }
+void SequenceIndex::clear() {
+    std::lock_guard<std::mutex> lock(_imp->mutex);
+    _imp->directoriesByPath.clear();
+    _imp->directories.clear();
+    _imp->memoryUsage = 0;
 }
 
-bool SequenceFromFiles::getSequenceOutOfFile(const std::string& absoluteFileName,SequenceFromFiles* sequence)
-{
-    FileNameContent firstFile(absoluteFileName);
-    sequence->tryInsertFile(firstFile);
+std::size_t SequenceIndex::getDirectoriesCount() const {
+    std::lock_guard<std::mutex> lock(_imp->mutex);
+    return _imp->directories.size();
+}
 
-    tinydir_dir dir;
-    if (tinydir_open(&dir, firstFile.getPath().c_str()) == -1) {
-        return false;
-    }
+std::size_t SequenceIndex::getMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(_imp->mutex);
+    return sizeof(SequenceIndex) + sizeof(SequenceIndexPrivate) + _imp->memoryUsage;
+}
 
-    StringList allFiles;
-    getFilesFromDir(dir, &allFiles);
-    tinydir_close(&dir);
+void setSequenceIndex(SequenceIndex* index) {
+    getInstalledSequenceIndex().install(index);
+}
 
-    for (StringList::iterator it = allFiles.begin(); it!=allFiles.end(); ++it) {
-        sequence->tryInsertFile(FileNameContent(firstFile.getPath() + *it));
-    }
-    return true;
+SequenceIndex* getSequenceIndex() {
+    return getInstalledSequenceIndex().get();
+}
+
+ScanCoordinatorStats getScanCoordinatorStats() {
+    return getScanCoordinator().getStats();
+}
+
+void resetScanCoordinatorStats() {
+    getScanCoordinator().resetStats();
 }
 
 } // namespace SequenceParsing
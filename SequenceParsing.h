@@ -42,16 +42,31 @@
 #include <map>
 #include <vector>
 #include <list>
+#include <functional>
+#include <future>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <cstddef>
 
 typedef std::vector<std::string> StringList ;
 namespace SequenceParsing {
 
 
+/**
+     * @brief A number of a filename, decoded once when the filename is parsed, @see FileNameContent::getDecodedNumberByIndex
+     **/
+struct FileNameNumber {
+    int value; //< the value of the number, saturated to INT_MAX
+    int digitsCount; //< the number of digits, leading zeroes included
+    bool hasLeadingZeroes; //< true if the number has more than 1 digit and starts with a 0, e.g: 0010
+};
+
 /**
      * @brief A class representing the content of a filename.
      * Initialize it passing it a real filename and it will initialize the data structures
      * depending on the filename content. This class is used by the file dialog to find sequences.
+     * The parsed content is never modified once built and is shared between copies: copying is O(1).
      **/
 struct FileNameContentPrivate;
 class FileNameContent {
@@ -62,10 +77,15 @@ public:
 
     FileNameContent(const FileNameContent& other);
 
+    ///other is left empty: it can only be assigned to or destroyed
+    FileNameContent(FileNameContent&& other) noexcept;
+
     ~FileNameContent();
 
     void operator=(const FileNameContent& other);
 
+    void operator=(FileNameContent&& other) noexcept;
+
     /**
          * @brief Returns all the text parts that compose that file name.
          * eg: for blabla5.tif it would return "blabla"  ".tif"
@@ -75,12 +95,23 @@ public:
     /**
          * @brief Returns the file path, e.g: /Users/Lala/Pictures/ with the trailing separator.
          **/
-    const std::string& getPath() const;
+    std::string getPath() const;
+
+    /**
+         * @brief Same as getPath() but returns a view of the absolute filename instead of a copy.
+         * The view is valid as long as this object is alive and not assigned to.
+         **/
+    std::string_view getPathView() const;
 
     /**
          * @brief Returns the filename without its path.
          **/
-    const std::string& fileName() const;
+    std::string fileName() const;
+
+    /**
+         * @brief Same as fileName() but returns a view of the absolute filename instead of a copy.
+         **/
+    std::string_view fileNameView() const;
 
     /**
          * @brief Returns the absolute filename as it was given in the constructor arguments.
@@ -90,7 +121,12 @@ public:
     /**
          * @brief Returns the file extension
          **/
-    const std::string& getExtension() const;
+    std::string getExtension() const;
+
+    /**
+         * @brief Same as getExtension() but returns a view of the absolute filename instead of a copy.
+         **/
+    std::string_view getExtensionView() const;
 
     /**
          * @brief Returns true if a single number was found in the filename.
@@ -113,7 +149,7 @@ public:
          * no clue given just this filename what actually corresponds to the frame number.
          * Nb: this pattern is not an absolute path.
          **/
-    const std::string& getFilePattern() const;
+    std::string getFilePattern() const;
 
     /**
          * @brief Expands the string returned by getFilePattern to a valid pattern.
@@ -133,6 +169,16 @@ public:
          **/
     bool getNumberByIndex(int index,std::string* numberString) const;
 
+    /**
+         * @brief Same as getNumberByIndex but numberString is set to a view of the absolute filename.
+         **/
+    bool getNumberViewByIndex(int index,std::string_view* numberString) const;
+
+    /**
+         * @brief Same as getNumberByIndex but returns the number as it was decoded when the filename was parsed.
+         **/
+    bool getDecodedNumberByIndex(int index,FileNameNumber* number) const;
+
 
     /**
          * @brief Given the pattern of this file, it tries to match the other file name to this
@@ -147,10 +193,15 @@ public:
          **/
     bool matchesPattern(const FileNameContent& other,std::vector<int>* numberIndexesToVary) const;
 
+    /**
+         * @brief Returns an estimation of the memory used by this object, in bytes.
+         **/
+    std::size_t getMemoryUsage() const;
+
 
 private:
 
-    FileNameContentPrivate* _imp;
+    std::shared_ptr<const FileNameContentPrivate> _imp;
 
 };
 
@@ -162,6 +213,113 @@ private:
      **/
 std::string removePath(std::string& filename);
 
+/**
+     * @brief A variable found in a pattern, e.g: ###, %04d, %d, %v or %V.
+     * @see filesListFromPattern for the meaning of each variable.
+     **/
+struct PatternVariable {
+
+    enum Type {
+        FRAME_NUMBER_HASHES = 0, //< ### : a frame number with at least as many digits as hashes
+        FRAME_NUMBER_PADDED, //< %0<N>d : a frame number with at least N digits
+        FRAME_NUMBER, //< %d : any frame number
+        SHORT_VIEW, //< %v : 'l', 'r' or 'view<N>'
+        LONG_VIEW, //< %V : 'left', 'right' or 'view<N>'
+        UNSUPPORTED //< a printf-like token that is not understood, e.g: %0v
+    };
+
+    ///the variable as it was written in the pattern, e.g: %04d
+    std::string token;
+
+    Type type;
+
+    ///for FRAME_NUMBER_HASHES and FRAME_NUMBER_PADDED: the minimum number of digits. 0 otherwise.
+    int digitsCount;
+
+    ///how many characters belonging to common parts were found in the pattern before this variable.
+    int commonCharactersBefore;
+
+    ///the offset of the token in the pattern string
+    int position;
+
+    PatternVariable()
+        : token()
+        , type(UNSUPPORTED)
+        , digitsCount(0)
+        , commonCharactersBefore(0)
+        , position(0)
+    {}
+};
+
+typedef std::vector<PatternVariable> PatternVariables;
+
+/**
+     * @brief A pattern (@see filesListFromPattern) that has been parsed once and for all.
+     * Parsing a pattern is not free: build a CompiledPattern once and pass it to filesListFromPattern
+     * or generateFileNameFromPattern when the same pattern is used many times (e.g: once per frame).
+     **/
+struct CompiledPatternPrivate;
+class CompiledPattern {
+
+public:
+
+    explicit CompiledPattern(const std::string& pattern);
+
+    CompiledPattern(const CompiledPattern& other);
+
+    ~CompiledPattern();
+
+    void operator=(const CompiledPattern& other);
+
+    /**
+         * @brief Returns false if the pattern is empty or if it contains variables that are not
+         * supported (e.g: nested printf-like variables).
+         **/
+    bool isValid() const;
+
+    /**
+         * @brief Returns the pattern as it was given in the constructor arguments.
+         **/
+    const std::string& getPattern() const;
+
+    /**
+         * @brief Returns the pattern path, e.g: /Users/Lala/Pictures/ with the trailing separator.
+         **/
+    const std::string& getPath() const;
+
+    /**
+         * @brief Returns the pattern extension without the dot, e.g: "jpg"
+         **/
+    const std::string& getExtension() const;
+
+    /**
+         * @brief Returns the parts of the file name that do not vary, ordered from left to right.
+         * The extension (with its dot) is the last common part.
+         * For example: /Users/Lala/file%04dname###.jpg would return "file","name",".jpg"
+         **/
+    const StringList& getCommonParts() const;
+
+    /**
+         * @brief Returns the variables of the pattern ordered from left to right.
+         * For example: /Users/Lala/file%04dname###.jpg would return "%04d", "###"
+         **/
+    const PatternVariables& getVariables() const;
+
+    /**
+         * @brief Returns true if the given filename (without its path) matches the pattern.
+         * The filename is scanned a single time and no memory is allocated.
+         * @param frameNumber [out] The frame number found in the filename, 0 if the pattern has no frame number variable.
+         * @param viewNumber [out] The view index found in the filename, -1 if the pattern has no view variable.
+         **/
+    bool matches(const std::string& filename,int* frameNumber,int* viewNumber) const;
+
+    bool matches(const char* filename,std::size_t length,int* frameNumber,int* viewNumber) const;
+
+private:
+
+    CompiledPatternPrivate* _imp;
+};
+
 
 ///map: < time, map < view_index, file name > >
 ///Explanation: for each frame number, there may be multiple views, each mapped to a filename.
@@ -200,6 +358,136 @@ typedef std::map<int,std::map<int,std::string> > SequenceFromPattern;
      **/
 bool filesListFromPattern(const std::string& pattern,SequenceParsing::SequenceFromPattern* sequence);
 
+/**
+     * @brief Same as above except that the pattern has already been parsed.
+     **/
+bool filesListFromPattern(const CompiledPattern& pattern,SequenceParsing::SequenceFromPattern* sequence);
+
+/**
+     * @brief Receives the files matching a pattern as soon as they are found by visitFilesFromPattern.
+     **/
+class PatternFilesVisitor {
+public:
+
+    virtual ~PatternFilesVisitor() {}
+
+    /**
+         * @brief Called for each file of the pattern directory that matches the pattern, in the order
+         * of the directory entries (i.e: not sorted by frame number).
+         * @param viewNumber The view index of the file, -1 if the pattern has no view variable.
+         * @returns False to stop the visit, e.g: once a given frame was found.
+         **/
+    virtual bool visitFile(int frameNumber,int viewNumber,const std::string& absoluteFileName) = 0;
+};
+
+/**
+     * @brief Same as filesListFromPattern except that the files are given to visitor as the directory is read,
+     * batch by batch, instead of being gathered in a sequence once the whole directory has been read.
+     * Only one batch of directory entries is held in memory at a time, whatever the size of the directory, plus at
+     * most a few batches while the listing is shared with concurrent scans (see ScanCoordinatorStats).
+     * @returns False if the pattern is not valid or its directory couldn't be opened, true otherwise, even if
+     * the visitor stopped the visit.
+     **/
+bool visitFilesFromPattern(const std::string& pattern,PatternFilesVisitor* visitor);
+
+/**
+     * @brief Same as above except that the pattern has already been parsed.
+     **/
+bool visitFilesFromPattern(const CompiledPattern& pattern,PatternFilesVisitor* visitor);
+
+/**
+     * @brief How an asynchronous scan ended.
+     **/
+enum ScanStatus {
+    SCAN_SUCCEEDED = 0,
+    SCAN_FAILED, //< the synchronous version would have returned false, e.g: the directory couldn't be opened
+    SCAN_CANCELLED //< ScanToken::cancel() was called before the scan completed, the result is partial
+};
+
+/**
+     * @brief Lets the caller of an asynchronous scan cancel it and follow its progress.
+     * Copies share the same state, so the caller keeps a copy of the token given to the scan.
+     * Cancellation is cooperative: the scan checks the token after each batch of directory entries, so
+     * a superseded scan stops doing I/O and using CPU within one batch.
+     **/
+struct ScanTokenPrivate;
+class ScanProgressReporter;
+class ScanToken {
+public:
+
+    typedef std::function<void (std::size_t entriesScanned,std::size_t matchesFound)> ProgressCallback;
+
+    ScanToken();
+
+    ~ScanToken();
+
+    ///Asks the scans using this token to stop. It can be called from any thread.
+    void cancel();
+
+    bool isCancelled() const;
+
+    ///The number of directory entries read so far by the scans using this token
+    std::size_t getEntriesScanned() const;
+
+    ///The number of files matching the scanned pattern or sequence found so far
+    std::size_t getMatchesFound() const;
+
+    /**
+         * @brief The callback is called by the thread running the scan after each batch of directory entries,
+         * with the totals so far. It must be set before the scan starts.
+         **/
+    void setProgressCallback(const ProgressCallback& callback);
+
+private:
+
+    friend class ScanProgressReporter;
+
+    ///Called by the scans after each batch: adds to the totals and calls the progress callback.
+    void reportProgress(std::size_t entriesScanned,std::size_t matchesFound) const;
+
+    std::shared_ptr<ScanTokenPrivate> _imp;
+};
+
+/**
+     * @brief Runs a task of an asynchronous scan, e.g: by posting it to the thread pool of the application.
+     * An empty executor queues the task to an internal pool of at most 8 threads. When the program exits,
+     * the tasks of that pool that are not started yet are dropped, and the running ones are waited for.
+     **/
+typedef std::function<void (const std::function<void ()>& task)> ScanExecutor;
+
+struct PatternScanResult {
+    ScanStatus status;
+    SequenceParsing::SequenceFromPattern sequence;
+};
+
+/**
+     * @brief Same as filesListFromPattern but the directory is read and matched by a task run by executor.
+     * The returned future becomes ready once the scan completed, failed or was cancelled.
+     **/
+std::future<PatternScanResult> filesListFromPatternAsync(const CompiledPattern& pattern,const ScanToken& token = ScanToken(),
+                                                         const ScanExecutor& executor = ScanExecutor());
+
+/**
+     * @brief Same as filesListFromPattern for many patterns at once. The patterns are grouped by directory so that
+     * each directory is listed once, and the directories are listed and matched against their patterns in parallel.
+     * The files of a directory are matched against all its patterns in a single scan of their names, so many patterns
+     * sharing a directory cost about as much as one.
+     * @param sequences [out] Resized to the number of patterns: sequences[i] is the sequence of patterns[i].
+     * @param threadsCount The number of threads listing the directories and matching the files, the calling
+     * thread included. 0 for one thread per core. When the file system is slow to answer (e.g: network shares)
+     * more threads than cores help as most of the time is spent waiting for it.
+     * @returns The number of patterns for which filesListFromPattern would have returned false, i.e: invalid
+     * patterns and patterns whose directory couldn't be opened. Their sequence is left empty.
+     **/
+int filesListFromPatterns(const StringList& patterns,std::vector<SequenceParsing::SequenceFromPattern>* sequences,
+                          unsigned int threadsCount = 0);
+
+/**
+     * @brief Same as above except that the patterns have already been parsed.
+     **/
+int filesListFromPatterns(const std::vector<CompiledPattern>& patterns,std::vector<SequenceParsing::SequenceFromPattern>* sequences,
+                          unsigned int threadsCount = 0);
+
 /**
      * @brief Transforms a sequence parsed from a pattern to a absolute file names list. If
      * onlyViewIndex is greater or equal to 0 it will append to the string list only file names
@@ -209,18 +497,433 @@ bool filesListFromPattern(const std::string& pattern,SequenceParsing::SequenceFr
 StringList sequenceFromPatternToFilesList(const SequenceParsing::SequenceFromPattern& sequence,
                                           int onlyViewIndex = -1);
 
+/**
+     * @brief A compact alternative to SequenceFromPattern: the files are sorted by frame number and view index
+     * in a single array and their names (without path) are stored back to back in a single buffer, the path
+     * being stored once.
+     * It can be iterated like a SequenceFromPattern: it->first is the frame number and it->second the views of
+     * that frame, which can be iterated as well: it2->first is the view index and it2->second the absolute file name.
+     * The absolute file name is built when it is accessed, use getFileName() to read the name stored in the buffer.
+     **/
+class FlatSequenceFromPattern
+{
+public:
+
+    struct File
+    {
+        int frame;
+        int view;
+        unsigned int nameOffset; //< the offset of the name in the names buffer
+        unsigned int nameLength;
+    };
+
+    ///A view of a frame, like the std::pair<const int,std::string> of SequenceFromPattern
+    struct ViewEntry
+    {
+        int first; //< the view index
+        std::string second; //< the absolute file name
+    };
+
+    class ViewIterator
+    {
+    public:
+
+        ViewIterator();
+
+        ViewIterator(const FlatSequenceFromPattern* sequence,std::size_t index);
+
+        const ViewEntry& operator*() const;
+
+        const ViewEntry* operator->() const;
+
+        ViewIterator& operator++();
+
+        ViewIterator operator++(int);
+
+        bool operator==(const ViewIterator& other) const { return _index == other._index; }
+
+        bool operator!=(const ViewIterator& other) const { return _index != other._index; }
+
+        ///the file the iterator points to, without building its absolute file name
+        const File& getFile() const;
+
+    private:
+
+        const FlatSequenceFromPattern* _sequence;
+        std::size_t _index;
+        mutable ViewEntry _entry;
+        mutable bool _entryValid;
+    };
+
+    ///The views of a frame, like the std::map<int,std::string> of SequenceFromPattern
+    class ViewsRange
+    {
+    public:
+
+        typedef ViewIterator const_iterator;
+
+        ViewsRange();
+
+        ViewsRange(const FlatSequenceFromPattern* sequence,std::size_t first,std::size_t last);
+
+        const_iterator begin() const;
+
+        const_iterator end() const;
+
+        const_iterator find(int view) const;
+
+        std::size_t size() const { return _last - _first; }
+
+        bool empty() const { return _first == _last; }
+
+    private:
+
+        const FlatSequenceFromPattern* _sequence;
+        std::size_t _first;
+        std::size_t _last;
+    };
+
+    ///A frame, like the std::pair<const int,std::map<int,std::string> > of SequenceFromPattern
+    struct FrameEntry
+    {
+        int first; //< the frame number
+        ViewsRange second;
+    };
+
+    class FrameIterator
+    {
+    public:
+
+        FrameIterator();
+
+        ///index is the index of the first file of the frame
+        FrameIterator(const FlatSequenceFromPattern* sequence,std::size_t index);
+
+        const FrameEntry& operator*() const { return _entry; }
+
+        const FrameEntry* operator->() const { return &_entry; }
+
+        FrameIterator& operator++();
+
+        FrameIterator operator++(int);
+
+        FrameIterator& operator--();
+
+        FrameIterator operator--(int);
+
+        bool operator==(const FrameIterator& other) const { return _index == other._index; }
+
+        bool operator!=(const FrameIterator& other) const { return _index != other._index; }
+
+    private:
+
+        void updateEntry();
+
+        const FlatSequenceFromPattern* _sequence;
+        std::size_t _index;
+        FrameEntry _entry;
+    };
+
+    typedef int key_type;
+    typedef ViewsRange mapped_type;
+    typedef FrameEntry value_type;
+    typedef FrameIterator const_iterator;
+    typedef FrameIterator iterator;
+
+    FlatSequenceFromPattern();
+
+    ///Removes all the files and sets the directory of the files to come, with a trailing separator.
+    void reset(const std::string& path);
+
+    ///Adds a file, name being the file name without path. sortFiles() must be called once all the files are added.
+    void addFile(int frameNumber,int viewNumber,const char* name,std::size_t length);
+
+    ///Sorts the files by frame number and view index. Returns false if several files had the same
+    ///frame number and view index: only the first one added is kept.
+    bool sortFiles();
+
+    const std::string& getPath() const { return _path; }
+
+    const_iterator begin() const;
+
+    const_iterator end() const;
+
+    ///Returns the frame, or end() if there is no file for that frame. This is a binary search.
+    const_iterator find(int frameNumber) const;
+
+    ///the number of frames
+    std::size_t size() const { return _framesCount; }
+
+    bool empty() const { return _files.empty(); }
+
+    ///all the files, sorted by frame number and view index
+    const std::vector<File>& getFiles() const { return _files; }
+
+    ///Returns the name without path of the file, stored in the names buffer
+    const char* getFileName(const File& file) const { return _names.c_str() + file.nameOffset; }
+
+    std::string getAbsoluteFileName(const File& file) const;
+
+private:
+
+    std::string _path;
+    std::vector<File> _files;
+    ///the names of the files, each followed by a '\0'
+    std::string _names;
+    std::size_t _framesCount;
+};
+
+/**
+     * @brief Same as filesListFromPattern but it fills a FlatSequenceFromPattern, which is reset first.
+     **/
+bool filesListFromPattern(const std::string& pattern,SequenceParsing::FlatSequenceFromPattern* sequence);
+bool filesListFromPattern(const CompiledPattern& pattern,SequenceParsing::FlatSequenceFromPattern* sequence);
+
+/**
+     * @brief Same as sequenceFromPatternToFilesList but for a FlatSequenceFromPattern.
+     **/
+StringList sequenceFromPatternToFilesList(const SequenceParsing::FlatSequenceFromPattern& sequence,
+                                          int onlyViewIndex = -1);
+
 /**
      * @brief Generates a filename out of a pattern
      * @see filesListFromPattern
      **/
 std::string generateFileNameFromPattern(const std::string& pattern,int frameNumber,int viewNumber);
 
+/**
+     * @brief Same as above except that the pattern has already been parsed.
+     **/
+std::string generateFileNameFromPattern(const CompiledPattern& pattern,int frameNumber,int viewNumber);
+
+/**
+     * @brief Generates file names out of a pattern, like generateFileNameFromPattern does, but
+     * optimized for consecutive frames: when asked for the frame following the previous one (with the same view)
+     * only the digits of the frame number variables that changed are rewritten, like an odometer.
+     * The whole name is rebuilt only when jumping to another frame or view, or when the frame number gets an extra digit.
+     **/
+struct FileNameGeneratorPrivate;
+class FileNameGenerator {
+
+public:
+
+    explicit FileNameGenerator(const CompiledPattern& pattern);
+
+    FileNameGenerator(const FileNameGenerator& other);
+
+    ~FileNameGenerator();
+
+    void operator=(const FileNameGenerator& other);
+
+    /**
+         * @brief Returns the file name for the given frame and view.
+         * The returned reference is valid until the next call to a non-const member of this object.
+         **/
+    const std::string& fileName(int frameNumber,int viewNumber);
+
+    /**
+         * @brief Returns the file name of the frame following the last generated one, with the same view.
+         * If no file name was generated yet, this returns the file name of frame 0 and view 0.
+         * Once the frame INT_MAX is reached, this keeps returning its file name.
+         **/
+    const std::string& next();
+
+    ///the frame number of the last generated file name
+    int currentFrame() const;
+
+    ///the view number of the last generated file name
+    int currentView() const;
+
+    /**
+         * @brief Generates the file names of all frames in [firstFrame,lastFrame] for each of the given views
+         * into a single contiguous buffer. File names are ordered by frame then by view and each of them is
+         * terminated by a '\0' character, so that buffer->c_str() + (*offsets)[i] is the i-th file name.
+         * If views is empty, view 0 is used.
+         * The content of buffer and offsets is replaced.
+         **/
+    void generateRange(int firstFrame,int lastFrame,const std::vector<int>& views,
+                       std::string* buffer,std::vector<std::size_t>* offsets) const;
+
+private:
+
+    FileNameGeneratorPrivate* _imp;
+};
+
+/**
+     * @brief A range of frames: first, first + stride, first + 2 * stride, ..., last.
+     **/
+struct FrameRange {
+    int first;
+    int last;
+    int stride;
+};
+
+/**
+     * @brief How filesListFromPattern finds the files of a pattern whose frames are known in advance.
+     **/
+enum PatternScanStrategy {
+    PATTERN_SCAN_AUTOMATIC = 0, //< the strategy is chosen by comparing their estimated costs
+    PATTERN_SCAN_LIST_DIRECTORY, //< the directory is listed and the names of its files matched against the pattern
+    PATTERN_SCAN_PROBE_FILES //< the name of each expected file is generated and checked with a stat
+};
+
+/**
+     * @brief The files expected for a pattern, e.g: the frames of a shot given by an edit decision list.
+     **/
+struct ExpectedPatternFiles {
+
+    ///the expected frames. A stride lower than 1 counts as 1.
+    FrameRange frames;
+
+    ///the expected views, ignored if the pattern has no view variable. If empty, only view 0 is expected.
+    std::vector<int> views;
+
+    ///How many directory entries can be listed for the cost of checking whether a single file exists.
+    ///The directory is listed only if it is estimated to have fewer entries than the number of expected
+    ///files times this cost. Raise it for network file systems with high latencies.
+    double probeCost;
+
+    ///PATTERN_SCAN_AUTOMATIC to let the cost model choose, or the strategy to use whatever its cost. Still, the directory
+    ///is listed rather than probed if 64 times more files are expected than it is estimated to have entries.
+    PatternScanStrategy strategy;
+
+    ExpectedPatternFiles()
+        : frames()
+        , views()
+        , probeCost(8)
+        , strategy(PATTERN_SCAN_AUTOMATIC)
+    {
+        frames.first = 0;
+        frames.last = -1;
+        frames.stride = 1;
+    }
+};
+
+/**
+     * @brief What filesListFromPattern did to find the expected files, so that ExpectedPatternFiles::probeCost can be tuned.
+     **/
+struct PatternScanReport {
+
+    ///PATTERN_SCAN_LIST_DIRECTORY or PATTERN_SCAN_PROBE_FILES
+    PatternScanStrategy strategy;
+
+    ///the number of expected files, i.e: of frames times views
+    unsigned long long expectedFilesCount;
+
+    ///The estimated number of entries of the directory, -1 if it couldn't be estimated.
+    ///It is exact if the listing of the directory is in the installed ScanCache, otherwise it is derived from
+    ///the size of the directory and only known for the ext2, ext3 and ext4 file systems on Linux.
+    long long estimatedEntriesCount;
+
+    PatternScanReport()
+        : strategy(PATTERN_SCAN_AUTOMATIC)
+        , expectedFilesCount(0)
+        , estimatedEntriesCount(-1)
+    {
+    }
+};
+
+/**
+     * @brief Same as filesListFromPattern but only the expected files are returned, whatever other files match the pattern.
+     * The files are found either by listing the directory, or by checking the existence of each expected file
+     * (whose name is given by generateFileNameFromPattern) when there are much fewer of them than directory entries.
+     * Probing only finds files named exactly as generateFileNameFromPattern names them, e.g: %d only finds frames
+     * without padding and %V only finds views spelt in lower case. Hence PATTERN_SCAN_AUTOMATIC only probes the patterns
+     * whose frame number is given by hashes or %0Nd and that have no view variable, for which both strategies find the
+     * same files as long as no file has characters that the pattern doesn't have next to its frame number (e.g: the
+     * pattern file.####.exr matches file.0012b.exr, which only listing finds).
+     * When the number of entries of the directory cannot be estimated (see PatternScanReport::estimatedEntriesCount),
+     * it is listed. The expected files are probed by batches, so probing many frames doesn't use more memory.
+     * @param report [out] If not null, receives the strategy used and the figures it was chosen from.
+     * @returns False if the pattern is not valid or its directory couldn't be opened.
+     **/
+bool filesListFromPattern(const std::string& pattern,const ExpectedPatternFiles& expectedFiles,
+                          SequenceParsing::SequenceFromPattern* sequence,PatternScanReport* report = 0);
+
+/**
+     * @brief Same as above except that the pattern has already been parsed.
+     **/
+bool filesListFromPattern(const CompiledPattern& pattern,const ExpectedPatternFiles& expectedFiles,
+                          SequenceParsing::SequenceFromPattern* sequence,PatternScanReport* report = 0);
+
+/**
+     * @brief The estimated cumulated size of the files of a sequence, @see SequenceFromFiles::getSampledSizeEstimation
+     **/
+struct SizeEstimation {
+
+    ///the estimated total size in bytes
+    unsigned long long totalSize;
+
+    ///the bounds of the 95% confidence interval of totalSize. Both equal totalSize if exact is true.
+    unsigned long long lowerBound;
+    unsigned long long upperBound;
+
+    ///the number of files whose size has actually been read to compute the estimation
+    int sampledFilesCount;
+
+    ///true if all the files have been stat'ed
+    bool exact;
+
+    SizeEstimation()
+        : totalSize(0)
+        , lowerBound(0)
+        , upperBound(0)
+        , sampledFilesCount(0)
+        , exact(true)
+    {
+    }
+};
+
+/**
+     * @brief Options of SequenceFromFiles::getSequencesOutOfDirectoryTree
+     **/
+struct DirectoryTreeOptions {
+
+    enum SymlinkPolicy {
+        SKIP_SYMLINKS = 0, //< symbolic links are ignored
+        LIST_SYMLINKS, //< links to files are listed like files, links to directories are not entered
+        FOLLOW_SYMLINKS //< links to files are listed and links to directories are entered, each directory is scanned once
+    };
+
+    ///the maximum depth of the scanned directories, the root being at depth 0. -1 for no limit
+    int maxDepth;
+
+    ///If not empty, only the files whose name matches one of these globs are grouped in sequences.
+    ///Globs are matched against names without path, * matches any number of characters and ? a single one.
+    StringList includeGlobs;
+
+    ///the files and directories whose name matches one of these globs are skipped
+    StringList excludeGlobs;
+
+    ///How symbolic links are handled. On platforms other than Linux links cannot be told apart and are seen as their target:
+    ///set maxDepth if the tree may contain loops.
+    SymlinkPolicy symlinkPolicy;
+
+    ///the number of threads scanning the tree, the calling thread included. 0 for one thread per core
+    unsigned int threadsCount;
+
+    bool enableSizeEstimation;
+
+    DirectoryTreeOptions()
+        : maxDepth(-1)
+        , includeGlobs()
+        , excludeGlobs()
+        , symlinkPolicy(LIST_SYMLINKS)
+        , threadsCount(0)
+        , enableSizeEstimation(false)
+    {
+    }
+};
+
 /**
      * @struct Used to gather file together that seem to belong to the same sequence.
      * This is used for example in the sequence dialog. It aims to produce a pattern
      * out of a series of file.
+     * Copies share their internals until one of them is modified (copy-on-write): copying is O(1),
+     * and copies can be handed to other threads while the original keeps being filled.
      **/
 struct SequenceFromFilesPrivate;
+struct SequenceFromFilesScanResult;
 class SequenceFromFiles {
 
 
@@ -237,6 +940,9 @@ public:
 
     SequenceFromFiles(const SequenceFromFiles& other);
 
+    ///other is left empty: it can only be assigned to or destroyed
+    SequenceFromFiles(SequenceFromFiles&& other) noexcept;
+
     ~SequenceFromFiles();
 
     /**
@@ -248,13 +954,53 @@ public:
          **/
     static bool getSequenceOutOfFile(const std::string& absoluteFileName,SequenceFromFiles* sequence);
 
-    void operator=(const SequenceFromFiles& other) const;
+    /**
+         * @brief Same as getSequenceOutOfFile but the directory is read by a task run by executor,
+         * @see filesListFromPatternAsync
+         **/
+    static std::future<SequenceFromFilesScanResult> getSequenceOutOfFileAsync(const std::string& absoluteFileName,
+                                                                              const ScanToken& token = ScanToken(),
+                                                                              const ScanExecutor& executor = ScanExecutor());
+
+    /**
+         * @brief Groups all the files of the given directory in sequences in a single pass.
+         * Files that do not belong to any sequence are returned as single file sequences.
+         * This is much faster than calling getSequenceOutOfFile for each file of the directory.
+         * @param sequences[out] The sequences found, ordered by the name of their first file.
+         * @returns False if the directory couldn't be opened.
+         **/
+    static bool getSequencesOutOfDirectory(const std::string& directory,std::vector<SequenceFromFiles>* sequences,
+                                           bool enableSizeEstimation = false);
+
+    /**
+         * @brief Same as getSequencesOutOfDirectory but for a list of absolute file names that has already been listed.
+         * The files may belong to different directories, a sequence never spans several directories.
+         * Files are first bucketed by their path, their text parts and the layout of their numbers so
+         * that only files that could possibly belong to the same sequence are compared:
+         * the cost is O(N log N) instead of O(N^2).
+         **/
+    static void getSequencesOutOfFiles(const StringList& absoluteFileNames,std::vector<SequenceFromFiles>* sequences,
+                                       bool enableSizeEstimation = false);
+
+    /**
+         * @brief Same as getSequencesOutOfDirectory for root and all the directories below it.
+         * The directories are listed and their files grouped by a pool of threads: each thread
+         * scans the sub-directories it found first and steals directories from the other threads when it runs out of work.
+         * @param sequences[out] The sequences found, ordered by directory and then by the name of their first file.
+         * @returns False if root couldn't be opened. Sub-directories that cannot be opened are skipped.
+         **/
+    static bool getSequencesOutOfDirectoryTree(const std::string& root,const DirectoryTreeOptions& options,
+                                               std::vector<SequenceFromFiles>* sequences);
+
+    void operator=(const SequenceFromFiles& other);
+
+    void operator=(SequenceFromFiles&& other) noexcept;
 
     ///Tries to insert a file in the sequence and returns true if it succeeded,
     ///indicating that the file matches the sequence or it is already contained in this sequence.
     bool tryInsertFile(const FileNameContent& file);
 
-    ///Returns true if this sequence contains the given file.
+    ///Returns true if this sequence contains the given file. This is a constant time lookup.
     bool contains(const std::string& absoluteFileName) const;
 
     ///is the sequence empty ?
@@ -279,14 +1025,62 @@ public:
     int getLastFrame() const;
 
     ///all the frame indexes. Empty if this is not a sequence.
+    ///The frames are stored as ranges: the map is built on demand and is invalidated by tryInsertFile.
+    ///For big sequences, prefer getFrameRanges() and getFileNameForFrame().
     const std::map<int,std::string>& getFrameIndexes() const;
 
+    ///all the files of the sequence ordered by frame number, followed by the files whose frame number
+    ///is shared with another file of the sequence (e.g: file.5.exr and file.0005.exr).
+    ///Like getFrameIndexes(), the list is built on demand and is invalidated by tryInsertFile.
     const StringList& getFilesList() const;
 
+    ///Returns the frames of the sequence as ordered ranges. This is as compact as the sequence is regular.
+    std::vector<FrameRange> getFrameRanges() const;
+
+    ///Returns true if the sequence has a file for the given frame, in O(log(ranges)).
+    bool containsFrame(int frame) const;
+
+    ///Returns the number of frames of the sequence in [first,last].
+    int getFramesCount(int first,int last) const;
+
+    ///Returns in absoluteFileName the file of the given frame. Returns false if there is no file for that frame.
+    bool getFileNameForFrame(int frame,std::string* absoluteFileName) const;
+
     ///Returns the total cumulated size of all files in the sequence.
     ///If enableSizeEstimation is false, it will return 0.
+    ///The sizes are not computed while files are inserted: the files inserted since the last call are
+    ///stat'ed all at once by a pool of threads when this function is called.
     unsigned long long getEstimatedTotalSize() const;
 
+    ///Returns the enableSizeEstimation flag the sequence was created with.
+    bool isSizeEstimationEnabled() const;
+
+    /**
+         * @brief Estimates the cumulated size of the files of the sequence by reading the size of a sample of them only,
+         * so the cost depends on sampleSize and not on the number of files.
+         * The sample is stratified: the files are split in sampleSize / 2 contiguous strata and 2 files are
+         * randomly chosen in each stratum, so that a sequence whose frames grow in size over time is still
+         * well estimated. The result is exact if the sequence has no more than sampleSize files or once
+         * the exact size computed by computeExactTotalSizeInBackground() is available.
+         * This works whether enableSizeEstimation is true or not.
+         **/
+    SizeEstimation getSampledSizeEstimation(int sampleSize = 256) const;
+
+    /**
+         * @brief Starts computing the exact cumulated size of the files of the sequence in a background thread.
+         * Once it is done, getSampledSizeEstimation() returns it instead of an estimation.
+         * This does nothing if a computation for the current files is already started.
+         * Nothing ever waits for the computation: it is cancelled once the sequence and all its copies are destroyed,
+         * or once they all started another computation because files were inserted.
+         **/
+    void computeExactTotalSizeInBackground() const;
+
+    ///Returns true if the exact size computed in the background is available for all the files of the sequence.
+    bool isExactTotalSizeAvailable() const;
+
+    ///Returns an estimation of the memory used by this sequence, in bytes.
+    std::size_t getMemoryUsage() const;
+
     ///Generates a pattern from this sequence.
     ///Normally calling filesListFromPattern on the result of this function
     ///should find the exact same files as getFilesList() would return.
@@ -300,9 +1094,239 @@ public:
 
 private:
 
-    SequenceFromFilesPrivate* _imp;
+    ///Gives this sequence its own copy of the internals if they are shared with other sequences
+    void detach();
+
+    std::shared_ptr<SequenceFromFilesPrivate> _imp;
+};
+
+struct SequenceFromFilesScanResult {
+    ScanStatus status;
+    SequenceFromFiles sequence;
+};
+
+/**
+     * @brief A file added to or removed from the sequence of a PatternWatcher.
+     **/
+struct SequenceChange {
+
+    enum Type {
+        FILE_ADDED = 0,
+        FILE_REMOVED
+    };
+
+    Type type;
+    int frameNumber;
+    int viewNumber; //< -1 if the pattern has no view variable
+    std::string absoluteFileName;
+};
+
+/**
+     * @brief Keeps the sequence of a pattern up to date while files are written to, moved in or deleted from
+     * its directory, e.g: by a render farm.
+     * The directory is scanned once by start(). Then on Linux, inotify reports the files whose writing is complete,
+     * the links (hard or symbolic) and special files created, the files moved in or out and the deleted files,
+     * so that poll() only looks at the files that changed, whatever the size of the directory.
+     * On other platforms poll() rescans the directory.
+     **/
+struct PatternWatcherPrivate;
+class PatternWatcher {
+public:
+
+    typedef std::function<void (const std::vector<SequenceChange>& changes)> ChangesCallback;
+
+    explicit PatternWatcher(const CompiledPattern& pattern);
+
+    ///Watches the files of sequence, through the pattern returned by its generateValidSequencePattern()
+    explicit PatternWatcher(const SequenceFromFiles& sequence);
+
+    ~PatternWatcher();
+
+    /**
+         * @brief Starts watching the directory and scans it. Returns false if the pattern is not valid or
+         * its directory couldn't be opened.
+         **/
+    bool start();
+
+    ///Stops watching the directory, getSequence() is left as it was.
+    void stop();
+
+    ///Called by poll() with the changes it applied, if there are any.
+    void setChangesCallback(const ChangesCallback& callback);
+
+    /**
+         * @brief Once a change has been seen, poll() keeps reading the changes for this delay so that a burst of changes,
+         * e.g: the files of the views of a frame, is applied as a single batch. 50 ms by default.
+         **/
+    void setCoalescingDelay(int milliseconds);
+
+    /**
+         * @brief Waits up to timeoutMs for changes (-1 to wait until there are some, 0 to not wait), applies them
+         * to the sequence and calls the changes callback. The changes of a file are coalesced: a file written
+         * several times is reported once, a file created and deleted in the same batch is not reported.
+         * @returns The number of changes.
+         **/
+    int poll(int timeoutMs);
+
+    ///A file descriptor that becomes readable when there are changes to poll, to integrate the watcher in an
+    ///event loop. -1 if the platform does not support it, poll() then has to be called periodically.
+    int getFileDescriptor() const;
+
+    const SequenceParsing::SequenceFromPattern& getSequence() const;
+
+private:
+
+    PatternWatcher(const PatternWatcher&);
+    void operator=(const PatternWatcher&);
+
+    PatternWatcherPrivate* _imp;
 };
 
+/**
+     * @brief A cache of directory listings that can be saved to a compact file and loaded again, e.g: when a project
+     * is opened again. Once installed with setScanCache(), it is used by filesListFromPattern, visitFilesFromPattern,
+     * filesListFromPatterns, filesListFromPatternAsync, SequenceFromFiles::getSequenceOutOfFile (and its async version)
+     * and SequenceFromFiles::getSequencesOutOfDirectory.
+     * A directory is identified by its device and inode, and its listing is reused after a single stat as long as its
+     * modification time did not change, i.e: no file was added, removed or renamed in it. The files are then matched
+     * and grouped in sequences again, which only costs CPU time.
+     * The listings of directories modified less than 2 seconds before being read are not stored, as changes made in the
+     * same tick of the file system clock would go unnoticed.
+     * The cache can be used by several threads at once. It is only supported on Linux, elsewhere it is ignored.
+     **/
+struct ScanCachePrivate;
+class ScanCache {
+public:
+
+    ScanCache();
+
+    ~ScanCache();
+
+    /**
+         * @brief Replaces the content of the cache by the content of the given file.
+         * @returns False if the file couldn't be read or is not a valid cache file, the cache is then left empty.
+         **/
+    bool load(const std::string& cacheFilePath);
+
+    /**
+         * @brief Writes the content of the cache to the given file. It is written to a temporary file first which
+         * is then renamed, so that the file is never left half written. Returns false on failure.
+         **/
+    bool save(const std::string& cacheFilePath) const;
+
+    void clear();
+
+    ///The number of directories whose listing is cached
+    std::size_t getDirectoriesCount() const;
+
+    /**
+         * @brief Returns in files the cached listing of the directory identified by device and inode, if the
+         * modification time (in nanoseconds) it was cached with is the given one.
+         **/
+    bool findFilesList(unsigned long long device,unsigned long long inode,long long modificationTime,
+                       std::shared_ptr<const StringList>* files) const;
+
+    ///Caches the listing of a directory, replacing any previous one.
+    void storeFilesList(unsigned long long device,unsigned long long inode,long long modificationTime,const StringList& files);
+
+private:
+
+    ScanCache(const ScanCache&);
+    void operator=(const ScanCache&);
+
+    ScanCachePrivate* _imp;
+};
+
+/**
+     * @brief Installs the cache used by the scans, null to not use any.
+     * Installing another cache, or destroying the installed one, waits for the scans using it to be done with it,
+     * so it must not be done from a visitor or a callback called by a scan.
+     **/
+void setScanCache(ScanCache* cache);
+
+ScanCache* getScanCache();
+
+/**
+     * @brief An in-memory index of directories for SequenceFromFiles::getSequenceOutOfFile, e.g: for a file dialog
+     * calling it once for each selected file. Once installed with setSequenceIndex(), the files of a directory are
+     * listed and parsed once, and the sequence found for a given file is remembered: asking again for that file
+     * costs a single stat of its directory. The results are the same as without the index.
+     * A directory is invalidated when its modification time changes, i.e: when a file is added, removed or renamed in it.
+     * Like for ScanCache, directories modified less than 2 seconds before being read are not indexed.
+     * The least recently used directories are evicted once the memory used by the index exceeds maxMemoryUsage.
+     * The index can be used by several threads at once. It is only supported on Linux, elsewhere it is ignored.
+     **/
+struct SequenceIndexPrivate;
+class SequenceIndex {
+public:
+
+    explicit SequenceIndex(std::size_t maxMemoryUsage = 64 * 1024 * 1024);
+
+    ~SequenceIndex();
+
+    /**
+         * @brief Same as SequenceFromFiles::getSequenceOutOfFile, but answered from the index when possible.
+         * The sequence found is only remembered if sequence is empty and doesn't estimate sizes:
+         * otherwise only the parsed files of the directory are reused.
+         * token is checked for cancellation and receives the progress while the directory is read.
+         **/
+    ScanStatus getSequenceOutOfFile(const std::string& absoluteFileName,SequenceFromFiles* sequence,
+                                    const ScanToken& token = ScanToken());
+
+    void clear();
+
+    ///The number of directories indexed
+    std::size_t getDirectoriesCount() const;
+
+    ///Returns an estimation of the memory used by the index, in bytes.
+    std::size_t getMemoryUsage() const;
+
+private:
+
+    SequenceIndex(const SequenceIndex&);
+    void operator=(const SequenceIndex&);
+
+    SequenceIndexPrivate* _imp;
+};
+
+/**
+     * @brief Installs the index used by SequenceFromFiles::getSequenceOutOfFile and its async version, null to not use any.
+     * Like for setScanCache, installing another index or destroying the installed one waits for the calls using it.
+     **/
+void setSequenceIndex(SequenceIndex* index);
+
+SequenceIndex* getSequenceIndex();
+
+/**
+     * @brief Scans of a directory that start while another scan is reading it share the listing of that scan instead of
+     * reading the directory again: they get the batches of files as they are read.
+     * This applies to every scan listing a single directory: filesListFromPattern, visitFilesFromPattern,
+     * filesListFromPatterns, SequenceFromFiles::getSequenceOutOfFile, SequenceFromFiles::getSequencesOutOfDirectory
+     * and their async versions, so concurrent scans of the same compiled pattern share a single listing too.
+     * Only the few first batches are kept for the scans that start later, and then only the batches that some scan
+     * sharing the listing didn't get yet: a scan starting once the first batches are gone reads the directory itself.
+     * A scan sharing a listing reads the rest of the directory itself if the scan reading it stops before the end
+     * (e.g: it was cancelled), falls too far behind, or gets no new batch for a while (e.g: the visitor of the scan
+     * reading it is slow). A scan is never shared from a thread that is reading a directory for another scan: two
+     * threads scanning from their visitors the directory read by the other one would wait for each other.
+     * Scans waiting for a shared listing still stop promptly once cancelled.
+     * Directories are told apart by the path they are scanned with.
+     **/
+struct ScanCoordinatorStats
+{
+    ///the number of times a directory was read from the start
+    unsigned long long scansStarted;
+
+    ///the number of scans that shared the listing of a scan in progress instead of reading the directory again
+    unsigned long long duplicateScansAvoided;
+
+    ///the number of scans that read the rest of the directory themselves instead of sharing the listing until the end
+    unsigned long long scansTakenOver;
+};
+
+ScanCoordinatorStats getScanCoordinatorStats();
+
+void resetScanCoordinatorStats();
 
 
 } //namespace SequenceParsing
@@ -0,0 +1,119 @@
+/*
+ Tests of the copies of SequenceFromFiles handed to other threads while the original keeps being filled.
+ Run it built with -fsanitize=thread too (make check SANITIZE=thread): the readers never synchronize with the
+ writer but through the copies they release.
+ */
+#include "SequenceParsing.h"
+#include "TestsCommon.h"
+
+#include <atomic>
+#include <climits>
+#include <thread>
+
+using namespace SequenceParsing;
+
+///A copy of the sequence and the number of files it had when it was copied
+struct Snapshot
+{
+    SequenceFromFiles sequence;
+    int filesCount;
+};
+
+/**
+     * @brief Hands copies from the writer to a reader. The writer publishes a copy with release ordering, but learns
+     * that the reader is done with it with a relaxed load: nothing orders the reads of the reader before the next
+     * writes of the writer but the copy being released.
+     **/
+struct ReaderSlot
+{
+    std::atomic<Snapshot*> snapshot;
+
+    ReaderSlot()
+        : snapshot(0)
+    {
+    }
+};
+
+///Reads everything a copy gives and checks it still has the files it had when it was copied
+static bool readSnapshot(const Snapshot& snapshot)
+{
+    const SequenceFromFiles& sequence = snapshot.sequence;
+    bool ok = sequence.count() == snapshot.filesCount;
+    ok = ok && (int)sequence.getFilesList().size() == snapshot.filesCount;
+    ok = ok && (int)sequence.getFrameIndexes().size() == snapshot.filesCount;
+    ok = ok && sequence.getFramesCount(INT_MIN, INT_MAX) == snapshot.filesCount;
+    ok = ok && sequence.contains(sequence.getFilesList().back());
+    int frames = 0;
+    std::vector<FrameRange> ranges = sequence.getFrameRanges();
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+        frames += (ranges[i].last - ranges[i].first) / ranges[i].stride + 1;
+    }
+    ok = ok && frames == snapshot.filesCount;
+    ok = ok && !sequence.generateValidSequencePattern().empty();
+    return ok;
+}
+
+int main()
+{
+    const int readersCount = 4;
+    std::vector<ReaderSlot> slots(readersCount);
+    std::atomic<bool> writerDone(false);
+    std::atomic<int> badSnapshots(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < readersCount; ++i) {
+        ReaderSlot* slot = &slots[i];
+        readers.push_back(std::thread([slot, &writerDone, &badSnapshots]() {
+            for (;;) {
+                Snapshot* snapshot = slot->snapshot.load(std::memory_order_acquire);
+                if (!snapshot) {
+                    if (writerDone.load(std::memory_order_relaxed)) {
+                        return;
+                    }
+                    std::this_thread::yield();
+                    continue;
+                }
+                if (!readSnapshot(*snapshot)) {
+                    ++badSnapshots;
+                }
+                ///release the copy: the writer may then modify the sequence in place
+                delete snapshot;
+                slot->snapshot.store(0, std::memory_order_relaxed);
+            }
+        }));
+    }
+
+    ///frames in runs of different strides, so that inserting keeps reshaping the runs
+    SequenceFromFiles sequence;
+    int filesCount = 0;
+    for (int frame = 1; frame <= 3000; ++frame) {
+        if (frame % 5 == 3 || (frame > 1000 && frame % 2)) {
+            continue;
+        }
+        char name[64];
+        std::snprintf(name, sizeof(name), "/tmp/cow/shot.%04d.exr", frame);
+        check(sequence.tryInsertFile(FileNameContent(name)), std::string("insert ") + name);
+        ++filesCount;
+        ReaderSlot& slot = slots[filesCount % readersCount];
+        if (filesCount % 3 == 0 && !slot.snapshot.load(std::memory_order_relaxed)) {
+            Snapshot* snapshot = new Snapshot;
+            snapshot->sequence = sequence;
+            snapshot->filesCount = filesCount;
+            slot.snapshot.store(snapshot, std::memory_order_release);
+            ///half of the time, wait for the reader to release its copy, so that the next insertion is done in place
+            while (filesCount % 2 == 0 && slot.snapshot.load(std::memory_order_relaxed)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    writerDone = true;
+    for (std::size_t i = 0; i < readers.size(); ++i) {
+        readers[i].join();
+    }
+    for (std::size_t i = 0; i < slots.size(); ++i) {
+        delete slots[i].snapshot.load();
+    }
+
+    check(badSnapshots == 0, "the copies keep the files they had when copied");
+    check(sequence.count() == filesCount, "the original has all the files");
+    return testsResult("Copy-on-write tests");
+}
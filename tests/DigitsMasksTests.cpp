@@ -0,0 +1,84 @@
+/*
+ Tests of the digits masks used by DigitsRuns: the scalar, SSE2 and AVX2 variants must give the same masks.
+ The implementation is included so that its internal functions can be called.
+ `make check` runs it again with SEQUENCEPARSING_SIMD=scalar to check DigitsRuns over the scalar masks as well.
+ */
+#if defined(__GNUC__) && !defined(__clang__)
+///the internal types of the included implementation are meant to be in the main file
+#pragma GCC diagnostic ignored "-Wsubobject-linkage"
+#endif
+#include "../SequenceParsing.cpp"
+#include "TestsCommon.h"
+
+///the masks of str computed by computeDigitsMasks, the bits past the string being checked to be 0
+static std::vector<unsigned long long> getMasks(ComputeDigitsMasksFunc computeDigitsMasks,const std::string& str)
+{
+    std::vector<unsigned long long> masks((str.size() + 63) / 64 + 1, 0);
+    computeDigitsMasks(str.c_str(), str.size(), &masks[0]);
+    return masks;
+}
+
+static void checkString(const std::string& str,const std::string& what)
+{
+    const std::vector<unsigned long long> scalar = getMasks(computeDigitsMasksScalar, str);
+    for (std::size_t i = 0; i < str.size(); ++i) {
+        const bool isDigit = (scalar[i / 64] >> (i % 64)) & 1;
+        check(isDigit == isAsciiDigit(str[i]), what + ": scalar mask");
+    }
+    if (str.size() % 64) {
+        check((scalar[str.size() / 64] >> (str.size() % 64)) == 0, what + ": scalar bits past the end");
+    }
+#ifdef SEQUENCEPARSING_SSE2
+    check(getMasks(computeDigitsMasksSSE2, str) == scalar, what + ": SSE2 masks");
+#endif
+#ifdef SEQUENCEPARSING_AVX2
+    if (cpuSupportsAVX2()) {
+        check(getMasks(computeDigitsMasksAVX2, str) == scalar, what + ": AVX2 masks");
+    }
+#endif
+
+    ///the runs found by DigitsRuns, with the masks of getSimdLevel(), must be the runs of the characters
+    DigitsRuns runs(str.c_str(), str.size());
+    for (std::size_t i = 0; i < str.size(); ++i) {
+        check(runs.isDigit(i) == isAsciiDigit(str[i]), what + ": DigitsRuns::isDigit");
+        std::size_t end = i;
+        while (end < str.size() && isAsciiDigit(str[end]) == isAsciiDigit(str[i])) {
+            ++end;
+        }
+        check(runs.findRunEnd(i, isAsciiDigit(str[i])) == end, what + ": DigitsRuns::findRunEnd");
+    }
+}
+
+int main()
+{
+    ///the characters around '0' and '9', and bytes above 127 which are negative when compared as signed
+    const char alphabet[] = { '0', '1', '5', '9', '/', ':', 'a', '.', '_', ' ', '\x80', '\xb0', '\xb9', '\xff' };
+    std::mt19937 rng(1);
+
+    ///every length around the 16, 32 and 64 bytes blocks and the 256 bytes of the inline masks of DigitsRuns
+    for (std::size_t length = 0; length <= 200; ++length) {
+        for (int t = 0; t < 20; ++t) {
+            std::string str;
+            for (std::size_t i = 0; i < length; ++i) {
+                str.push_back(alphabet[rng() % sizeof(alphabet)]);
+            }
+            checkString(str, "random string of length " + std::to_string(length));
+        }
+    }
+    const std::size_t boundaries[] = { 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128, 129, 255, 256, 257 };
+    for (std::size_t i = 0; i < sizeof(boundaries) / sizeof(boundaries[0]); ++i) {
+        const std::size_t length = boundaries[i];
+        checkString(std::string(length, '7'), "digits only of length " + std::to_string(length));
+        checkString(std::string(length, 'x'), "no digits of length " + std::to_string(length));
+        ///a digit on each side of the block boundaries
+        std::string str(length, 'x');
+        str[length - 1] = '9';
+        str[0] = '0';
+        checkString(str, "digits at both ends of length " + std::to_string(length));
+        ///a file name whose frame number straddles the boundary
+        std::string name = std::string(length > 6 ? length - 6 : 0, 'a') + "123456.exr";
+        checkString(name, "file name of length " + std::to_string(name.size()));
+    }
+
+    return testsResult("Digits masks tests");
+}
@@ -0,0 +1,123 @@
+/*
+ Tests of filesListFromPattern with expected files: listing the directory and probing the expected files must find
+ the same files whenever PATTERN_SCAN_AUTOMATIC may probe, and it must list otherwise.
+ The files are created in a temporary directory, which is removed afterwards.
+ */
+#include "SequenceParsing.h"
+#include "TestsCommon.h"
+
+using namespace SequenceParsing;
+
+static std::string directory;
+
+static ExpectedPatternFiles getExpectedFiles(int first,int last,int stride,PatternScanStrategy strategy)
+{
+    ExpectedPatternFiles expected;
+    expected.frames.first = first;
+    expected.frames.last = last;
+    expected.frames.stride = stride;
+    expected.views.push_back(0);
+    expected.views.push_back(1);
+    expected.strategy = strategy;
+    return expected;
+}
+
+static SequenceFromPattern scan(const std::string& pattern,const ExpectedPatternFiles& expected,PatternScanReport* report)
+{
+    SequenceFromPattern sequence;
+    check(filesListFromPattern(directory + pattern, expected, &sequence, report), pattern + ": scan");
+    return sequence;
+}
+
+///Listing, probing and the automatic strategy must find the same files, and the automatic one must follow the cost model
+static void testSameFiles(const std::string& pattern,int first,int last,int stride,std::size_t expectedCount)
+{
+    PatternScanReport listReport, probeReport, automaticReport;
+    const SequenceFromPattern listed = scan(pattern, getExpectedFiles(first, last, stride, PATTERN_SCAN_LIST_DIRECTORY), &listReport);
+    const SequenceFromPattern probed = scan(pattern, getExpectedFiles(first, last, stride, PATTERN_SCAN_PROBE_FILES), &probeReport);
+    const ExpectedPatternFiles expected = getExpectedFiles(first, last, stride, PATTERN_SCAN_AUTOMATIC);
+    const SequenceFromPattern automatic = scan(pattern, expected, &automaticReport);
+
+    check(listReport.strategy == PATTERN_SCAN_LIST_DIRECTORY, pattern + ": forced listing");
+    check(probeReport.strategy == PATTERN_SCAN_PROBE_FILES, pattern + ": forced probing");
+    check(listed.size() == expectedCount, pattern + ": files count");
+    check(probed == listed, pattern + ": probing finds the listed files");
+    check(automatic == listed, pattern + ": automatic finds the listed files");
+    const bool probe = automaticReport.estimatedEntriesCount >= 0 &&
+        (double)automaticReport.expectedFilesCount * expected.probeCost < (double)automaticReport.estimatedEntriesCount;
+    check(automaticReport.strategy == (probe ? PATTERN_SCAN_PROBE_FILES : PATTERN_SCAN_LIST_DIRECTORY), pattern + ": automatic strategy");
+}
+
+///Patterns matching other spellings than the generated names must be listed
+static void testListed(const std::string& pattern,int first,int last,std::size_t expectedCount)
+{
+    PatternScanReport listReport, automaticReport;
+    const SequenceFromPattern listed = scan(pattern, getExpectedFiles(first, last, 1, PATTERN_SCAN_LIST_DIRECTORY), &listReport);
+    const SequenceFromPattern automatic = scan(pattern, getExpectedFiles(first, last, 1, PATTERN_SCAN_AUTOMATIC), &automaticReport);
+    check(automaticReport.strategy == PATTERN_SCAN_LIST_DIRECTORY, pattern + ": automatic strategy lists");
+    check(listed.size() == expectedCount, pattern + ": files count");
+    check(automatic == listed, pattern + ": automatic finds the listed files");
+}
+
+///Probing far more files than the directory has entries lists it instead, rather than generating billions of names
+static void testTooManyExpectedFiles(const std::string& pattern)
+{
+    PatternScanReport report;
+    const SequenceFromPattern listed = scan(pattern, getExpectedFiles(0, 2000000000, 1, PATTERN_SCAN_LIST_DIRECTORY), &report);
+    if (report.estimatedEntriesCount < 0) {
+        ///the directory is always probed as asked then, which would take too long
+        return;
+    }
+    const SequenceFromPattern all = scan(pattern, getExpectedFiles(0, 2000000000, 1, PATTERN_SCAN_PROBE_FILES), &report);
+    check(report.strategy == PATTERN_SCAN_LIST_DIRECTORY, pattern + ": listed instead of probing too many files");
+    check(all == listed, pattern + ": all the frames found");
+}
+
+int main()
+{
+    TemporaryDirectory temporaryDirectory;
+    directory = temporaryDirectory.getPath();
+
+    ///enough unrelated entries for the directory to be estimated bigger than the cost of probing the expected files
+    char name[64];
+    for (int i = 0; i < 3000; ++i) {
+        std::snprintf(name, sizeof(name), "unrelated_file_%05d.dat", i);
+        temporaryDirectory.createFile(name);
+    }
+    ///frames 1 to 100 with holes, and frames above the padding
+    for (int frame = 1; frame <= 100; ++frame) {
+        if (frame % 7) {
+            std::snprintf(name, sizeof(name), "plate.%04d.exr", frame);
+            temporaryDirectory.createFile(name);
+        }
+    }
+    temporaryDirectory.createFile("plate.12345.exr");
+    ///frames of the same shot with and without padding
+    for (int frame = 1; frame <= 20; ++frame) {
+        std::snprintf(name, sizeof(name), frame % 2 ? "mixed.%d.exr" : "mixed.%03d.exr", frame);
+        temporaryDirectory.createFile(name);
+    }
+    ///views spelt in different cases
+    for (int frame = 1; frame <= 20; ++frame) {
+        std::snprintf(name, sizeof(name), frame % 2 ? "stereo.%04d_left.exr" : "stereo.%04d_LEFT.exr", frame);
+        temporaryDirectory.createFile(name);
+        std::snprintf(name, sizeof(name), frame % 2 ? "stereo.%04d_Right.exr" : "stereo.%04d_right.exr", frame);
+        temporaryDirectory.createFile(name);
+        std::snprintf(name, sizeof(name), "stereo.%04d_%c.exr", frame, frame % 2 ? 'l' : 'R');
+        temporaryDirectory.createFile(name);
+    }
+
+    testSameFiles("plate.####.exr", 1, 100, 1, 86);
+    testSameFiles("plate.%04d.exr", 10, 40, 3, 10);
+    testSameFiles("plate.####.exr", 12345, 12345, 1, 1);
+    testSameFiles("plate.####.exr", 200, 300, 1, 0);
+    testSameFiles("missing.####.exr", 1, 10, 1, 0);
+    ///several batches of probes
+    testSameFiles("plate.####.exr", 1, 20000, 1, 87);
+    testTooManyExpectedFiles("plate.####.exr");
+
+    testListed("mixed.%d.exr", 1, 20, 20);
+    testListed("stereo.####_%V.exr", 1, 20, 20);
+    testListed("stereo.####_%v.exr", 1, 20, 20);
+    return testsResult("Expected files tests");
+}
@@ -0,0 +1,65 @@
+/*
+ Tests of FileNameGenerator at the bounds of the frame numbers.
+ */
+#include "SequenceParsing.h"
+#include "TestsCommon.h"
+
+#include <climits>
+
+using namespace SequenceParsing;
+
+///next() up to INT_MAX must give the same names as generateFileNameFromPattern and stop there
+static void testNextUpToIntMax(const std::string& patternString)
+{
+    CompiledPattern pattern(patternString);
+    FileNameGenerator generator(pattern);
+    generator.fileName(INT_MAX - 3, 1);
+    for (int frame = INT_MAX - 2; ; ++frame) {
+        const std::string name = generator.next();
+        check(name == generateFileNameFromPattern(pattern, frame, 1), patternString + ": name of frame " + name);
+        check(generator.currentFrame() == frame, patternString + ": current frame after " + name);
+        if (frame == INT_MAX) {
+            break;
+        }
+    }
+    const std::string last = generateFileNameFromPattern(pattern, INT_MAX, 1);
+    check(generator.next() == last, patternString + ": next() after INT_MAX");
+    check(generator.next() == last, patternString + ": next() after INT_MAX twice");
+    check(generator.currentFrame() == INT_MAX, patternString + ": current frame stays INT_MAX");
+}
+
+///asking for INT_MAX after INT_MAX - 1 goes through the in-place increment, asking for INT_MIN after INT_MAX must not
+static void testJumpsAroundIntMax()
+{
+    CompiledPattern pattern("/tmp/file.####_%v.exr");
+    FileNameGenerator generator(pattern);
+    generator.fileName(INT_MAX - 1, 0);
+    check(generator.fileName(INT_MAX, 0) == generateFileNameFromPattern(pattern, INT_MAX, 0), "INT_MAX after INT_MAX - 1");
+    check(generator.fileName(INT_MIN, 0) == generateFileNameFromPattern(pattern, INT_MIN, 0), "INT_MIN after INT_MAX");
+    check(generator.fileName(INT_MIN + 1, 0) == generateFileNameFromPattern(pattern, INT_MIN + 1, 0), "INT_MIN + 1 after INT_MIN");
+}
+
+static void testGenerateRangeUpToIntMax()
+{
+    CompiledPattern pattern("/tmp/file.%04d.exr");
+    FileNameGenerator generator(pattern);
+    std::string buffer;
+    std::vector<std::size_t> offsets;
+    std::vector<int> views;
+    generator.generateRange(INT_MAX - 2, INT_MAX, views, &buffer, &offsets);
+    check(offsets.size() == 3, "generateRange up to INT_MAX count");
+    for (std::size_t i = 0; i < offsets.size(); ++i) {
+        check(std::string(buffer.c_str() + offsets[i]) == generateFileNameFromPattern(pattern, INT_MAX - 2 + (int)i, 0),
+              "generateRange up to INT_MAX name");
+    }
+}
+
+int main()
+{
+    testNextUpToIntMax("/tmp/file.####.exr");
+    testNextUpToIntMax("/tmp/file.%d_%V.exr");
+    testNextUpToIntMax("/tmp/a##b%012d.exr");
+    testJumpsAroundIntMax();
+    testGenerateRangeUpToIntMax();
+    return testsResult("FileNameGenerator tests");
+}
@@ -0,0 +1,139 @@
+/*
+ Tests of the frames of SequenceFromFiles, stored as runs of frames with a constant stride: whatever the order the
+ frames are inserted in, the frames, ranges, counts and lookups must be the same as those of a plain set of frames.
+ */
+#include "SequenceParsing.h"
+#include "TestsCommon.h"
+
+#include <algorithm>
+#include <climits>
+#include <random>
+#include <set>
+
+using namespace SequenceParsing;
+
+static std::string getFileName(int frame)
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "/tmp/runs/shot.%04d.exr", frame);
+    return name;
+}
+
+///Checks everything the sequence tells about its frames against the frames inserted
+static void checkFrames(const SequenceFromFiles& sequence,const std::set<int>& frames,std::mt19937& generator,const std::string& what)
+{
+    check(sequence.count() == (int)frames.size(), what + ": count");
+    check(sequence.getFirstFrame() == *frames.begin() && sequence.getLastFrame() == *frames.rbegin(), what + ": first and last frames");
+
+    std::set<int> indexes;
+    const std::map<int,std::string>& frameIndexes = sequence.getFrameIndexes();
+    bool namesOk = true;
+    for (std::map<int,std::string>::const_iterator it = frameIndexes.begin(); it != frameIndexes.end(); ++it) {
+        indexes.insert(it->first);
+        namesOk = namesOk && it->second == getFileName(it->first);
+    }
+    check(indexes == frames, what + ": frame indexes");
+    check(namesOk, what + ": files of the frame indexes");
+
+    ///the ranges are ordered and disjoint, and have the frames inserted
+    std::set<int> rangesFrames;
+    const std::vector<FrameRange> ranges = sequence.getFrameRanges();
+    bool rangesOk = true;
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+        rangesOk = rangesOk && ranges[i].stride >= 1 && ranges[i].first <= ranges[i].last &&
+                (ranges[i].last - ranges[i].first) % ranges[i].stride == 0 && (i == 0 || ranges[i - 1].last < ranges[i].first);
+        for (int frame = ranges[i].first; rangesOk && frame <= ranges[i].last; frame += ranges[i].stride) {
+            rangesFrames.insert(frame);
+        }
+    }
+    check(rangesOk, what + ": ranges ordered and disjoint");
+    check(rangesFrames == frames, what + ": frames of the ranges");
+
+    const int lowest = *frames.begin() - 10;
+    const int highest = *frames.rbegin() + 10;
+    std::uniform_int_distribution<int> frameDistribution(lowest, highest);
+    bool lookupsOk = true;
+    for (int i = 0; i < 200; ++i) {
+        const int frame = frameDistribution(generator);
+        const bool inserted = frames.count(frame) != 0;
+        std::string fileName;
+        lookupsOk = lookupsOk && sequence.containsFrame(frame) == inserted &&
+                sequence.getFileNameForFrame(frame, &fileName) == inserted && (!inserted || fileName == getFileName(frame)) &&
+                sequence.contains(getFileName(frame)) == inserted;
+
+        int first = frameDistribution(generator);
+        int last = frameDistribution(generator);
+        if (first > last) {
+            std::swap(first, last);
+        }
+        const int expectedCount = (int)std::distance(frames.lower_bound(first), frames.upper_bound(last));
+        lookupsOk = lookupsOk && sequence.getFramesCount(first, last) == expectedCount;
+    }
+    check(lookupsOk, what + ": lookups of random frames");
+    check(sequence.getFramesCount(INT_MIN, INT_MAX) == (int)frames.size(), what + ": count of all the frames");
+}
+
+///Inserts the frames in the given order and checks the sequence after each tenth of them
+static void testInsertions(const std::vector<int>& order,std::mt19937& generator,const std::string& what)
+{
+    SequenceFromFiles sequence;
+    std::set<int> frames;
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        check(sequence.tryInsertFile(FileNameContent(getFileName(order[i]))), what + ": insert " + getFileName(order[i]));
+        frames.insert(order[i]);
+        if ((i + 1) % (order.size() / 10 + 1) == 0 || i + 1 == order.size()) {
+            checkFrames(sequence, frames, generator, what + " after " + std::to_string(i + 1) + " frames");
+        }
+    }
+    ///inserting a frame again doesn't add a file
+    sequence.tryInsertFile(FileNameContent(getFileName(order[0])));
+    check(sequence.count() == (int)frames.size(), what + ": insert again");
+}
+
+static void testRegularRanges()
+{
+    SequenceFromFiles everyFrame;
+    SequenceFromFiles everyOtherFrame;
+    for (int frame = 1; frame <= 99; ++frame) {
+        everyFrame.tryInsertFile(FileNameContent(getFileName(frame)));
+        if (frame % 2) {
+            everyOtherFrame.tryInsertFile(FileNameContent(getFileName(frame)));
+        }
+    }
+    std::vector<FrameRange> ranges = everyFrame.getFrameRanges();
+    check(ranges.size() == 1 && ranges[0].first == 1 && ranges[0].last == 99 && ranges[0].stride == 1, "a range for every frame");
+    ranges = everyOtherFrame.getFrameRanges();
+    check(ranges.size() == 1 && ranges[0].first == 1 && ranges[0].last == 99 && ranges[0].stride == 2, "a range for every other frame");
+}
+
+int main()
+{
+    std::mt19937 generator(12345);
+    testRegularRanges();
+
+    ///runs of various strides with holes, inserted in order, in reverse and shuffled, so that runs keep being split and merged
+    std::vector<int> order;
+    for (int frame = 1; frame <= 3000; ++frame) {
+        if ((frame <= 1000 && frame % 7 != 3) || (frame > 1000 && frame <= 2000 && frame % 2 == 0) ||
+                (frame > 2000 && frame % 5 == 1) || frame == 2001 || frame == 2003) {
+            order.push_back(frame);
+        }
+    }
+    testInsertions(order, generator, "ascending");
+    std::reverse(order.begin(), order.end());
+    testInsertions(order, generator, "descending");
+    std::shuffle(order.begin(), order.end(), generator);
+    testInsertions(order, generator, "shuffled");
+
+    ///random sparse frames
+    std::set<int> randomFrames;
+    std::uniform_int_distribution<int> frameDistribution(0, 9999);
+    while (randomFrames.size() < 2000) {
+        randomFrames.insert(frameDistribution(generator));
+    }
+    order.assign(randomFrames.begin(), randomFrames.end());
+    std::shuffle(order.begin(), order.end(), generator);
+    testInsertions(order, generator, "random");
+
+    return testsResult("FrameRunSet tests");
+}
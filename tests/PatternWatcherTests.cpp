@@ -0,0 +1,101 @@
+/*
+ Tests of PatternWatcher: the files written, linked, moved in, moved out and deleted in the watched directory must be
+ reported once, and the sequence kept the same as a new scan of the directory would find it.
+ */
+#include "SequenceParsing.h"
+#include "TestsCommon.h"
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace SequenceParsing;
+
+///the changes reported by the last poll
+static std::vector<SequenceChange> lastChanges;
+
+///Polls until the expected number of changes were reported (or for a second) and checks that the sequence is up to date,
+///unless a file is being written: scans list it, whereas the watcher waits for it to be closed
+static void pollChanges(PatternWatcher& watcher,const CompiledPattern& pattern,std::size_t expectedChangesCount,const std::string& what,
+                        bool fileBeingWritten = false)
+{
+    std::vector<SequenceChange> changes;
+    watcher.setChangesCallback([&changes](const std::vector<SequenceChange>& newChanges) {
+        changes.insert(changes.end(), newChanges.begin(), newChanges.end());
+    });
+    for (int i = 0; i < 20 && changes.size() < expectedChangesCount; ++i) {
+        watcher.poll(50);
+    }
+    ///the changes that should not be reported are given some time to show up
+    watcher.poll(expectedChangesCount ? 0 : 100);
+    check(changes.size() == expectedChangesCount, what + ": changes count");
+    if (!fileBeingWritten) {
+        SequenceFromPattern scanned;
+        filesListFromPattern(pattern, &scanned);
+        check(watcher.getSequence() == scanned, what + ": same sequence as a scan");
+    }
+    lastChanges = changes;
+}
+
+static bool isChange(std::size_t index,SequenceChange::Type type,int frameNumber)
+{
+    return index < lastChanges.size() && lastChanges[index].type == type && lastChanges[index].frameNumber == frameNumber;
+}
+
+int main()
+{
+    TemporaryDirectory directory;
+    const std::string& path = directory.getPath();
+    for (int frame = 1; frame <= 3; ++frame) {
+        directory.createFile("shot." + std::to_string(frame) + ".exr");
+    }
+    const CompiledPattern pattern(path + "shot.#.exr");
+    PatternWatcher watcher(pattern);
+    check(watcher.start(), "start");
+    check(watcher.getSequence().size() == 3, "frames found by start");
+
+    ///a file is only added once it is written and closed
+    FILE* file = std::fopen((path + "shot.4.exr").c_str(), "w");
+    check(file != 0, "open shot.4.exr");
+    pollChanges(watcher, pattern, 0, "file being written", true);
+    std::fclose(file);
+    pollChanges(watcher, pattern, 1, "file written");
+    check(isChange(0, SequenceChange::FILE_ADDED, 4), "file written added");
+
+    ///written several times, a file is reported once
+    directory.createFile("shot.5.exr", "a");
+    directory.createFile("shot.5.exr", "b");
+    pollChanges(watcher, pattern, 1, "file written twice");
+    check(isChange(0, SequenceChange::FILE_ADDED, 5), "file written twice added");
+
+    ///links are complete as soon as they are created
+    const std::string source = directory.createFile("source.dat");
+    check(::link(source.c_str(), (path + "shot.6.exr").c_str()) == 0, "hard link");
+    pollChanges(watcher, pattern, 1, "hard link");
+    check(isChange(0, SequenceChange::FILE_ADDED, 6), "hard link added");
+    check(::symlink(source.c_str(), (path + "shot.7.exr").c_str()) == 0, "symbolic link");
+    pollChanges(watcher, pattern, 1, "symbolic link");
+    check(isChange(0, SequenceChange::FILE_ADDED, 7), "symbolic link added");
+    check(::symlink("missing.dat", (path + "shot.8.exr").c_str()) == 0, "broken link");
+    pollChanges(watcher, pattern, 1, "broken link");
+
+    ///directories and links to directories are not files
+    check(::mkdir((path + "shot.9.exr").c_str(), 0755) == 0, "directory");
+    check(::symlink(path.c_str(), (path + "shot.10.exr").c_str()) == 0, "link to a directory");
+    pollChanges(watcher, pattern, 0, "directories");
+
+    ///files moved in and out, deleted, and created then deleted in the same batch
+    const std::string outside = directory.createFile("outside.dat");
+    check(std::rename(outside.c_str(), (path + "shot.11.exr").c_str()) == 0, "move in");
+    pollChanges(watcher, pattern, 1, "file moved in");
+    check(isChange(0, SequenceChange::FILE_ADDED, 11), "file moved in added");
+    check(std::rename((path + "shot.1.exr").c_str(), (path + "moved.dat").c_str()) == 0, "move out");
+    check(std::remove((path + "shot.2.exr").c_str()) == 0, "delete");
+    pollChanges(watcher, pattern, 2, "files moved out and deleted");
+    check(isChange(0, SequenceChange::FILE_REMOVED, 1) && isChange(1, SequenceChange::FILE_REMOVED, 2), "files removed");
+    directory.createFile("shot.12.exr");
+    std::remove((path + "shot.12.exr").c_str());
+    pollChanges(watcher, pattern, 0, "file created and deleted");
+
+    watcher.stop();
+    return testsResult("PatternWatcher tests");
+}
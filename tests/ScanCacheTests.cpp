@@ -0,0 +1,169 @@
+/*
+ Tests of ScanCache: the file it saves must have the documented layout, load back the same listings, and be rejected
+ (leaving the cache empty) whenever it is truncated or corrupted. Scans must use the listing of an unchanged directory
+ and read the directory again once it changed.
+ */
+#include "SequenceParsing.h"
+#include "TestsCommon.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+using namespace SequenceParsing;
+
+template <typename T>
+static void appendValue(std::string* data,T value)
+{
+    data->append((const char*)&value, sizeof(value));
+}
+
+static std::string readFile(const std::string& fileName)
+{
+    std::ifstream file(fileName.c_str(), std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& fileName,const std::string& data)
+{
+    std::ofstream file(fileName.c_str(), std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+}
+
+static StringList makeFilesList(const char* first,const char* second,const char* third)
+{
+    StringList files;
+    files.push_back(first);
+    files.push_back(second);
+    files.push_back(third);
+    return files;
+}
+
+///The file layout: magic "SPSC", version, directories count, then for each directory in the order of (device, inode):
+///device, inode, modification time, files count and each file as its length followed by its characters
+static void testFileLayout(const TemporaryDirectory& directory)
+{
+    ScanCache cache;
+    cache.storeFilesList(2, 20, 2000, makeFilesList("b.0001.exr", "b.0002.exr", ""));
+    cache.storeFilesList(1, 10, 1000, makeFilesList("a.exr", "with space.dpx", "x"));
+    const std::string cacheFileName = directory.getPath() + "layout.cache";
+    check(cache.save(cacheFileName), "save");
+
+    std::string expected;
+    appendValue(&expected, (unsigned int)0x53505343u);
+    appendValue(&expected, (unsigned int)1);
+    appendValue(&expected, (unsigned long long)2);
+    const unsigned long long devices[] = { 1, 2 };
+    const unsigned long long inodes[] = { 10, 20 };
+    const long long modificationTimes[] = { 1000, 2000 };
+    const StringList files[] = { makeFilesList("a.exr", "with space.dpx", "x"), makeFilesList("b.0001.exr", "b.0002.exr", "") };
+    for (int i = 0; i < 2; ++i) {
+        appendValue(&expected, devices[i]);
+        appendValue(&expected, inodes[i]);
+        appendValue(&expected, modificationTimes[i]);
+        appendValue(&expected, (unsigned int)files[i].size());
+        for (std::size_t j = 0; j < files[i].size(); ++j) {
+            appendValue(&expected, (unsigned int)files[i][j].size());
+            expected.append(files[i][j]);
+        }
+    }
+    const std::string saved = readFile(cacheFileName);
+    check(saved == expected, "saved file layout");
+    check(!std::ifstream((cacheFileName + ".tmp").c_str()), "no temporary file left");
+
+    ScanCache loaded;
+    check(loaded.load(cacheFileName), "load");
+    check(loaded.getDirectoriesCount() == 2, "loaded directories count");
+    std::shared_ptr<const StringList> loadedFiles;
+    check(loaded.findFilesList(1, 10, 1000, &loadedFiles) && *loadedFiles == files[0], "loaded files of the first directory");
+    check(loaded.findFilesList(2, 20, 2000, &loadedFiles) && *loadedFiles == files[1], "loaded files of the second directory");
+    check(!loaded.findFilesList(2, 20, 2001, &loadedFiles), "another modification time is not found");
+    check(!loaded.findFilesList(3, 20, 2000, &loadedFiles), "another device is not found");
+
+    ///every truncation and every extra byte is rejected, and leaves the cache empty
+    bool truncationsRejected = true;
+    for (std::size_t length = 0; length < saved.size(); ++length) {
+        writeFile(cacheFileName, saved.substr(0, length));
+        truncationsRejected = truncationsRejected && !loaded.load(cacheFileName) && loaded.getDirectoriesCount() == 0;
+    }
+    check(truncationsRejected, "truncated files rejected");
+    writeFile(cacheFileName, saved + '\0');
+    check(!loaded.load(cacheFileName) && loaded.getDirectoriesCount() == 0, "extra byte rejected");
+
+    ///another magic or version, and a corrupted files count
+    std::string corrupted = saved;
+    corrupted[0] ^= 1;
+    writeFile(cacheFileName, corrupted);
+    check(!loaded.load(cacheFileName), "other magic rejected");
+    corrupted = saved;
+    corrupted[4] = 2;
+    writeFile(cacheFileName, corrupted);
+    check(!loaded.load(cacheFileName), "other version rejected");
+    corrupted = saved;
+    const unsigned int hugeCount = 0xFFFFFFFFu;
+    std::memcpy(&corrupted[16 + 24], &hugeCount, sizeof(hugeCount));
+    writeFile(cacheFileName, corrupted);
+    check(!loaded.load(cacheFileName) && loaded.getDirectoriesCount() == 0, "corrupted files count rejected");
+    check(!loaded.load(directory.getPath() + "missing.cache"), "missing file rejected");
+}
+
+///Sets the modification time of the directory far enough in the past for its listing to be cached
+static void ageDirectory(const std::string& path,int secondsAgo)
+{
+    struct timespec times[2];
+    times[0].tv_sec = times[1].tv_sec = time(0) - secondsAgo;
+    times[0].tv_nsec = times[1].tv_nsec = 0;
+    check(::utimensat(AT_FDCWD, path.c_str(), times, 0) == 0, "age " + path);
+}
+
+///Scans read the cached listing of an unchanged directory, even from a cache loaded from a file
+static void testScansUseCache(const TemporaryDirectory& directory)
+{
+    const std::string path = directory.getPath() + "shot/";
+    check(::mkdir(path.c_str(), 0755) == 0, "create the directory of the shot");
+    for (int frame = 1; frame <= 10; ++frame) {
+        directory.createFile("shot/plate." + std::to_string(frame) + ".exr");
+    }
+    ageDirectory(path, 60);
+
+    const std::string cacheFileName = directory.getPath() + "scans.cache";
+    {
+        ScanCache cache;
+        setScanCache(&cache);
+        SequenceFromPattern sequence;
+        check(filesListFromPattern(path + "plate.#.exr", &sequence) && sequence.size() == 10, "first scan");
+        check(cache.getDirectoriesCount() == 1, "listing cached by the first scan");
+        check(cache.save(cacheFileName), "save the cache of the scans");
+        setScanCache(0);
+    }
+
+    ///replace the listing in the saved file to tell whether the scans read it
+    ScanCache cache;
+    check(cache.load(cacheFileName) && cache.getDirectoriesCount() == 1, "load the cache of the scans");
+    struct stat st;
+    check(::stat(path.c_str(), &st) == 0, "stat the directory");
+    const long long modificationTime = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    std::shared_ptr<const StringList> cachedFiles;
+    check(cache.findFilesList(st.st_dev, st.st_ino, modificationTime, &cachedFiles) && cachedFiles->size() == 10,
+          "listing cached with the identity of the directory");
+    cache.storeFilesList(st.st_dev, st.st_ino, modificationTime, makeFilesList("plate.1.exr", "plate.2.exr", "other.exr"));
+    setScanCache(&cache);
+    SequenceFromPattern sequence;
+    check(filesListFromPattern(path + "plate.#.exr", &sequence) && sequence.size() == 2, "scan reading the cached listing");
+
+    ///once the directory changed, it is read again
+    directory.createFile("shot/plate.11.exr");
+    ageDirectory(path, 30);
+    check(filesListFromPattern(path + "plate.#.exr", &sequence) && sequence.size() == 11, "scan of the changed directory");
+    setScanCache(0);
+}
+
+int main()
+{
+    TemporaryDirectory directory;
+    testFileLayout(directory);
+    testScansUseCache(directory);
+    return testsResult("ScanCache tests");
+}
@@ -0,0 +1,105 @@
+/*
+ Tests of the eviction of SequenceIndex: once its memory usage exceeds its maximum, the least recently used directories
+ are evicted first. A directory still indexed is told apart from an evicted one by adding a file to it without changing
+ its modification time: the index still answers with the sequence it remembered, whereas an evicted directory is read again.
+ */
+#include "SequenceParsing.h"
+#include "TestsCommon.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+using namespace SequenceParsing;
+
+static const int DIRECTORIES_COUNT = 5;
+static const int FRAMES_COUNT = 50;
+
+///the modification time given to the directories, old enough for them to be indexed
+static time_t directoriesTime = 0;
+
+static std::string getDirectory(const TemporaryDirectory& directory,int index)
+{
+    return directory.getPath() + "dir" + std::to_string(index) + "/";
+}
+
+static void setDirectoryTime(const std::string& path)
+{
+    struct timespec times[2];
+    times[0].tv_sec = times[1].tv_sec = directoriesTime;
+    times[0].tv_nsec = times[1].tv_nsec = 0;
+    check(::utimensat(AT_FDCWD, path.c_str(), times, 0) == 0, "set the time of " + path);
+}
+
+///Returns the number of files of the sequence of the first frame of the directory found by the index
+static int getFilesCount(SequenceIndex& index,const std::string& path)
+{
+    SequenceFromFiles sequence;
+    check(index.getSequenceOutOfFile(path + "shot.0001.exr", &sequence) == SCAN_SUCCEEDED, "sequence of " + path);
+    return sequence.count();
+}
+
+///Adds a frame to the directory without changing its modification time
+static void addFrameSecretly(const TemporaryDirectory& directory,int index,int frame)
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "dir%d/shot.%04d.exr", index, frame);
+    directory.createFile(name);
+    setDirectoryTime(getDirectory(directory, index));
+}
+
+int main()
+{
+    TemporaryDirectory directory;
+    directoriesTime = time(0) - 60;
+    for (int i = 0; i < DIRECTORIES_COUNT; ++i) {
+        check(::mkdir(getDirectory(directory, i).c_str(), 0755) == 0, "create " + getDirectory(directory, i));
+        for (int frame = 1; frame <= FRAMES_COUNT; ++frame) {
+            char name[64];
+            std::snprintf(name, sizeof(name), "dir%d/shot.%04d.exr", i, frame);
+            directory.createFile(name);
+        }
+        setDirectoryTime(getDirectory(directory, i));
+    }
+
+    ///the memory used by one directory, all of them having as many files of the same lengths
+    std::size_t directoryUsage;
+    {
+        SequenceIndex index;
+        const std::size_t emptyUsage = index.getMemoryUsage();
+        check(getFilesCount(index, getDirectory(directory, 0)) == FRAMES_COUNT, "sequence of a directory");
+        directoryUsage = index.getMemoryUsage() - emptyUsage;
+        check(index.getDirectoriesCount() == 1 && directoryUsage > 0, "directory indexed");
+    }
+
+    ///room for 3 directories
+    const std::size_t maxMemoryUsage = directoryUsage * 3 + directoryUsage / 2;
+    SequenceIndex index(maxMemoryUsage);
+    const std::size_t emptyUsage = index.getMemoryUsage();
+    for (int i = 0; i < 3; ++i) {
+        getFilesCount(index, getDirectory(directory, i));
+    }
+    check(index.getDirectoriesCount() == 3, "3 directories indexed");
+    ///dir0 becomes the most recently used, so that indexing dir3 evicts dir1
+    getFilesCount(index, getDirectory(directory, 0));
+    getFilesCount(index, getDirectory(directory, 3));
+    check(index.getDirectoriesCount() == 3, "a directory evicted");
+    check(index.getMemoryUsage() <= emptyUsage + maxMemoryUsage, "memory usage within the maximum");
+
+    for (int i = 0; i < 4; ++i) {
+        addFrameSecretly(directory, i, FRAMES_COUNT + 1);
+    }
+    ///looked up in this order, the directories indexed are dir0, dir3 and dir2 from the most recently used
+    check(getFilesCount(index, getDirectory(directory, 0)) == FRAMES_COUNT, "dir0 still indexed");
+    check(getFilesCount(index, getDirectory(directory, 3)) == FRAMES_COUNT, "dir3 still indexed");
+    ///dir1 is read again and evicts dir2
+    check(getFilesCount(index, getDirectory(directory, 1)) == FRAMES_COUNT + 1, "dir1 evicted");
+    check(getFilesCount(index, getDirectory(directory, 2)) == FRAMES_COUNT + 1, "dir2 evicted");
+    check(index.getDirectoriesCount() == 3, "3 directories indexed after the evictions");
+
+    ///an index too small for a single directory keeps nothing, but still finds the sequences
+    SequenceIndex tinyIndex(1);
+    check(getFilesCount(tinyIndex, getDirectory(directory, 4)) == FRAMES_COUNT, "sequence found by a tiny index");
+    check(tinyIndex.getDirectoriesCount() == 0, "nothing kept by a tiny index");
+
+    return testsResult("SequenceIndex tests");
+}
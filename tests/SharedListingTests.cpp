@@ -0,0 +1,153 @@
+/*
+ Tests of the listings shared by concurrent scans of a directory: every scan must find all the files whether it reads
+ the directory, follows the scan reading it, or takes over from a stalled one, and a scan started from the visitor of
+ another scan of the same directory must not wait for it.
+ */
+#include "SequenceParsing.h"
+#include "TestsCommon.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+
+using namespace SequenceParsing;
+
+///enough files for the directory to be read in several batches
+static const int FILES_COUNT = 30000;
+
+///Collects the files visited, optionally calling a function on the first one
+class CollectingVisitor : public PatternFilesVisitor {
+public:
+
+    CollectingVisitor()
+        : files()
+        , onFirstFile()
+    {
+    }
+
+    virtual bool visitFile(int /*frameNumber*/,int /*viewNumber*/,const std::string& absoluteFileName) {
+        if (files.empty() && onFirstFile) {
+            onFirstFile();
+        }
+        files.insert(absoluteFileName);
+        return true;
+    }
+
+    std::set<std::string> files;
+    std::function<void ()> onFirstFile;
+};
+
+static double getMilliseconds(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+///Scans started at once all find the files, each one either reading the directory or sharing the listing of another
+static void testConcurrentScans(const CompiledPattern& pattern,const std::set<std::string>& allFiles)
+{
+    const int scansCount = 8;
+    resetScanCoordinatorStats();
+    std::vector<CollectingVisitor> visitors(scansCount);
+    std::vector<std::thread> threads;
+    std::atomic<bool> go(false);
+    for (int i = 0; i < scansCount; ++i) {
+        CollectingVisitor* visitor = &visitors[i];
+        threads.push_back(std::thread([&pattern, visitor, &go]() {
+            while (!go) {
+                std::this_thread::yield();
+            }
+            check(visitFilesFromPattern(pattern, visitor), "concurrent scan");
+        }));
+    }
+    go = true;
+    for (int i = 0; i < scansCount; ++i) {
+        threads[i].join();
+        check(visitors[i].files == allFiles, "files of a concurrent scan");
+    }
+    const ScanCoordinatorStats stats = getScanCoordinatorStats();
+    check(stats.scansStarted + stats.duplicateScansAvoided == (unsigned long long)scansCount, "each scan counted once");
+    check(stats.scansStarted >= 1, "the directory is read");
+}
+
+///A scan following a stalled scan reads the rest of the directory itself instead of waiting for it
+static void testStalledLeader(const CompiledPattern& pattern,const std::set<std::string>& allFiles)
+{
+    resetScanCoordinatorStats();
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool leaderStalled = false;
+    bool followerDone = false;
+
+    CollectingVisitor leader;
+    leader.onFirstFile = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        leaderStalled = true;
+        changed.notify_all();
+        changed.wait_for(lock, std::chrono::seconds(10), [&]() { return followerDone; });
+    };
+    std::thread leaderThread([&]() {
+        check(visitFilesFromPattern(pattern, &leader), "stalled scan");
+    });
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return leaderStalled; });
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CollectingVisitor follower;
+    check(visitFilesFromPattern(pattern, &follower), "follower of the stalled scan");
+    const double followerTime = getMilliseconds(start);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        followerDone = true;
+        changed.notify_all();
+    }
+    leaderThread.join();
+
+    check(followerTime < 5000, "the follower doesn't wait for the stalled scan");
+    check(follower.files == allFiles, "files of the follower");
+    check(leader.files == allFiles, "files of the stalled scan");
+    const ScanCoordinatorStats stats = getScanCoordinatorStats();
+    check(stats.duplicateScansAvoided == 1 && stats.scansTakenOver == 1, "the follower shared the listing and then took over");
+}
+
+///A scan started from a visitor of a scan of the same directory reads it on its own
+static void testNestedScan(const CompiledPattern& pattern,const std::set<std::string>& allFiles)
+{
+    SequenceFromPattern nested;
+    bool nestedScanned = false;
+    CollectingVisitor outer;
+    outer.onFirstFile = [&]() {
+        nestedScanned = filesListFromPattern(pattern, &nested);
+    };
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    check(visitFilesFromPattern(pattern, &outer), "outer scan");
+    check(getMilliseconds(start) < 5000, "the nested scan doesn't wait for the outer one");
+    check(nestedScanned && nested.size() == allFiles.size(), "files of the nested scan");
+    check(outer.files == allFiles, "files of the outer scan");
+}
+
+int main()
+{
+    TemporaryDirectory directory;
+    std::set<std::string> allFiles;
+    char name[64];
+    for (int frame = 1; frame <= FILES_COUNT; ++frame) {
+        std::snprintf(name, sizeof(name), "shot_with_a_long_name.%05d.exr", frame);
+        allFiles.insert(directory.createFile(name));
+        if (frame % 10 == 0) {
+            std::snprintf(name, sizeof(name), "other_%05d.txt", frame);
+            directory.createFile(name);
+        }
+    }
+    const CompiledPattern pattern(directory.getPath() + "shot_with_a_long_name.#####.exr");
+
+    testConcurrentScans(pattern, allFiles);
+    testStalledLeader(pattern, allFiles);
+    testNestedScan(pattern, allFiles);
+    return testsResult("Shared listing tests");
+}
@@ -0,0 +1,85 @@
+/*
+ Helpers shared by the tests. Each test is a program that checks its cases with check() and returns
+ testsResult() from main. They are all built and run by `make check` in this directory.
+ */
+#ifndef SEQUENCEPARSING_TESTSCOMMON_H
+#define SEQUENCEPARSING_TESTSCOMMON_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+///the number of failed checks
+static int failures = 0;
+
+static void check(bool condition,const std::string& what)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+///Prints the outcome of the tests and returns the exit code of the test program
+static int testsResult(const std::string& testsName)
+{
+    if (failures) {
+        std::cerr << testsName << ": " << failures << " failure(s)" << std::endl;
+        return 1;
+    }
+    std::cout << testsName << " passed" << std::endl;
+    return 0;
+}
+
+///A new directory in the temporary directory, removed along with its content when destroyed
+class TemporaryDirectory
+{
+public:
+
+    TemporaryDirectory()
+        : _path()
+    {
+        std::string directoryTemplate = (std::filesystem::temp_directory_path() / "SequenceParsingTestsXXXXXX").string();
+        if (!mkdtemp(&directoryTemplate[0])) {
+            throw std::runtime_error("cannot create a temporary directory");
+        }
+        _path = directoryTemplate + "/";
+    }
+
+    ~TemporaryDirectory()
+    {
+        std::error_code error;
+        std::filesystem::remove_all(_path, error);
+    }
+
+    ///The absolute path of the directory, ending with a '/'
+    const std::string& getPath() const
+    {
+        return _path;
+    }
+
+    ///Creates a file (or overwrites it) with the given content and returns its absolute name
+    std::string createFile(const std::string& name,const std::string& content = std::string()) const
+    {
+        const std::string fileName = _path + name;
+        FILE* file = std::fopen(fileName.c_str(), "w");
+        check(file != 0, "create " + fileName);
+        if (file) {
+            std::fwrite(content.data(), 1, content.size(), file);
+            std::fclose(file);
+        }
+        return fileName;
+    }
+
+private:
+
+    TemporaryDirectory(const TemporaryDirectory&);
+    void operator=(const TemporaryDirectory&);
+
+    std::string _path;
+};
+
+#endif // SEQUENCEPARSING_TESTSCOMMON_H